@@ -0,0 +1,239 @@
+#include "covex/core/binary_view_oracle.hpp"
+
+#include <algorithm>
+
+#include "covex/core/index_cache.hpp"
+
+namespace binja::covex::core {
+
+namespace {
+
+constexpr uint64_t kDefaultMaxInstructionLength = 16;
+constexpr uint64_t kHashChunkSize = 1024 * 1024;
+
+OracleSegment
+to_oracle_segment(const BinaryNinja::Ref<BinaryNinja::Segment> &segment) {
+  const uint32_t flags = segment->GetFlags();
+  OracleSegment result;
+  result.start = segment->GetStart();
+  result.end = segment->GetEnd();
+  result.executable = (flags & SegmentExecutable) != 0;
+  result.contains_code = (flags & SegmentContainsCode) != 0;
+  result.deny_execute = (flags & SegmentDenyExecute) != 0;
+  return result;
+}
+
+OracleBlock to_oracle_block(const BasicBlockRef &block) {
+  OracleBlock result;
+  result.start = block->GetStart();
+  result.end = block->GetEnd();
+  if (auto func = block->GetFunction()) {
+    result.function = func->GetStart();
+  }
+  return result;
+}
+
+} // namespace
+
+BinaryViewOracle::BinaryViewOracle(BinaryViewRef view)
+    : view_(view), boundaries_(InstructionBoundaryCache::for_view(view)) {
+  if (view_) {
+    arch_ = view_->GetDefaultArchitecture();
+  }
+  // Resolved once so that concurrent mapping workers only ever take the
+  // map's read lock.
+  if (arch_) {
+    boundary_map_ = &boundaries_->map_for(arch_);
+  }
+}
+
+uint64_t BinaryViewOracle::start() const {
+  return view_ ? view_->GetStart() : 0;
+}
+
+uint64_t BinaryViewOracle::end() const { return view_ ? view_->GetEnd() : 0; }
+
+uint64_t BinaryViewOracle::image_base() const {
+  return view_ ? view_->GetImageBase() : 0;
+}
+
+std::string BinaryViewOracle::original_filename() const {
+  if (!view_) {
+    return {};
+  }
+  auto file = view_->GetFile();
+  return file ? file->GetOriginalFilename() : std::string{};
+}
+
+bool BinaryViewOracle::is_valid_offset(uint64_t addr) const {
+  return view_ && view_->IsValidOffset(addr);
+}
+
+uint64_t BinaryViewOracle::instruction_length(uint64_t addr) const {
+  if (!boundary_map_) {
+    return 0;
+  }
+  return boundaries_->decode_length(*boundary_map_, arch_, addr);
+}
+
+uint64_t BinaryViewOracle::max_instruction_length() const {
+  if (!arch_) {
+    return kDefaultMaxInstructionLength;
+  }
+  const auto max_len = arch_->GetMaxInstructionLength();
+  return max_len == 0 ? kDefaultMaxInstructionLength
+                      : static_cast<uint64_t>(max_len);
+}
+
+uint64_t BinaryViewOracle::instruction_alignment() const {
+  const size_t alignment = arch_ ? arch_->GetInstructionAlignment() : 0;
+  return alignment == 0 ? 1 : static_cast<uint64_t>(alignment);
+}
+
+std::vector<OracleSegment> BinaryViewOracle::segments() const {
+  std::vector<OracleSegment> result;
+  if (!view_) {
+    return result;
+  }
+  for (const auto &segment : view_->GetSegments()) {
+    if (segment) {
+      result.push_back(to_oracle_segment(segment));
+    }
+  }
+  return result;
+}
+
+std::optional<OracleSegment>
+BinaryViewOracle::segment_at(uint64_t addr) const {
+  if (!view_) {
+    return std::nullopt;
+  }
+  auto segment = view_->GetSegmentAt(addr);
+  if (!segment) {
+    return std::nullopt;
+  }
+  return to_oracle_segment(segment);
+}
+
+std::vector<OracleSection> BinaryViewOracle::sections_at(uint64_t addr) const {
+  std::vector<OracleSection> result;
+  if (!view_) {
+    return result;
+  }
+  for (const auto &section : view_->GetSectionsAt(addr)) {
+    if (!section) {
+      continue;
+    }
+    OracleSection entry;
+    entry.start = section->GetStart();
+    entry.end = section->GetEnd();
+    entry.read_only_code =
+        section->GetSemantics() == ReadOnlyCodeSectionSemantics;
+    result.push_back(entry);
+  }
+  return result;
+}
+
+bool BinaryViewOracle::has_data_variable(uint64_t addr) const {
+  if (!view_) {
+    return false;
+  }
+  BinaryNinja::DataVariable var;
+  return view_->GetDataVariableAtAddress(addr, var);
+}
+
+std::vector<OracleBlock> BinaryViewOracle::basic_blocks() const {
+  std::vector<OracleBlock> result;
+  if (!view_) {
+    return result;
+  }
+  for (const auto &func : view_->GetAnalysisFunctionList()) {
+    if (!func) {
+      continue;
+    }
+    const uint64_t entry = func->GetStart();
+    for (const auto &block : func->GetBasicBlocks()) {
+      if (block) {
+        result.push_back({block->GetStart(), block->GetEnd(), entry});
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<OracleBlock>
+BinaryViewOracle::basic_blocks_at(uint64_t addr) const {
+  std::vector<OracleBlock> result;
+  if (!view_) {
+    return result;
+  }
+  for (const auto &block : view_->GetBasicBlocksForAddress(addr)) {
+    if (block) {
+      result.push_back(to_oracle_block(block));
+    }
+  }
+  return result;
+}
+
+std::vector<uint64_t>
+BinaryViewOracle::functions_containing(uint64_t addr) const {
+  std::vector<uint64_t> result;
+  if (!view_) {
+    return result;
+  }
+  for (const auto &func : view_->GetAnalysisFunctionsContainingAddress(addr)) {
+    if (func) {
+      result.push_back(func->GetStart());
+    }
+  }
+  return result;
+}
+
+std::string BinaryViewOracle::function_name(uint64_t function) const {
+  if (!view_) {
+    return {};
+  }
+  for (const auto &func : view_->GetAnalysisFunctionsForAddress(function)) {
+    if (!func || func->GetStart() != function) {
+      continue;
+    }
+    auto sym = func->GetSymbol();
+    if (!sym) {
+      return {};
+    }
+    auto name = sym->GetShortName();
+    if (name.empty()) {
+      name = sym->GetFullName();
+    }
+    return name;
+  }
+  return {};
+}
+
+uint64_t BinaryViewOracle::content_hash() const {
+  std::call_once(content_hash_once_, [this]() {
+    if (!view_) {
+      return;
+    }
+    // The raw parent view holds the file as loaded; the view itself may map
+    // it at a different base or with gaps.
+    BinaryViewRef raw = view_->GetParentView();
+    if (!raw) {
+      raw = view_;
+    }
+    ContentHasher hasher;
+    const uint64_t start = raw->GetStart();
+    const uint64_t length = raw->GetLength();
+    for (uint64_t offset = 0; offset < length; offset += kHashChunkSize) {
+      const size_t chunk =
+          static_cast<size_t>(std::min(kHashChunkSize, length - offset));
+      BinaryNinja::DataBuffer buffer = raw->ReadBuffer(start + offset, chunk);
+      hasher.update({static_cast<const uint8_t *>(buffer.GetData()),
+                     buffer.GetLength()});
+    }
+    content_hash_ = hasher.finish();
+  });
+  return content_hash_;
+}
+
+} // namespace binja::covex::core
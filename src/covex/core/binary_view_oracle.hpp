@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "binaryninjaapi.h"
+#include "covex/core/instruction_boundary_cache.hpp"
+#include "covex/core/view_oracle.hpp"
+#include "uitypes.h"
+
+namespace binja::covex::core {
+
+// ViewOracle backed by a live BinaryView. Instruction lengths go through the
+// view's shared InstructionBoundaryCache.
+class BinaryViewOracle final : public ViewOracle {
+public:
+  explicit BinaryViewOracle(BinaryViewRef view);
+
+  BinaryViewRef view() const { return view_; }
+
+  uint64_t start() const override;
+  uint64_t end() const override;
+  uint64_t image_base() const override;
+  std::string original_filename() const override;
+  bool is_valid_offset(uint64_t addr) const override;
+
+  uint64_t instruction_length(uint64_t addr) const override;
+  uint64_t max_instruction_length() const override;
+  uint64_t instruction_alignment() const override;
+
+  std::vector<OracleSegment> segments() const override;
+  std::optional<OracleSegment> segment_at(uint64_t addr) const override;
+  std::vector<OracleSection> sections_at(uint64_t addr) const override;
+  bool has_data_variable(uint64_t addr) const override;
+
+  std::vector<OracleBlock> basic_blocks() const override;
+  std::vector<OracleBlock> basic_blocks_at(uint64_t addr) const override;
+  std::vector<uint64_t> functions_containing(uint64_t addr) const override;
+  std::string function_name(uint64_t function) const override;
+
+  // Hash of the raw file contents behind the view, computed on first use.
+  uint64_t content_hash() const;
+
+private:
+  BinaryViewRef view_;
+  ArchitectureRef arch_;
+  std::shared_ptr<InstructionBoundaryCache> boundaries_;
+  // boundaries_'s map for arch_, or null without an architecture.
+  InstructionBoundaryMap *boundary_map_ = nullptr;
+  mutable std::once_flag content_hash_once_;
+  mutable uint64_t content_hash_ = 0;
+};
+
+} // namespace binja::covex::core
@@ -0,0 +1,29 @@
+#include "covex/core/block_index.hpp"
+
+#include <algorithm>
+
+namespace binja::covex::core {
+
+BlockIndex BlockIndex::build(const ViewOracle &view) {
+  BlockIndex index;
+  for (const auto &block : view.basic_blocks()) {
+    if (block.end > block.start) {
+      index.intervals_.push_back({block.start, block.end, block.function});
+    }
+  }
+
+  // Stable so that a block shared by several functions keeps the first one.
+  std::stable_sort(index.intervals_.begin(), index.intervals_.end(),
+                   [](const Interval &a, const Interval &b) {
+                     return a.start < b.start;
+                   });
+  index.intervals_.erase(
+      std::unique(index.intervals_.begin(), index.intervals_.end(),
+                  [](const Interval &a, const Interval &b) {
+                    return a.start == b.start;
+                  }),
+      index.intervals_.end());
+  return index;
+}
+
+} // namespace binja::covex::core
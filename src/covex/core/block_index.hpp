@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "covex/core/view_oracle.hpp"
+
+namespace binja::covex::core {
+
+// Snapshot of every basic block in a view as [start, end) intervals sorted by
+// start, each tagged with the entry address of its function. Blocks shared by
+// several functions appear once, attributed to the first function enumerated.
+// Distinct blocks may still overlap (e.g. around overlapping instructions).
+class BlockIndex {
+public:
+  struct Interval {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint64_t function = 0;
+  };
+
+  static BlockIndex build(const ViewOracle &view);
+
+  const std::vector<Interval> &intervals() const { return intervals_; }
+
+private:
+  std::vector<Interval> intervals_;
+};
+
+} // namespace binja::covex::core
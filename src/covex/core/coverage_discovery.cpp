@@ -1,5 +1,6 @@
 #include "covex/core/coverage_discovery.hpp"
 
+#include <algorithm>
 #include <unordered_set>
 
 #include "binaryninjaapi.h"
@@ -8,119 +9,68 @@ namespace binja::covex::core {
 
 namespace {
 
-uint64_t max_instruction_length(BinaryViewRef view) {
-  if (!view) {
-    return 16;
-  }
-  auto arch = view->GetDefaultArchitecture();
-  if (!arch) {
-    return 16;
-  }
-  const auto max_len = arch->GetMaxInstructionLength();
-  return max_len == 0 ? 16 : static_cast<uint64_t>(max_len);
-}
-
-bool is_valid_instruction(BinaryViewRef view, uint64_t addr, uint64_t max_len) {
-  if (!view) {
-    return false;
-  }
-  auto arch = view->GetDefaultArchitecture();
-  if (!arch) {
-    return false;
-  }
-  const uint64_t length = view->GetInstructionLength(arch, addr);
+bool is_valid_instruction(const ViewOracle &view, uint64_t addr,
+                          uint64_t max_len) {
+  const uint64_t length = view.instruction_length(addr);
   return length != 0 && length <= max_len;
 }
 
-bool is_executable_segment(BinaryViewRef view, uint64_t addr,
+bool is_executable_segment(const ViewOracle &view, uint64_t addr,
                            const CoverageDiscoverySettings &settings,
                            DiscoverySkipReason &reason) {
-  if (!view) {
-    reason = DiscoverySkipReason::NonExecutableSegment;
-    return false;
-  }
-  auto segment = view->GetSegmentAt(addr);
+  const auto segment = view.segment_at(addr);
   if (!segment) {
     reason = DiscoverySkipReason::NonExecutableSegment;
     return false;
   }
-  const uint32_t flags = segment->GetFlags();
-  if ((flags & SegmentDenyExecute) != 0) {
+  if (segment->deny_execute) {
     reason = DiscoverySkipReason::DenyExecute;
     return false;
   }
-  if ((flags & SegmentExecutable) == 0) {
+  if (!segment->executable) {
     reason = DiscoverySkipReason::NonExecutableSegment;
     return false;
   }
-  if (settings.require_segment_code_flag &&
-      (flags & SegmentContainsCode) == 0) {
+  if (settings.require_segment_code_flag && !segment->contains_code) {
     reason = DiscoverySkipReason::NonExecutableSegment;
     return false;
   }
   return true;
 }
 
-bool is_code_section(BinaryViewRef view, uint64_t addr,
+bool is_code_section(const ViewOracle &view, uint64_t addr,
                      DiscoverySkipReason &reason) {
-  if (!view) {
+  const auto sections = view.sections_at(addr);
+  const bool code = std::any_of(
+      sections.begin(), sections.end(),
+      [](const OracleSection &section) { return section.read_only_code; });
+  if (!code) {
     reason = DiscoverySkipReason::SectionNotCode;
-    return false;
   }
-  const auto sections = view->GetSectionsAt(addr);
-  if (sections.empty()) {
-    reason = DiscoverySkipReason::SectionNotCode;
-    return false;
-  }
-  for (const auto &section : sections) {
-    if (!section) {
-      continue;
-    }
-    const auto semantics = section->GetSemantics();
-    if (semantics == ReadOnlyCodeSectionSemantics) {
-      return true;
-    }
-  }
-  reason = DiscoverySkipReason::SectionNotCode;
-  return false;
-}
-
-bool has_data_variable(BinaryViewRef view, uint64_t addr) {
-  if (!view) {
-    return false;
-  }
-  BinaryNinja::DataVariable var;
-  return view->GetDataVariableAtAddress(addr, var);
+  return code;
 }
 
-uint64_t find_entrypoint_linear(BinaryViewRef view, uint64_t addr,
+uint64_t find_entrypoint_linear(const ViewOracle &view, uint64_t addr,
                                 uint64_t backward_scan_bytes) {
-  if (!view || backward_scan_bytes == 0) {
-    return addr;
-  }
-  auto arch = view->GetDefaultArchitecture();
-  if (!arch) {
+  if (backward_scan_bytes == 0) {
     return addr;
   }
-  const uint64_t max_len = max_instruction_length(view);
-  size_t alignment = arch->GetInstructionAlignment();
-  if (alignment == 0) {
-    alignment = 1;
-  }
+  const uint64_t max_len = view.max_instruction_length();
+  const uint64_t alignment = view.instruction_alignment();
   uint64_t start = addr > backward_scan_bytes ? addr - backward_scan_bytes
-                                              : view->GetStart();
-  if (start < view->GetStart()) {
-    start = view->GetStart();
+                                              : view.start();
+  if (start < view.start()) {
+    start = view.start();
   }
   uint64_t best = addr;
   uint64_t candidate = addr;
   while (true) {
-    if (view->IsValidOffset(candidate) &&
+    if (view.is_valid_offset(candidate) &&
         is_valid_instruction(view, candidate, max_len)) {
       uint64_t cursor = candidate;
       bool ok = true;
       while (cursor < addr) {
-        const uint64_t length = view->GetInstructionLength(arch, cursor);
+        const uint64_t length = view.instruction_length(cursor);
         if (length == 0 || length > max_len) {
           ok = false;
           break;
@@ -172,24 +122,21 @@ const char *discovery_skip_reason_label(DiscoverySkipReason reason) {
 }
 
 CoverageDiscoveryPlan
-BuildDiscoveryPlan(const CoverageIndex &index, BinaryViewRef view,
+BuildDiscoveryPlan(const CoverageIndex &index, const ViewOracle &view,
                    const CoverageDiscoverySettings &settings) {
   CoverageDiscoveryPlan plan;
-  if (!view) {
-    return plan;
-  }
-  const uint64_t max_len = max_instruction_length(view);
-  for (const auto addr : index.hit_addresses_sorted) {
+  const uint64_t max_len = view.max_instruction_length();
+  for (const auto addr : index.dataset.addresses()) {
     CoverageDiscoveryCandidate candidate;
     candidate.hit_address = addr;
     candidate.entrypoint = addr;
 
-    if (!view->IsValidOffset(addr)) {
+    if (!view.is_valid_offset(addr)) {
       candidate.skip_reason = DiscoverySkipReason::InvalidAddress;
       plan.candidates.push_back(candidate);
       continue;
     }
-    if (!view->GetAnalysisFunctionsContainingAddress(addr).empty()) {
+    if (!view.functions_containing(addr).empty()) {
       candidate.skip_reason = DiscoverySkipReason::InFunction;
       plan.candidates.push_back(candidate);
       continue;
@@ -207,7 +154,7 @@ BuildDiscoveryPlan(const CoverageIndex &index, BinaryViewRef view,
         continue;
       }
     }
-    if (has_data_variable(view, addr)) {
+    if (view.has_data_variable(addr)) {
       candidate.skip_reason = DiscoverySkipReason::DataVariable;
       plan.candidates.push_back(candidate);
       continue;
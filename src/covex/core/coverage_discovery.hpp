@@ -7,6 +7,7 @@
 
 #include "binaryninjaapi.h"
 #include "covex/core/coverage_index.hpp"
+#include "covex/core/view_oracle.hpp"
 #include "uitypes.h"
 
 namespace binja::covex::core {
@@ -48,7 +49,7 @@ struct DiscoveryReport {
 };
 
 CoverageDiscoveryPlan
-BuildDiscoveryPlan(const CoverageIndex &index, BinaryViewRef view,
+BuildDiscoveryPlan(const CoverageIndex &index, const ViewOracle &view,
                    const CoverageDiscoverySettings &settings);
 
 DiscoveryReport ExecuteDiscoveryPlan(const CoverageDiscoveryPlan &plan,
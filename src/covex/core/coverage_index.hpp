@@ -5,11 +5,16 @@
 #include <string>
 #include <vector>
 
+#include "covex/core/invalid_addresses.hpp"
 #include "covex/coverage/coverage_dataset.hpp"
 #include "covex/coverage/coverage_types.hpp"
 
 namespace binja::covex::core {
 
+// One basic block of the view touched by coverage. `hits` sums the
+// instruction hits inside the block, or in block-native indexes sums the hits
+// of the trace blocks overlapping it (the hottest piece, for a block split
+// by an overlapping one).
 struct CoveredBlock {
   uint64_t start = 0;
   uint32_t size = 0;
@@ -18,6 +23,14 @@ struct CoveredBlock {
   std::string function;
 };
 
+// Extent and hit count of one covered stretch of a block-native index: a
+// piece of the view's blocks, or a run outside them clipped from a span.
+struct BlockSpan {
+  uint64_t start = 0;
+  uint32_t size = 0;
+  uint64_t hits = 0;
+};
+
 struct MapDiagnostics {
   size_t spans_total = 0;
   size_t spans_mapped = 0;
@@ -34,9 +47,15 @@ struct MapDiagnostics {
 
 struct CoverageIndex {
   coverage::CoverageDataset dataset;
+  // Block-native indexes key `dataset` by block piece start instead of by
+  // instruction and keep each piece's extent in `block_spans`, sorted by
+  // start. A start appears more than once when spans outside the view's
+  // blocks disagree on its size.
+  bool block_native = false;
+  std::vector<BlockSpan> block_spans;
   std::vector<CoveredBlock> blocks;
-  std::vector<uint64_t> hit_addresses_sorted;
-  std::vector<uint64_t> invalid_addresses;
+  // Addresses that could not be placed in the view, as coalesced runs.
+  InvalidAddressSummary invalid;
   MapDiagnostics diagnostics;
 };
 
@@ -1,34 +1,49 @@
 #include "covex/core/coverage_mapper.hpp"
 
 #include <algorithm>
+#include <iterator>
 #include <limits>
 #include <unordered_map>
-#include <unordered_set>
 
-#include "covex/core/module_matcher.hpp"
+#include "covex/coverage/parallel_for.hpp"
 
 namespace binja::covex::core {
 
 namespace {
 
+// Below this many hit addresses, asking the view per address is cheaper than
+// enumerating every block in it.
+constexpr size_t kSweepThreshold = 4096;
+// Smallest run of spans worth handing to its own worker.
+constexpr size_t kMinSpansPerWorker = 16 * 1024;
 constexpr uint64_t kMaxInstructionLength = 16;
 
+void record_match(const std::optional<ModuleMatch> &match,
+                  MapDiagnostics &diagnostics) {
+  if (!match) {
+    return;
+  }
+  diagnostics.matched_module_id = match->id;
+  diagnostics.matched_module_path = match->path;
+  diagnostics.matched_module_base = match->module_base;
+  diagnostics.matched_module_end = match->module_end;
+  diagnostics.view_image_base = match->view_image_base;
+  diagnostics.match_reason = match->reason;
+  diagnostics.slide = match->slide;
+  diagnostics.used_fallback = match->fallback;
+}
+
 } // namespace
 
-bool CoverageMapper::is_address_in_view(BinaryViewRef view, uint64_t addr) {
-  if (!view) {
-    return false;
-  }
-  return addr >= view->GetStart() && addr < view->GetEnd();
+bool CoverageMapper::is_address_in_view(const ViewOracle &view,
+                                        uint64_t addr) {
+  return addr >= view.start() && addr < view.end();
 }
 
-uint64_t CoverageMapper::instruction_length(BinaryViewRef view, uint64_t addr,
+uint64_t CoverageMapper::instruction_length(const ViewOracle &view,
+                                            uint64_t addr,
                                             uint64_t remaining) {
-  if (!view) {
-    return 1;
-  }
-  auto arch = view->GetDefaultArchitecture();
-  uint64_t length = view->GetInstructionLength(arch, addr);
+  uint64_t length = view.instruction_length(addr);
   if (length == 0 || length > kMaxInstructionLength) {
     length = 1;
   }
@@ -38,31 +53,20 @@ uint64_t CoverageMapper::instruction_length(BinaryViewRef view, uint64_t addr,
   return length;
 }
 
-CoverageIndex CoverageMapper::map_trace(const coverage::CoverageTrace &trace,
-                                        BinaryViewRef view) {
-  coverage::CoverageDataset::HitMap hits;
-  std::unordered_set<uint64_t> invalid;
-  CoverageIndex result;
-  result.diagnostics.spans_total = trace.spans.size();
-
-  const auto match = ModuleMatcher::match(trace, view);
-  if (match) {
-    result.diagnostics.matched_module_id = match->id;
-    result.diagnostics.matched_module_path = match->path;
-    result.diagnostics.matched_module_base = match->module_base;
-    result.diagnostics.matched_module_end = match->module_end;
-    result.diagnostics.view_image_base = match->view_image_base;
-    result.diagnostics.match_reason = match->reason;
-    result.diagnostics.slide = match->slide;
-    result.diagnostics.used_fallback = match->fallback;
-  }
-
-  for (const auto &span : trace.spans) {
+void CoverageMapper::map_spans(std::span<const coverage::CoverageSpan> spans,
+                               const std::optional<ModuleMatch> &match,
+                               const ViewOracle &view,
+                               const coverage::CancellationToken &cancel,
+                               SpanBatch &batch) {
+  batch.hits.reserve(spans.size());
+  for (size_t i = 0; i < spans.size(); ++i) {
+    cancel.poll(i);
+    const auto &span = spans[i];
     if (span.size == 0) {
       continue;
     }
     if (match && span.module_id && *span.module_id != match->id) {
-      ++result.diagnostics.spans_skipped;
+      ++batch.skipped;
       continue;
     }
 
@@ -70,102 +74,292 @@ CoverageIndex CoverageMapper::map_trace(const coverage::CoverageTrace &trace,
     if (match && span.module_id && *span.module_id == match->id) {
       auto adjusted = ModuleMatcher::apply_slide(span.address, match->slide);
       if (!adjusted) {
-        invalid.insert(span.address);
+        batch.invalid.add(span.address, span.module_id);
         continue;
       }
       span_address = *adjusted;
     }
 
-    ++result.diagnostics.spans_mapped;
-    if (!is_address_in_view(view, span_address)) {
-      invalid.insert(span_address);
-      continue;
-    }
-    if (span_address > std::numeric_limits<uint64_t>::max() - span.size) {
-      invalid.insert(span_address);
-      continue;
-    }
+    map_span(span, span_address, view, batch);
+  }
+}
 
-    const uint64_t span_end = span_address + span.size;
-    uint64_t current = span_address;
-    while (current < span_end) {
-      if (!is_address_in_view(view, current)) {
-        invalid.insert(current);
-        break;
-      }
-      hits[current] += span.hits;
-      const uint64_t remaining = span_end - current;
-      const uint64_t length = instruction_length(view, current, remaining);
-      current += length;
+void CoverageMapper::map_span(const coverage::CoverageSpan &span,
+                              uint64_t address, const ViewOracle &view,
+                              SpanBatch &batch) {
+  ++batch.mapped;
+  if (!is_address_in_view(view, address)) {
+    batch.invalid.add(address, span.module_id);
+    return;
+  }
+  if (address > std::numeric_limits<uint64_t>::max() - span.size) {
+    batch.invalid.add(address, span.module_id);
+    return;
+  }
+
+  const uint64_t span_end = address + span.size;
+  uint64_t current = address;
+  while (current < span_end) {
+    if (!is_address_in_view(view, current)) {
+      batch.invalid.add(current, span.module_id);
+      break;
     }
+    batch.hits[current] += span.hits;
+    const uint64_t remaining = span_end - current;
+    current += instruction_length(view, current, remaining);
   }
+}
+
+CoverageIndex CoverageMapper::map_trace(const coverage::CoverageTrace &trace,
+                                        const ViewOracle &view) {
+  return map_trace(trace, view, 0);
+}
+
+CoverageIndex
+CoverageMapper::map_trace(const coverage::CoverageTrace &trace,
+                          const ViewOracle &view, size_t threads,
+                          const coverage::CancellationToken &cancel) {
+  CoverageIndex result;
+  result.diagnostics.spans_total = trace.spans.size();
+
+  const auto match = ModuleMatcher::match(trace, view);
+  record_match(match, result.diagnostics);
 
-  result.dataset = coverage::CoverageDataset::from_hits(std::move(hits));
-  result.blocks = derive_blocks_from_hits(result.dataset.hits(), view);
-  result.hit_addresses_sorted.reserve(result.dataset.hits().size());
-  for (const auto &entry : result.dataset.hits()) {
-    result.hit_addresses_sorted.push_back(entry.first);
+  const size_t span_count = trace.spans.size();
+  if (threads == 0) {
+    threads = span_count < kParallelThreshold
+                  ? 1
+                  : coverage::parallel_worker_count(span_count /
+                                                    kMinSpansPerWorker);
   }
-  std::sort(result.hit_addresses_sorted.begin(),
-            result.hit_addresses_sorted.end());
-  result.invalid_addresses.assign(invalid.begin(), invalid.end());
+  threads = std::max<size_t>(1, std::min(threads, span_count));
+
+  // Each worker maps a contiguous run of spans into its own tables; hits
+  // are summed afterwards, which matches the sequential accumulation.
+  std::vector<SpanBatch> batches(threads);
+  const std::span<const coverage::CoverageSpan> spans(trace.spans);
+  coverage::parallel_for(threads, [&](size_t index) {
+    const size_t begin = span_count * index / threads;
+    const size_t end = span_count * (index + 1) / threads;
+    map_spans(spans.subspan(begin, end - begin), match, view, cancel,
+              batches[index]);
+  });
+
+  finish_batches(batches, view, cancel, result);
   return result;
 }
 
-CoverageIndex
-CoverageMapper::map_dataset(const coverage::CoverageDataset &dataset,
-                            BinaryViewRef view) {
-  coverage::CoverageDataset::HitMap hits;
-  std::unordered_set<uint64_t> invalid;
+void CoverageMapper::finish_batches(std::vector<SpanBatch> &batches,
+                                    const ViewOracle &view,
+                                    const coverage::CancellationToken &cancel,
+                                    CoverageIndex &result) {
+  cancel.throw_if_cancelled();
+  SpanBatch merged;
+  for (auto &batch : batches) {
+    result.diagnostics.spans_mapped += batch.mapped;
+    result.diagnostics.spans_skipped += batch.skipped;
+    if (batch.hits.size() > merged.hits.size()) {
+      std::swap(batch.hits, merged.hits);
+    }
+    merged.hits.merge(batch.hits);
+    batch.hits.clear();
+    merged.invalid.merge(batch.invalid);
+  }
+
+  result.dataset = coverage::CoverageDataset::from_hits(merged.hits);
+  result.blocks = derive_blocks_from_hits(result.dataset, view, cancel);
+  result.invalid = std::move(merged.invalid);
+}
+
+std::vector<CoverageIndex>
+CoverageMapper::map_trace_targets(const coverage::CoverageTrace &trace,
+                                  const std::vector<const ViewOracle *> &views,
+                                  size_t threads,
+                                  const coverage::CancellationToken &cancel) {
+  std::vector<CoverageIndex> results(views.size());
+  if (views.empty()) {
+    return results;
+  }
 
-  for (const auto &[addr, count] : dataset.hits()) {
-    if (!is_address_in_view(view, addr)) {
-      invalid.insert(addr);
+  // Every view claims the module it matches. The first view additionally
+  // takes whatever no other view claims when it matched nothing, as
+  // map_trace would. Traces without modules always go to the first view,
+  // except for addresses inside another view's range that does not overlap
+  // it or any view claimed earlier.
+  std::vector<ModuleRange> ranges;
+  std::optional<size_t> catch_all;
+  const auto overlaps_claimed = [&](uint64_t start, uint64_t end) {
+    if (start < views.front()->end() && views.front()->start() < end) {
+      return true;
+    }
+    return std::any_of(ranges.begin(), ranges.end(),
+                       [&](const ModuleRange &range) {
+                         return start < range.end && range.base < end;
+                       });
+  };
+  for (size_t target = 0; target < views.size(); ++target) {
+    const ViewOracle &view = *views[target];
+    results[target].diagnostics.spans_total = trace.spans.size();
+    if (trace.modules.empty()) {
+      if (target == 0) {
+        catch_all = target;
+      } else if (!overlaps_claimed(view.start(), view.end())) {
+        ranges.push_back({view.start(), view.end(), 0, target, std::nullopt});
+      }
       continue;
     }
-    hits.emplace(addr, count);
+    auto match = ModuleMatcher::match(trace, view);
+    if (match && match->fallback && target != 0) {
+      match.reset();
+    }
+    record_match(match, results[target].diagnostics);
+    if (match) {
+      ranges.push_back({match->module_base, match->module_end, match->slide,
+                        target, match->id});
+    } else if (target == 0) {
+      catch_all = target;
+    }
+  }
+  const ModuleIndex modules(std::move(ranges));
+
+  const size_t span_count = trace.spans.size();
+  if (threads == 0) {
+    threads = span_count < kParallelThreshold
+                  ? 1
+                  : coverage::parallel_worker_count(span_count /
+                                                    kMinSpansPerWorker);
+  }
+  threads = std::max<size_t>(1, std::min(threads, span_count));
+
+  // One pass over the spans routes each to its module's view; workers keep
+  // a batch per view so nothing is shared until the merge.
+  std::vector<std::vector<SpanBatch>> batches(
+      views.size(), std::vector<SpanBatch>(threads));
+  // Per worker: spans seen, then spans routed to each view.
+  std::vector<std::vector<size_t>> routed(
+      threads, std::vector<size_t>(views.size() + 1, 0));
+  coverage::parallel_for(threads, [&](size_t worker) {
+    const size_t begin = span_count * worker / threads;
+    const size_t end = span_count * (worker + 1) / threads;
+    for (size_t i = begin; i < end; ++i) {
+      cancel.poll(i - begin);
+      const auto &span = trace.spans[i];
+      if (span.size == 0) {
+        continue;
+      }
+      const ModuleRange *range = nullptr;
+      if (span.module_id) {
+        range = modules.find_module(*span.module_id);
+      }
+      if (!range) {
+        range = modules.find(span.address);
+        if (range && span.module_id && range->module_id) {
+          range = nullptr;
+        }
+      }
+      std::optional<size_t> target;
+      int64_t slide = 0;
+      if (range) {
+        target = range->target;
+        slide = range->slide;
+      } else {
+        target = catch_all;
+      }
+      ++routed[worker].front();
+      if (!target) {
+        continue;
+      }
+      ++routed[worker][*target + 1];
+      auto &batch = batches[*target][worker];
+      auto adjusted = ModuleMatcher::apply_slide(span.address, slide);
+      if (!adjusted) {
+        batch.invalid.add(span.address, span.module_id);
+        continue;
+      }
+      map_span(span, *adjusted, *views[*target], batch);
+    }
+  });
+
+  for (size_t target = 0; target < views.size(); ++target) {
+    // A span is skipped by every view it was not routed to.
+    for (const auto &counts : routed) {
+      results[target].diagnostics.spans_skipped +=
+          counts.front() - counts[target + 1];
+    }
+    finish_batches(batches[target], *views[target], cancel, results[target]);
   }
+  return results;
+}
 
+CoverageIndex
+CoverageMapper::map_dataset(const coverage::CoverageDataset &dataset,
+                            const ViewOracle &view,
+                            const coverage::CancellationToken &cancel) {
+  cancel.throw_if_cancelled();
   CoverageIndex result;
-  result.dataset = coverage::CoverageDataset::from_hits(std::move(hits));
-  result.blocks = derive_blocks_from_hits(result.dataset.hits(), view);
-  result.hit_addresses_sorted.reserve(result.dataset.hits().size());
-  for (const auto &entry : result.dataset.hits()) {
-    result.hit_addresses_sorted.push_back(entry.first);
-  }
-  std::sort(result.hit_addresses_sorted.begin(),
-            result.hit_addresses_sorted.end());
-  result.invalid_addresses.assign(invalid.begin(), invalid.end());
+  // The view is one contiguous address range, so the in-view entries are a
+  // single slice of the sorted dataset and everything else is invalid.
+  const uint64_t view_start = view.start();
+  const uint64_t view_end = std::max(view_start, view.end());
+  const auto addresses = dataset.addresses();
+  const size_t first = dataset.lower_bound(view_start);
+  const size_t last = dataset.lower_bound(view_end);
+  for (const uint64_t addr : addresses.first(first)) {
+    result.invalid.add(addr);
+  }
+  for (const uint64_t addr : addresses.subspan(last)) {
+    result.invalid.add(addr);
+  }
+
+  result.dataset = dataset.slice(view_start, view_end);
+  result.blocks = derive_blocks_from_hits(result.dataset, view, cancel);
   return result;
 }
 
 std::vector<CoveredBlock> CoverageMapper::derive_blocks_from_hits(
-    const coverage::CoverageDataset::HitMap &hits, BinaryViewRef view) {
+    const coverage::CoverageDataset &dataset, const ViewOracle &view,
+    const coverage::CancellationToken &cancel) {
+  if (dataset.empty()) {
+    return {};
+  }
+  if (dataset.size() < kSweepThreshold) {
+    return derive_blocks_by_lookup(dataset, view, cancel);
+  }
+  const auto index = BlockIndex::build(view);
+  cancel.throw_if_cancelled();
+  return derive_blocks_by_sweep(dataset, index, view, cancel);
+}
+
+std::vector<CoveredBlock> CoverageMapper::derive_blocks_by_lookup(
+    const coverage::CoverageDataset &dataset, const ViewOracle &view,
+    const coverage::CancellationToken &cancel) {
   std::unordered_map<uint64_t, CoveredBlock> blocks;
-  for (const auto &[addr, count] : hits) {
-    if (!view) {
-      break;
-    }
-    const auto candidates = view->GetBasicBlocksForAddress(addr);
-    for (const auto &block : candidates) {
-      if (!block) {
+  std::unordered_map<uint64_t, std::string> names;
+  size_t item = 0;
+  for (const auto &[addr, count] : dataset) {
+    cancel.poll(item++);
+    const auto containing = view.basic_blocks_at(addr);
+    for (auto block_it = containing.begin(); block_it != containing.end();
+         ++block_it) {
+      const auto &block = *block_it;
+      // A block shared by several functions is listed once per function;
+      // like BlockIndex, count it once for its first function.
+      if (std::any_of(containing.begin(), block_it,
+                      [&](const OracleBlock &other) {
+                        return other.start == block.start;
+                      })) {
         continue;
       }
-      const uint64_t start = block->GetStart();
-      auto [it, inserted] = blocks.emplace(start, CoveredBlock{});
+      auto [it, inserted] = blocks.emplace(block.start, CoveredBlock{});
       auto &entry = it->second;
       if (inserted) {
-        entry.start = start;
-        entry.size = static_cast<uint32_t>(block->GetLength());
-        if (auto func = block->GetFunction()) {
-          if (auto sym = func->GetSymbol()) {
-            auto name = sym->GetShortName();
-            if (name.empty()) {
-              name = sym->GetFullName();
-            }
-            entry.function = std::move(name);
-          }
+        entry.start = block.start;
+        entry.size = static_cast<uint32_t>(block.end - block.start);
+        auto [name, named] = names.try_emplace(block.function);
+        if (named) {
+          name->second = view.function_name(block.function);
         }
+        entry.function = name->second;
       }
       entry.hits += count;
     }
@@ -184,4 +378,370 @@ std::vector<CoveredBlock> CoverageMapper::derive_blocks_from_hits(
   return result;
 }
 
+std::vector<CoveredBlock>
+CoverageMapper::derive_blocks_by_sweep(
+    const coverage::CoverageDataset &dataset, const BlockIndex &index,
+    const ViewOracle &view, const coverage::CancellationToken &cancel) {
+  const auto &intervals = index.intervals();
+  std::vector<uint64_t> block_hits(intervals.size(), 0);
+  std::vector<bool> touched(intervals.size(), false);
+
+  // Both sides are sorted by address, so one merge pass assigns every hit.
+  // `active` holds the intervals that started at or before the current
+  // address; it stays tiny because blocks rarely overlap.
+  std::vector<size_t> active;
+  size_t next = 0;
+  size_t item = 0;
+  for (const auto &[addr, count] : dataset) {
+    cancel.poll(item++);
+    while (next < intervals.size() && intervals[next].start <= addr) {
+      active.push_back(next++);
+    }
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [&](size_t i) {
+                                  return intervals[i].end <= addr;
+                                }),
+                 active.end());
+    for (const size_t i : active) {
+      block_hits[i] += count;
+      touched[i] = true;
+    }
+  }
+
+  std::vector<CoveredBlock> result;
+  std::unordered_map<uint64_t, std::string> names;
+  for (size_t i = 0; i < intervals.size(); ++i) {
+    if (!touched[i]) {
+      continue;
+    }
+    const auto &interval = intervals[i];
+    auto [it, inserted] = names.try_emplace(interval.function);
+    if (inserted) {
+      it->second = view.function_name(interval.function);
+    }
+    CoveredBlock block;
+    block.start = interval.start;
+    block.size = static_cast<uint32_t>(interval.end - interval.start);
+    block.hits = block_hits[i];
+    block.function = it->second;
+    result.push_back(std::move(block));
+  }
+  return result;
+}
+
+CoverageIndex
+CoverageMapper::map_trace_blocks(const coverage::CoverageTrace &trace,
+                                 const ViewOracle &view,
+                                 const coverage::CancellationToken &cancel) {
+  CoverageIndex result;
+  result.block_native = true;
+  result.diagnostics.spans_total = trace.spans.size();
+
+  const auto match = ModuleMatcher::match(trace, view);
+  record_match(match, result.diagnostics);
+
+  std::vector<BlockSpan> spans;
+  spans.reserve(trace.spans.size());
+  InvalidAddressSummary invalid;
+  const uint64_t view_end = view.end();
+  for (size_t i = 0; i < trace.spans.size(); ++i) {
+    cancel.poll(i);
+    const auto &span = trace.spans[i];
+    if (span.size == 0) {
+      continue;
+    }
+    if (match && span.module_id && *span.module_id != match->id) {
+      ++result.diagnostics.spans_skipped;
+      continue;
+    }
+
+    uint64_t span_address = span.address;
+    if (match && span.module_id && *span.module_id == match->id) {
+      auto adjusted = ModuleMatcher::apply_slide(span.address, match->slide);
+      if (!adjusted) {
+        invalid.add(span.address, span.module_id);
+        continue;
+      }
+      span_address = *adjusted;
+    }
+
+    ++result.diagnostics.spans_mapped;
+    if (!is_address_in_view(view, span_address) ||
+        span_address > std::numeric_limits<uint64_t>::max() - span.size) {
+      invalid.add(span_address, span.module_id);
+      continue;
+    }
+    // Spans running off the end of the view are cut at it, as the
+    // instruction walk in map_spans would be.
+    uint64_t size = span.size;
+    if (size > view_end - span_address) {
+      size = view_end - span_address;
+      invalid.add(view_end, span.module_id);
+    }
+    spans.push_back({span_address, static_cast<uint32_t>(size), span.hits});
+  }
+
+  result.block_spans = std::move(spans);
+  snap_block_index(result, view, cancel);
+  result.invalid = std::move(invalid);
+  return result;
+}
+
+void CoverageMapper::snap_block_index(
+    CoverageIndex &index, const ViewOracle &view,
+    const coverage::CancellationToken &cancel) {
+  const auto blocks = BlockIndex::build(view);
+  cancel.throw_if_cancelled();
+  index.block_spans =
+      merge_block_spans(snap_to_blocks(index.block_spans, blocks, cancel));
+  std::vector<uint64_t> addresses;
+  std::vector<uint64_t> hits;
+  addresses.reserve(index.block_spans.size());
+  hits.reserve(index.block_spans.size());
+  for (const auto &span : index.block_spans) {
+    if (!addresses.empty() && addresses.back() == span.start) {
+      hits.back() += span.hits;
+      continue;
+    }
+    addresses.push_back(span.start);
+    hits.push_back(span.hits);
+  }
+  index.dataset = coverage::CoverageDataset::from_sorted(std::move(addresses),
+                                                         std::move(hits));
+  index.blocks =
+      derive_blocks_from_spans(index.block_spans, blocks, view, cancel);
+}
+
+CoverageIndex
+CoverageMapper::map_block_dataset(const coverage::CoverageDataset &dataset,
+                                  const std::vector<BlockSpan> &extents,
+                                  const ViewOracle &view,
+                                  const coverage::CancellationToken &cancel) {
+  cancel.throw_if_cancelled();
+  CoverageIndex result;
+  result.block_native = true;
+  const uint64_t view_start = view.start();
+  const uint64_t view_end = std::max(view_start, view.end());
+  const auto addresses = dataset.addresses();
+  const size_t first = dataset.lower_bound(view_start);
+  const size_t last = dataset.lower_bound(view_end);
+  for (const uint64_t addr : addresses.first(first)) {
+    result.invalid.add(addr);
+  }
+  for (const uint64_t addr : addresses.subspan(last)) {
+    result.invalid.add(addr);
+  }
+  result.dataset = dataset.slice(view_start, view_end);
+
+  // Both the dataset and the extents are sorted by start; of several
+  // extents sharing a start, the largest (last) one is used.
+  result.block_spans.reserve(result.dataset.size());
+  auto extent = extents.begin();
+  size_t item = 0;
+  for (const auto &[addr, count] : result.dataset) {
+    cancel.poll(item++);
+    extent = std::upper_bound(extent, extents.end(), addr,
+                              [](uint64_t value, const BlockSpan &span) {
+                                return value < span.start;
+                              });
+    uint64_t size = 1;
+    if (extent != extents.begin() && std::prev(extent)->start == addr) {
+      size = std::min<uint64_t>(std::prev(extent)->size, view_end - addr);
+    }
+    result.block_spans.push_back({addr, static_cast<uint32_t>(size), count});
+  }
+  result.blocks = derive_blocks_from_spans(result.block_spans, view, cancel);
+  return result;
+}
+
+void CoverageMapper::derive_blocks(CoverageIndex &index, const ViewOracle &view,
+                                   const coverage::CancellationToken &cancel) {
+  if (index.block_native) {
+    snap_block_index(index, view, cancel);
+    return;
+  }
+  index.blocks = derive_blocks_from_hits(index.dataset, view, cancel);
+}
+
+coverage::CoverageDataset
+CoverageMapper::expand_instructions(const CoverageIndex &index,
+                                    const ViewOracle &view) {
+  if (!index.block_native) {
+    return index.dataset;
+  }
+  coverage::CoverageDataset::HitMap hits;
+  hits.reserve(index.block_spans.size());
+  for (const auto &span : index.block_spans) {
+    const uint64_t end = span.start + span.size;
+    uint64_t current = span.start;
+    while (current < end) {
+      hits[current] += span.hits;
+      current += instruction_length(view, current, end - current);
+    }
+  }
+  return coverage::CoverageDataset::from_hits(hits);
+}
+
+std::vector<BlockSpan>
+CoverageMapper::merge_block_spans(std::vector<BlockSpan> spans) {
+  std::sort(spans.begin(), spans.end(),
+            [](const BlockSpan &a, const BlockSpan &b) {
+              return a.start != b.start ? a.start < b.start : a.size < b.size;
+            });
+  std::vector<BlockSpan> merged;
+  merged.reserve(spans.size());
+  for (const auto &span : spans) {
+    if (!merged.empty() && merged.back().start == span.start &&
+        merged.back().size == span.size) {
+      merged.back().hits += span.hits;
+      continue;
+    }
+    merged.push_back(span);
+  }
+  return merged;
+}
+
+std::vector<BlockSpan>
+CoverageMapper::snap_to_blocks(const std::vector<BlockSpan> &spans,
+                               const BlockIndex &index,
+                               const coverage::CancellationToken &cancel) {
+  // Every block start and end splits the view into pieces; a piece lies
+  // either inside some block or in no block at all.
+  const auto &intervals = index.intervals();
+  std::vector<uint64_t> bounds;
+  bounds.reserve(intervals.size() * 2);
+  for (const auto &interval : intervals) {
+    bounds.push_back(interval.start);
+    bounds.push_back(interval.end);
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  // depth[i] counts the blocks covering [bounds[i], bounds[i + 1]).
+  std::vector<int64_t> depth(bounds.size(), 0);
+  const auto bound_index = [&](uint64_t addr) {
+    return static_cast<size_t>(
+        std::lower_bound(bounds.begin(), bounds.end(), addr) - bounds.begin());
+  };
+  for (const auto &interval : intervals) {
+    ++depth[bound_index(interval.start)];
+    --depth[bound_index(interval.end)];
+  }
+  for (size_t i = 1; i < depth.size(); ++i) {
+    depth[i] += depth[i - 1];
+  }
+
+  // A span claims each block piece it touches whole, so traces whose blocks
+  // split the view's differently still key the same code by the same start.
+  // Stretches outside every block keep the span's own bounds.
+  std::vector<BlockSpan> result;
+  result.reserve(spans.size());
+  for (size_t s = 0; s < spans.size(); ++s) {
+    cancel.poll(s);
+    const auto &span = spans[s];
+    const uint64_t span_end = span.start + span.size;
+    uint64_t current = span.start;
+    bool outside = false;
+    while (current < span_end) {
+      const auto next =
+          std::upper_bound(bounds.begin(), bounds.end(), current);
+      const uint64_t piece_end =
+          next == bounds.end() ? span_end : std::min(*next, span_end);
+      const bool inside =
+          next != bounds.begin() && next != bounds.end() &&
+          depth[static_cast<size_t>(next - bounds.begin()) - 1] > 0;
+      if (inside) {
+        const uint64_t piece_start = *std::prev(next);
+        result.push_back({piece_start,
+                          static_cast<uint32_t>(*next - piece_start),
+                          span.hits});
+        current = *next;
+      } else {
+        if (outside) {
+          result.back().size += static_cast<uint32_t>(piece_end - current);
+        } else {
+          result.push_back({current,
+                            static_cast<uint32_t>(piece_end - current),
+                            span.hits});
+        }
+        current = piece_end;
+      }
+      outside = !inside;
+    }
+  }
+  return result;
+}
+
+std::vector<CoveredBlock>
+CoverageMapper::derive_blocks_from_spans(
+    const std::vector<BlockSpan> &spans, const ViewOracle &view,
+    const coverage::CancellationToken &cancel) {
+  if (spans.empty()) {
+    return {};
+  }
+  const auto index = BlockIndex::build(view);
+  cancel.throw_if_cancelled();
+  return derive_blocks_from_spans(spans, index, view, cancel);
+}
+
+std::vector<CoveredBlock>
+CoverageMapper::derive_blocks_from_spans(
+    const std::vector<BlockSpan> &spans, const BlockIndex &index,
+    const ViewOracle &view, const coverage::CancellationToken &cancel) {
+  if (spans.empty()) {
+    return {};
+  }
+  const auto &intervals = index.intervals();
+  uint64_t max_interval = 0;
+  for (const auto &interval : intervals) {
+    max_interval = std::max(max_interval, interval.end - interval.start);
+  }
+
+  // Spans are snapped to block pieces, and a block split into several
+  // pieces by an overlapping block takes its hottest piece's hits. Only
+  // blocks starting less than the largest block size before a span can
+  // reach into it.
+  std::vector<uint64_t> block_hits(intervals.size(), 0);
+  std::vector<bool> touched(intervals.size(), false);
+  for (size_t s = 0; s < spans.size(); ++s) {
+    cancel.poll(s);
+    const auto &span = spans[s];
+    const uint64_t span_end = span.start + span.size;
+    const uint64_t lowest =
+        span.start > max_interval ? span.start - max_interval : 0;
+    auto it = std::lower_bound(intervals.begin(), intervals.end(), lowest,
+                               [](const BlockIndex::Interval &interval,
+                                  uint64_t value) {
+                                 return interval.start < value;
+                               });
+    for (; it != intervals.end() && it->start < span_end; ++it) {
+      if (it->end <= span.start) {
+        continue;
+      }
+      const auto i = static_cast<size_t>(it - intervals.begin());
+      block_hits[i] = std::max(block_hits[i], span.hits);
+      touched[i] = true;
+    }
+  }
+
+  std::vector<CoveredBlock> result;
+  std::unordered_map<uint64_t, std::string> names;
+  for (size_t i = 0; i < intervals.size(); ++i) {
+    if (!touched[i]) {
+      continue;
+    }
+    const auto &interval = intervals[i];
+    auto [it, inserted] = names.try_emplace(interval.function);
+    if (inserted) {
+      it->second = view.function_name(interval.function);
+    }
+    CoveredBlock block;
+    block.start = interval.start;
+    block.size = static_cast<uint32_t>(interval.end - interval.start);
+    block.hits = block_hits[i];
+    block.function = it->second;
+    result.push_back(std::move(block));
+  }
+  return result;
+}
+
 } // namespace binja::covex::core
@@ -2,30 +2,128 @@
 
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
-#include "binaryninjaapi.h"
+#include "covex/core/block_index.hpp"
 #include "covex/core/coverage_index.hpp"
+#include "covex/core/module_index.hpp"
+#include "covex/core/module_matcher.hpp"
+#include "covex/core/view_oracle.hpp"
+#include "covex/coverage/cancellation.hpp"
 #include "covex/coverage/coverage_dataset.hpp"
 #include "covex/coverage/coverage_types.hpp"
-#include "uitypes.h"
 
 namespace binja::covex::core {
 
+// Mapping calls taking a cancellation token throw
+// coverage::OperationCancelled once it is cancelled.
 class CoverageMapper {
 public:
+  // Traces with at least this many spans are mapped on several threads by
+  // default.
+  static constexpr size_t kParallelThreshold = 64 * 1024;
+
+  CoverageIndex map_trace(const coverage::CoverageTrace &trace,
+                          const ViewOracle &view);
+  // threads == 0 picks a worker count from the span count; 1 is sequential.
+  // The view must answer queries from several threads at once.
   CoverageIndex map_trace(const coverage::CoverageTrace &trace,
-                          BinaryViewRef view);
+                          const ViewOracle &view, size_t threads,
+                          const coverage::CancellationToken &cancel = {});
   CoverageIndex map_dataset(const coverage::CoverageDataset &dataset,
-                            BinaryViewRef view);
+                            const ViewOracle &view,
+                            const coverage::CancellationToken &cancel = {});
+  // Maps one trace into several views in a single pass, routing each span
+  // to the view whose module contains it (by drcov module id, or by address
+  // for traces without modules). The first view is the one the trace was
+  // loaded for; it also receives spans no view claims when none of its
+  // modules matched. Traces without modules are shared only with views whose
+  // ranges do not overlap the first view's. Returns one index per view, in
+  // order.
+  std::vector<CoverageIndex>
+  map_trace_targets(const coverage::CoverageTrace &trace,
+                    const std::vector<const ViewOracle *> &views,
+                    size_t threads = 0,
+                    const coverage::CancellationToken &cancel = {});
+
+  // Block-native mapping: keeps (start, size, hits) records instead of
+  // expanding spans into instructions. Spans are snapped to the view's
+  // blocks, so datasets from traces that split blocks differently compose
+  // as their instructions would.
+  CoverageIndex
+  map_trace_blocks(const coverage::CoverageTrace &trace, const ViewOracle &view,
+                   const coverage::CancellationToken &cancel = {});
+  // Maps a dataset keyed by block start, taking block sizes from `extents`
+  // (as returned by merge_block_spans). Starts without an extent are treated
+  // as one-byte blocks.
+  CoverageIndex
+  map_block_dataset(const coverage::CoverageDataset &dataset,
+                    const std::vector<BlockSpan> &extents,
+                    const ViewOracle &view,
+                    const coverage::CancellationToken &cancel = {});
+  // Replaces `index.blocks` with the blocks of the view's current analysis
+  // that the dataset, or a block-native index's block spans, covers. A
+  // block-native index's spans and dataset are first re-snapped to the
+  // current blocks.
+  void derive_blocks(CoverageIndex &index, const ViewOracle &view,
+                     const coverage::CancellationToken &cancel = {});
+  // Per-instruction hits of a block-native index, for instruction-level
+  // consumers.
+  coverage::CoverageDataset expand_instructions(const CoverageIndex &index,
+                                                const ViewOracle &view);
+
+  // Sorts spans by start, then size, and merges identical extents by summing
+  // their hits.
+  static std::vector<BlockSpan> merge_block_spans(std::vector<BlockSpan> spans);
 
 private:
+  struct SpanBatch {
+    coverage::CoverageDataset::HitMap hits;
+    InvalidAddressSummary invalid;
+    size_t mapped = 0;
+    size_t skipped = 0;
+  };
+
+  static void map_spans(std::span<const coverage::CoverageSpan> spans,
+                        const std::optional<ModuleMatch> &match,
+                        const ViewOracle &view,
+                        const coverage::CancellationToken &cancel,
+                        SpanBatch &batch);
+  static void map_span(const coverage::CoverageSpan &span, uint64_t address,
+                       const ViewOracle &view, SpanBatch &batch);
+  static void finish_batches(std::vector<SpanBatch> &batches,
+                             const ViewOracle &view,
+                             const coverage::CancellationToken &cancel,
+                             CoverageIndex &result);
+  static std::vector<CoveredBlock>
+  derive_blocks_from_hits(const coverage::CoverageDataset &dataset,
+                          const ViewOracle &view,
+                          const coverage::CancellationToken &cancel);
+  static std::vector<CoveredBlock>
+  derive_blocks_by_lookup(const coverage::CoverageDataset &dataset,
+                          const ViewOracle &view,
+                          const coverage::CancellationToken &cancel);
+  static std::vector<CoveredBlock>
+  derive_blocks_by_sweep(const coverage::CoverageDataset &dataset,
+                         const BlockIndex &index, const ViewOracle &view,
+                         const coverage::CancellationToken &cancel);
+  static void snap_block_index(CoverageIndex &index, const ViewOracle &view,
+                               const coverage::CancellationToken &cancel);
+  static std::vector<BlockSpan>
+  snap_to_blocks(const std::vector<BlockSpan> &spans, const BlockIndex &index,
+                 const coverage::CancellationToken &cancel);
+  static std::vector<CoveredBlock>
+  derive_blocks_from_spans(const std::vector<BlockSpan> &spans,
+                           const ViewOracle &view,
+                           const coverage::CancellationToken &cancel);
   static std::vector<CoveredBlock>
-  derive_blocks_from_hits(const coverage::CoverageDataset::HitMap &hits,
-                          BinaryViewRef view);
-  static bool is_address_in_view(BinaryViewRef view, uint64_t addr);
-  static uint64_t instruction_length(BinaryViewRef view, uint64_t addr,
+  derive_blocks_from_spans(const std::vector<BlockSpan> &spans,
+                           const BlockIndex &index, const ViewOracle &view,
+                           const coverage::CancellationToken &cancel);
+  static bool is_address_in_view(const ViewOracle &view, uint64_t addr);
+  static uint64_t instruction_length(const ViewOracle &view, uint64_t addr,
                                      uint64_t remaining);
 };
 
@@ -0,0 +1,566 @@
+#include "covex/core/index_cache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "covex/coverage/mapped_file.hpp"
+
+namespace binja::covex::core {
+
+namespace {
+
+constexpr uint64_t kHashMultiplier1 = 0x9e3779b97f4a7c15ULL;
+constexpr uint64_t kHashMultiplier2 = 0xc2b2ae3d27d4eb4fULL;
+
+uint64_t hash_word(uint64_t state, uint64_t word) {
+  return std::rotl(state ^ (word * kHashMultiplier1), 31) * kHashMultiplier2;
+}
+
+constexpr char kMagic[8] = {'C', 'V', 'X', 'I', 'N', 'D', 'E', 'X'};
+constexpr const char *kExtension = ".cvxidx";
+// Written in host order; a file from a host of the other byte order reads
+// back as a different tag and is treated as a miss.
+constexpr uint32_t kEndianTag = 0x01020304;
+
+enum class SectionId : uint32_t {
+  Addresses = 1,
+  Hits,
+  BlockSpans,
+  InvalidRanges,
+  InvalidModules,
+  Diagnostics,
+  Trace,
+  Modules,
+  Strings,
+};
+
+constexpr uint32_t kFlagBlockNative = 1;
+
+constexpr uint32_t kDiagModuleId = 1;
+constexpr uint32_t kDiagModuleBase = 2;
+constexpr uint32_t kDiagModuleEnd = 4;
+constexpr uint32_t kDiagUsedFallback = 8;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t trace_hash;
+  uint64_t binary_hash;
+  uint64_t image_base;
+  uint64_t peers_hash;
+  uint32_t endian_tag;
+  uint32_t section_count;
+};
+
+struct SectionEntry {
+  uint32_t id;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct StringRef {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct BlockSpanRecord {
+  uint64_t start;
+  uint64_t hits;
+  uint32_t size;
+  uint32_t reserved;
+};
+
+struct InvalidModuleRecord {
+  uint32_t module_id;
+  uint32_t reserved;
+  uint64_t count;
+};
+
+struct DiagnosticsRecord {
+  uint64_t spans_total;
+  uint64_t spans_mapped;
+  uint64_t spans_skipped;
+  uint64_t matched_module_base;
+  uint64_t matched_module_end;
+  uint64_t view_image_base;
+  int64_t slide;
+  uint32_t matched_module_id;
+  uint32_t flags;
+  StringRef matched_module_path;
+  StringRef match_reason;
+};
+
+struct TraceMetaRecord {
+  uint32_t format;
+  uint32_t has_hitcounts;
+};
+
+struct ModuleRecord {
+  uint32_t id;
+  uint32_t reserved;
+  uint64_t base;
+  uint64_t end;
+  StringRef path;
+};
+
+static_assert(sizeof(FileHeader) == 56);
+static_assert(sizeof(SectionEntry) == 24);
+static_assert(sizeof(BlockSpanRecord) == 24);
+static_assert(sizeof(InvalidRange) == 24);
+static_assert(std::is_trivially_copyable_v<InvalidRange>);
+
+constexpr uint64_t align8(uint64_t value) { return (value + 7) & ~uint64_t{7}; }
+
+class CacheWriter {
+public:
+  template <typename T>
+  void add(SectionId id, const std::vector<T> &records) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::string bytes(records.size() * sizeof(T), '\0');
+    if (!records.empty()) {
+      std::memcpy(bytes.data(), records.data(), bytes.size());
+    }
+    sections_.emplace_back(id, std::move(bytes));
+  }
+
+  StringRef intern(const std::string &value) {
+    StringRef ref{strings_.size(), value.size()};
+    strings_ += value;
+    return ref;
+  }
+
+  void write(std::ostream &out, const FileHeader &base) {
+    sections_.emplace_back(SectionId::Strings, std::move(strings_));
+
+    FileHeader header = base;
+    header.section_count = static_cast<uint32_t>(sections_.size());
+    std::vector<SectionEntry> table;
+    uint64_t offset = align8(sizeof(FileHeader) +
+                             sections_.size() * sizeof(SectionEntry));
+    for (const auto &[id, bytes] : sections_) {
+      table.push_back({static_cast<uint32_t>(id), 0, offset, bytes.size()});
+      offset = align8(offset + bytes.size());
+    }
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(
+        reinterpret_cast<const char *>(table.data()),
+        static_cast<std::streamsize>(table.size() * sizeof(SectionEntry)));
+    uint64_t written = sizeof(header) + table.size() * sizeof(SectionEntry);
+    static constexpr char kPadding[8] = {};
+    for (size_t i = 0; i < sections_.size(); ++i) {
+      out.write(kPadding, static_cast<std::streamsize>(table[i].offset -
+                                                       written));
+      const auto &bytes = sections_[i].second;
+      out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+      written = table[i].offset + bytes.size();
+    }
+  }
+
+private:
+  std::vector<std::pair<SectionId, std::string>> sections_;
+  std::string strings_;
+};
+
+[[noreturn]] void corrupt(const std::filesystem::path &path,
+                          const std::string &what) {
+  throw std::runtime_error("Corrupt coverage index cache entry " +
+                           path.string() + ": " + what);
+}
+
+class CacheReader {
+public:
+  CacheReader(const coverage::MappedFile &file,
+              const std::filesystem::path &path)
+      : file_(file), path_(path) {}
+
+  void read_table(const FileHeader &header) {
+    const uint64_t table_end =
+        sizeof(FileHeader) +
+        static_cast<uint64_t>(header.section_count) * sizeof(SectionEntry);
+    if (table_end > file_.size()) {
+      corrupt(path_, "truncated section table");
+    }
+    table_.resize(header.section_count);
+    std::memcpy(table_.data(), file_.data() + sizeof(FileHeader),
+                table_.size() * sizeof(SectionEntry));
+    for (const auto &entry : table_) {
+      if (entry.offset > file_.size() ||
+          entry.size > file_.size() - entry.offset) {
+        corrupt(path_, "section out of bounds");
+      }
+    }
+    strings_ = section(SectionId::Strings);
+  }
+
+  template <typename T> std::vector<T> records(SectionId id) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const auto bytes = section(id);
+    if (bytes.size() % sizeof(T) != 0) {
+      corrupt(path_, "section size is not a whole number of records");
+    }
+    std::vector<T> result(bytes.size() / sizeof(T));
+    if (!result.empty()) {
+      std::memcpy(result.data(), bytes.data(), bytes.size());
+    }
+    return result;
+  }
+
+  std::string string(const StringRef &ref) const {
+    if (ref.offset > strings_.size() ||
+        ref.size > strings_.size() - ref.offset) {
+      corrupt(path_, "string out of bounds");
+    }
+    return std::string(strings_.substr(static_cast<size_t>(ref.offset),
+                                       static_cast<size_t>(ref.size)));
+  }
+
+private:
+  std::string_view section(SectionId id) const {
+    for (const auto &entry : table_) {
+      if (entry.id == static_cast<uint32_t>(id)) {
+        return file_.view().substr(static_cast<size_t>(entry.offset),
+                                   static_cast<size_t>(entry.size));
+      }
+    }
+    return {};
+  }
+
+  const coverage::MappedFile &file_;
+  const std::filesystem::path &path_;
+  std::vector<SectionEntry> table_;
+  std::string_view strings_;
+};
+
+} // namespace
+
+void ContentHasher::update(std::span<const uint8_t> bytes) {
+  length_ += bytes.size();
+  size_t pos = 0;
+  while (tail_size_ != 0 && pos < bytes.size()) {
+    tail_ |= static_cast<uint64_t>(bytes[pos++]) << (8 * tail_size_);
+    if (++tail_size_ == 8) {
+      state_ = hash_word(state_, tail_);
+      tail_ = 0;
+      tail_size_ = 0;
+    }
+  }
+  for (; pos + 8 <= bytes.size(); pos += 8) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes.data() + pos, sizeof(word));
+    state_ = hash_word(state_, word);
+  }
+  for (; pos < bytes.size(); ++pos) {
+    tail_ |= static_cast<uint64_t>(bytes[pos]) << (8 * tail_size_++);
+  }
+}
+
+uint64_t ContentHasher::finish() const {
+  uint64_t hash = state_;
+  if (tail_size_ != 0) {
+    hash = hash_word(hash, tail_);
+  }
+  hash ^= length_;
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+IndexCache::IndexCache(std::filesystem::path directory)
+    : directory_(std::move(directory)) {}
+
+uint64_t IndexCache::hash_file(const std::string &path) {
+  const auto file = coverage::MappedFile::open(path);
+  ContentHasher hasher;
+  hasher.update({file.data(), file.size()});
+  return hasher.finish();
+}
+
+void IndexCache::link_peers(std::vector<IndexCacheKey> &keys) {
+  if (keys.size() < 2) {
+    return;
+  }
+  uint64_t views = kHashMultiplier2;
+  for (const auto &key : keys) {
+    views = hash_word(hash_word(views, key.binary_hash), key.image_base);
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    // Never 0, which stands for a view mapped alone.
+    keys[i].peers_hash = hash_word(views, i) | 1;
+  }
+}
+
+std::filesystem::path IndexCache::path_for(const IndexCacheKey &key) const {
+  std::ostringstream name;
+  name << std::hex << std::setfill('0') << std::setw(16) << key.trace_hash
+       << '-' << std::setw(16) << key.binary_hash << '-' << std::setw(0)
+       << key.image_base << (key.block_native ? "-blocks" : "-insns");
+  if (key.peers_hash != 0) {
+    name << "-p" << std::setw(16) << key.peers_hash;
+  }
+  name << kExtension;
+  return directory_ / name.str();
+}
+
+void IndexCache::prune(uint64_t max_bytes) const {
+  struct Entry {
+    std::filesystem::path path;
+    std::filesystem::file_time_type used;
+    uint64_t size = 0;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  std::error_code error;
+  std::filesystem::directory_iterator it(directory_, error);
+  for (; !error && it != std::filesystem::directory_iterator();
+       it.increment(error)) {
+    if (it->path().extension() != kExtension) {
+      continue;
+    }
+    std::error_code entry_error;
+    Entry entry;
+    entry.path = it->path();
+    entry.size = it->file_size(entry_error);
+    if (!entry_error) {
+      entry.used = it->last_write_time(entry_error);
+    }
+    if (entry_error) {
+      continue;
+    }
+    total += entry.size;
+    entries.push_back(std::move(entry));
+  }
+  if (total <= max_bytes) {
+    return;
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+  for (const auto &entry : entries) {
+    if (total <= max_bytes) {
+      break;
+    }
+    if (std::filesystem::remove(entry.path, error)) {
+      total -= entry.size;
+    }
+  }
+}
+
+std::optional<CachedIndex> IndexCache::load(const IndexCacheKey &key) const {
+  const auto path = path_for(key);
+  std::error_code error;
+  if (!std::filesystem::is_regular_file(path, error)) {
+    return std::nullopt;
+  }
+  const auto file = coverage::MappedFile::open(path.string());
+
+  FileHeader header{};
+  if (file.size() < sizeof(header)) {
+    corrupt(path, "truncated header");
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    corrupt(path, "bad magic");
+  }
+  if (header.version != kFormatVersion || header.endian_tag != kEndianTag) {
+    return std::nullopt;
+  }
+  const bool block_native = (header.flags & kFlagBlockNative) != 0;
+  if (header.trace_hash != key.trace_hash ||
+      header.binary_hash != key.binary_hash ||
+      header.image_base != key.image_base ||
+      header.peers_hash != key.peers_hash ||
+      block_native != key.block_native) {
+    return std::nullopt;
+  }
+  // Entries are pruned least recently used first.
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now(), error);
+
+  CacheReader reader(file, path);
+  reader.read_table(header);
+
+  CachedIndex cached;
+  auto &index = cached.index;
+  try {
+    index.dataset = coverage::CoverageDataset::from_sorted(
+        reader.records<uint64_t>(SectionId::Addresses),
+        reader.records<uint64_t>(SectionId::Hits));
+  } catch (const std::invalid_argument &err) {
+    corrupt(path, err.what());
+  }
+  index.block_native = block_native;
+  for (const auto &record :
+       reader.records<BlockSpanRecord>(SectionId::BlockSpans)) {
+    index.block_spans.push_back({record.start, record.size, record.hits});
+  }
+
+  std::unordered_map<uint32_t, uint64_t> invalid_modules;
+  for (const auto &record :
+       reader.records<InvalidModuleRecord>(SectionId::InvalidModules)) {
+    invalid_modules[record.module_id] += record.count;
+  }
+  index.invalid = InvalidAddressSummary::from_ranges(
+      reader.records<InvalidRange>(SectionId::InvalidRanges),
+      std::move(invalid_modules));
+
+  const auto diagnostics =
+      reader.records<DiagnosticsRecord>(SectionId::Diagnostics);
+  const auto traces = reader.records<TraceMetaRecord>(SectionId::Trace);
+  if (diagnostics.size() != 1 || traces.size() != 1) {
+    corrupt(path, "missing diagnostics or trace record");
+  }
+  const auto &diag = diagnostics.front();
+  auto &out = index.diagnostics;
+  out.spans_total = static_cast<size_t>(diag.spans_total);
+  out.spans_mapped = static_cast<size_t>(diag.spans_mapped);
+  out.spans_skipped = static_cast<size_t>(diag.spans_skipped);
+  if (diag.flags & kDiagModuleId) {
+    out.matched_module_id = diag.matched_module_id;
+  }
+  if (diag.flags & kDiagModuleBase) {
+    out.matched_module_base = diag.matched_module_base;
+  }
+  if (diag.flags & kDiagModuleEnd) {
+    out.matched_module_end = diag.matched_module_end;
+  }
+  out.view_image_base = diag.view_image_base;
+  out.matched_module_path = reader.string(diag.matched_module_path);
+  out.match_reason = reader.string(diag.match_reason);
+  out.slide = diag.slide;
+  out.used_fallback = (diag.flags & kDiagUsedFallback) != 0;
+
+  const auto &trace = traces.front();
+  if (trace.format > static_cast<uint32_t>(
+                         coverage::TraceFormat::AddrHitTrace)) {
+    corrupt(path, "unknown trace format");
+  }
+  cached.trace.format = static_cast<coverage::TraceFormat>(trace.format);
+  cached.trace.has_hitcounts = trace.has_hitcounts != 0;
+  for (const auto &record : reader.records<ModuleRecord>(SectionId::Modules)) {
+    coverage::ModuleInfo module;
+    module.id = record.id;
+    module.base = record.base;
+    module.end = record.end;
+    module.path = reader.string(record.path);
+    cached.trace.modules.emplace(module.id, std::move(module));
+  }
+  return cached;
+}
+
+void IndexCache::store(const IndexCacheKey &key,
+                       const coverage::CoverageTrace &trace,
+                       const CoverageIndex &index) const {
+  CacheWriter writer;
+  const auto addresses = index.dataset.addresses();
+  const auto hits = index.dataset.hit_counts();
+  writer.add(SectionId::Addresses,
+             std::vector<uint64_t>(addresses.begin(), addresses.end()));
+  writer.add(SectionId::Hits, std::vector<uint64_t>(hits.begin(), hits.end()));
+
+  std::vector<BlockSpanRecord> spans;
+  spans.reserve(index.block_spans.size());
+  for (const auto &span : index.block_spans) {
+    spans.push_back({span.start, span.hits, span.size, 0});
+  }
+  writer.add(SectionId::BlockSpans, spans);
+
+  writer.add(SectionId::InvalidRanges, index.invalid.ranges());
+  std::vector<InvalidModuleRecord> invalid_modules;
+  for (const auto &[module, count] : index.invalid.module_counts()) {
+    invalid_modules.push_back({module, 0, count});
+  }
+  writer.add(SectionId::InvalidModules, invalid_modules);
+
+  const auto &diag = index.diagnostics;
+  DiagnosticsRecord diagnostics{};
+  diagnostics.spans_total = diag.spans_total;
+  diagnostics.spans_mapped = diag.spans_mapped;
+  diagnostics.spans_skipped = diag.spans_skipped;
+  diagnostics.matched_module_id = diag.matched_module_id.value_or(0);
+  diagnostics.matched_module_base = diag.matched_module_base.value_or(0);
+  diagnostics.matched_module_end = diag.matched_module_end.value_or(0);
+  diagnostics.view_image_base = diag.view_image_base;
+  diagnostics.slide = diag.slide;
+  diagnostics.flags = (diag.matched_module_id ? kDiagModuleId : 0) |
+                      (diag.matched_module_base ? kDiagModuleBase : 0) |
+                      (diag.matched_module_end ? kDiagModuleEnd : 0) |
+                      (diag.used_fallback ? kDiagUsedFallback : 0);
+  diagnostics.matched_module_path = writer.intern(diag.matched_module_path);
+  diagnostics.match_reason = writer.intern(diag.match_reason);
+  writer.add(SectionId::Diagnostics, std::vector{diagnostics});
+
+  writer.add(SectionId::Trace,
+             std::vector{TraceMetaRecord{static_cast<uint32_t>(trace.format),
+                                     trace.has_hitcounts ? 1u : 0u}});
+  std::vector<ModuleRecord> modules;
+  modules.reserve(trace.modules.size());
+  for (const auto &[id, module] : trace.modules) {
+    modules.push_back(
+        {id, 0, module.base, module.end, writer.intern(module.path)});
+  }
+  std::sort(modules.begin(), modules.end(),
+            [](const ModuleRecord &a, const ModuleRecord &b) {
+              return a.id < b.id;
+            });
+  writer.add(SectionId::Modules, modules);
+
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFormatVersion;
+  header.flags = key.block_native ? kFlagBlockNative : 0;
+  header.trace_hash = key.trace_hash;
+  header.binary_hash = key.binary_hash;
+  header.image_base = key.image_base;
+  header.peers_hash = key.peers_hash;
+  header.endian_tag = kEndianTag;
+
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error) {
+    throw std::runtime_error("Failed to create index cache directory " +
+                             directory_.string() + ": " + error.message());
+  }
+  // Write beside the final name and rename over it, so a concurrent reader
+  // never sees a partial entry.
+  const auto path = path_for(key);
+  auto temp = path;
+  temp += ".tmp" + std::to_string(std::random_device{}());
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Failed to open index cache entry: " +
+                               temp.string());
+    }
+    writer.write(out, header);
+    if (!out) {
+      out.close();
+      std::filesystem::remove(temp, error);
+      throw std::runtime_error("Failed to write index cache entry: " +
+                               temp.string());
+    }
+  }
+  std::filesystem::rename(temp, path, error);
+  if (error) {
+    std::filesystem::remove(temp, error);
+    throw std::runtime_error("Failed to store index cache entry: " +
+                             path.string());
+  }
+}
+
+} // namespace binja::covex::core
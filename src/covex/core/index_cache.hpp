@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "covex/core/coverage_index.hpp"
+#include "covex/coverage/coverage_types.hpp"
+
+namespace binja::covex::core {
+
+// Streaming 64-bit content hash used for cache keys. Not cryptographic.
+class ContentHasher {
+public:
+  void update(std::span<const uint8_t> bytes);
+  uint64_t finish() const;
+
+private:
+  uint64_t state_ = 0x243f6a8885a308d3ULL;
+  uint64_t length_ = 0;
+  uint64_t tail_ = 0;
+  size_t tail_size_ = 0;
+};
+
+struct IndexCacheKey {
+  uint64_t trace_hash = 0;
+  uint64_t binary_hash = 0;
+  uint64_t image_base = 0;
+  bool block_native = false;
+  // Identifies the other views a trace was mapped into in the same pass
+  // (see IndexCache::link_peers); 0 when it was mapped into this view alone.
+  uint64_t peers_hash = 0;
+};
+
+// A mapped trace as read back from the cache. The trace carries metadata
+// only (format, hitcount flag, modules); its spans are not stored. The index
+// has no covered blocks; derive them from the view with
+// CoverageMapper::derive_blocks.
+struct CachedIndex {
+  coverage::CoverageTrace trace;
+  CoverageIndex index;
+};
+
+// On-disk store of mapping results, one file per key. Files start with a
+// fixed header and a section table; every section is an array of fixed-size
+// records in host byte order at an 8-byte aligned offset, so a file can be
+// read straight out of a memory mapping. A tag in the header makes files
+// written on a host of the other byte order read as misses. Only what the
+// trace and binary determine is stored: the dataset, block spans, invalid
+// ranges and diagnostics. Covered blocks and function names depend on the
+// view's current analysis and are left out; block spans are re-snapped to it
+// after loading (see CoverageMapper::derive_blocks).
+class IndexCache {
+public:
+  static constexpr uint32_t kFormatVersion = 4;
+
+  explicit IndexCache(std::filesystem::path directory);
+
+  const std::filesystem::path &directory() const { return directory_; }
+
+  static uint64_t hash_file(const std::string &path);
+  // Sets peers_hash on the keys of the views one trace is mapped into in a
+  // single pass, the loaded view first. Each key then covers every view in
+  // the pass and its own position, so an entry is only reused for the same
+  // set of views. A single key is left with peers_hash 0.
+  static void link_peers(std::vector<IndexCacheKey> &keys);
+
+  // Returns std::nullopt when there is no entry for the key or it was
+  // written by another format version. Throws std::runtime_error if the
+  // entry is malformed. A hit marks the entry as recently used for prune.
+  std::optional<CachedIndex> load(const IndexCacheKey &key) const;
+  // Replaces the entry for the key. Throws std::runtime_error on I/O
+  // failure.
+  void store(const IndexCacheKey &key, const coverage::CoverageTrace &trace,
+             const CoverageIndex &index) const;
+
+  // Removes the least recently used entries until the directory holds at
+  // most max_bytes of them. Files that cannot be inspected are skipped.
+  void prune(uint64_t max_bytes) const;
+
+  std::filesystem::path path_for(const IndexCacheKey &key) const;
+
+private:
+  std::filesystem::path directory_;
+};
+
+} // namespace binja::covex::core
@@ -0,0 +1,198 @@
+#include "covex/core/instruction_boundaries.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
+namespace binja::covex::core {
+
+void InstructionBoundaryMap::add_range(uint64_t start, uint64_t end) {
+  if (start >= end) {
+    return;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  Range range;
+  range.start = start;
+  range.end = end;
+  range.pages.resize(static_cast<size_t>((end - start - 1) / kPageSize + 1));
+  auto it = std::lower_bound(
+      ranges_.begin(), ranges_.end(), start,
+      [](const Range &r, uint64_t value) { return r.start < value; });
+  if ((it != ranges_.end() && it->start < end) ||
+      (it != ranges_.begin() && std::prev(it)->end > start)) {
+    return;
+  }
+  ranges_.insert(it, std::move(range));
+}
+
+bool InstructionBoundaryMap::covers(uint64_t addr) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return find_range(addr) != nullptr;
+}
+
+std::optional<uint64_t> InstructionBoundaryMap::lookup(uint64_t addr) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  const Range *range = find_range(addr);
+  if (!range || state_at(*range, addr) != ByteState::Start) {
+    return std::nullopt;
+  }
+  // record() never lets another instruction's interior follow a start, so
+  // the interior run after addr is exactly this instruction's tail.
+  uint64_t length = 1;
+  while (length < kMaxInstructionLength && addr + length < range->end &&
+         state_at(*range, addr + length) == ByteState::Interior) {
+    ++length;
+  }
+  return length;
+}
+
+bool InstructionBoundaryMap::record(uint64_t addr, uint64_t length) {
+  if (length == 0 || length > kMaxInstructionLength) {
+    return false;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  Range *range = find_range(addr);
+  if (!range || length > range->end - addr) {
+    return false;
+  }
+
+  const ByteState first = state_at(*range, addr);
+  if (first == ByteState::Interior) {
+    return false;
+  }
+  for (uint64_t offset = 1; offset < length; ++offset) {
+    if (state_at(*range, addr + offset) == ByteState::Start) {
+      return false;
+    }
+  }
+  if (first == ByteState::Start) {
+    return true;
+  }
+
+  set_state(*range, addr, ByteState::Start);
+  for (uint64_t offset = 1; offset < length; ++offset) {
+    set_state(*range, addr + offset, ByteState::Interior);
+  }
+  return true;
+}
+
+void InstructionBoundaryMap::invalidate(uint64_t start, uint64_t end) {
+  if (start >= end) {
+    return;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  for (auto &range : ranges_) {
+    if (range.end <= start || range.start >= end) {
+      continue;
+    }
+    const uint64_t first = std::max(start, range.start) - range.start;
+    const uint64_t last = std::min(end, range.end) - range.start - 1;
+    const size_t first_page = static_cast<size_t>(first / kPageSize);
+    const size_t last_page = static_cast<size_t>(last / kPageSize);
+    const uint64_t drop_start = range.start + first_page * kPageSize;
+    const uint64_t drop_end =
+        std::min(range.end, range.start + (last_page + 1) * kPageSize);
+
+    // An instruction starting before the dropped pages may run into them;
+    // forget it entirely so its length is not read back truncated.
+    if (drop_start > range.start &&
+        state_at(range, drop_start - 1) != ByteState::Unknown) {
+      uint64_t owner = drop_start - 1;
+      while (owner > range.start &&
+             state_at(range, owner) == ByteState::Interior) {
+        --owner;
+      }
+      for (uint64_t addr = owner; addr < drop_start; ++addr) {
+        set_state(range, addr, ByteState::Unknown);
+      }
+    }
+    // Likewise drop the tail of an instruction that started inside them, so
+    // it cannot extend a new instruction recorded there.
+    for (uint64_t addr = drop_end;
+         addr < range.end && state_at(range, addr) == ByteState::Interior;
+         ++addr) {
+      set_state(range, addr, ByteState::Unknown);
+    }
+
+    for (size_t page = first_page; page <= last_page; ++page) {
+      range.pages[page].reset();
+    }
+  }
+}
+
+void InstructionBoundaryMap::reset() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  ranges_.clear();
+}
+
+size_t InstructionBoundaryMap::page_count() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  size_t count = 0;
+  for (const auto &range : ranges_) {
+    for (const auto &page : range.pages) {
+      count += page ? 1 : 0;
+    }
+  }
+  return count;
+}
+
+const InstructionBoundaryMap::Range *
+InstructionBoundaryMap::find_range(uint64_t addr) const {
+  auto it = std::upper_bound(
+      ranges_.begin(), ranges_.end(), addr,
+      [](uint64_t value, const Range &r) { return value < r.start; });
+  if (it == ranges_.begin()) {
+    return nullptr;
+  }
+  --it;
+  return addr < it->end ? &*it : nullptr;
+}
+
+InstructionBoundaryMap::Range *InstructionBoundaryMap::find_range(
+    uint64_t addr) {
+  return const_cast<Range *>(
+      static_cast<const InstructionBoundaryMap *>(this)->find_range(addr));
+}
+
+InstructionBoundaryMap::ByteState
+InstructionBoundaryMap::state_at(const Range &range, uint64_t addr) {
+  const uint64_t offset = addr - range.start;
+  const auto &page = range.pages[static_cast<size_t>(offset / kPageSize)];
+  if (!page) {
+    return ByteState::Unknown;
+  }
+  const uint64_t bit = offset % kPageSize;
+  const uint64_t mask = uint64_t{1} << (bit % 64);
+  if ((page->known[bit / 64] & mask) == 0) {
+    return ByteState::Unknown;
+  }
+  return (page->start[bit / 64] & mask) != 0 ? ByteState::Start
+                                             : ByteState::Interior;
+}
+
+void InstructionBoundaryMap::set_state(Range &range, uint64_t addr,
+                                       ByteState state) {
+  const uint64_t offset = addr - range.start;
+  auto &page = range.pages[static_cast<size_t>(offset / kPageSize)];
+  if (!page) {
+    if (state == ByteState::Unknown) {
+      return;
+    }
+    page = std::make_unique<Page>();
+  }
+  const uint64_t bit = offset % kPageSize;
+  const uint64_t mask = uint64_t{1} << (bit % 64);
+  if (state == ByteState::Unknown) {
+    page->known[bit / 64] &= ~mask;
+    page->start[bit / 64] &= ~mask;
+    return;
+  }
+  page->known[bit / 64] |= mask;
+  if (state == ByteState::Start) {
+    page->start[bit / 64] |= mask;
+  } else {
+    page->start[bit / 64] &= ~mask;
+  }
+}
+
+} // namespace binja::covex::core
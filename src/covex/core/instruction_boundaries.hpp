@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <vector>
+
+namespace binja::covex::core {
+
+// Known instruction starts for one architecture, kept as two bits per byte
+// (known, start) in lazily allocated 4 KiB pages over registered executable
+// ranges. Recording an instruction marks its first byte as a start and the
+// rest as interior, so a later lookup recovers the length from the bitmap
+// alone. Decodes that would overlap an instruction recorded earlier are not
+// cached. Safe to use from several threads.
+class InstructionBoundaryMap {
+public:
+  static constexpr uint64_t kPageSize = 4096;
+  static constexpr uint64_t kMaxInstructionLength = 16;
+
+  // Registers [start, end) as cacheable; ranges overlapping an existing one
+  // are ignored.
+  void add_range(uint64_t start, uint64_t end);
+  bool covers(uint64_t addr) const;
+
+  // Length of the instruction recorded at addr, if any.
+  std::optional<uint64_t> lookup(uint64_t addr) const;
+  // Records an instruction of `length` bytes at addr. Returns false when the
+  // instruction falls outside a registered range or overlaps another one.
+  bool record(uint64_t addr, uint64_t length);
+
+  // Forgets instructions on the pages touching [start, end).
+  void invalidate(uint64_t start, uint64_t end);
+  // Forgets all instructions and ranges.
+  void reset();
+
+  size_t page_count() const;
+
+private:
+  struct Page {
+    std::array<uint64_t, kPageSize / 64> known{};
+    std::array<uint64_t, kPageSize / 64> start{};
+  };
+
+  struct Range {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    std::vector<std::unique_ptr<Page>> pages;
+  };
+
+  enum class ByteState { Unknown, Start, Interior };
+
+  const Range *find_range(uint64_t addr) const;
+  Range *find_range(uint64_t addr);
+  static ByteState state_at(const Range &range, uint64_t addr);
+  static void set_state(Range &range, uint64_t addr, ByteState state);
+
+  mutable std::shared_mutex mutex_;
+  // Sorted by start.
+  std::vector<Range> ranges_;
+};
+
+} // namespace binja::covex::core
@@ -0,0 +1,166 @@
+#include "covex/core/instruction_boundary_cache.hpp"
+
+#include <iterator>
+
+namespace binja::covex::core {
+
+namespace {
+
+std::mutex g_registry_mutex;
+std::unordered_map<BNBinaryView *, std::weak_ptr<InstructionBoundaryCache>>
+    g_registry;
+
+} // namespace
+
+class InstructionBoundaryCache::Notification final
+    : public BinaryNinja::BinaryDataNotification {
+public:
+  explicit Notification(InstructionBoundaryCache &owner) : owner_(owner) {}
+
+  void OnBinaryDataWritten(BinaryNinja::BinaryView *, uint64_t offset,
+                           size_t len) override {
+    owner_.invalidate(offset, offset + len);
+  }
+  void OnBinaryDataInserted(BinaryNinja::BinaryView *, uint64_t,
+                            size_t) override {
+    owner_.reset();
+  }
+  void OnBinaryDataRemoved(BinaryNinja::BinaryView *, uint64_t,
+                           uint64_t) override {
+    owner_.reset();
+  }
+  void OnAnalysisFunctionUpdated(BinaryNinja::BinaryView *,
+                                 BinaryNinja::Function *func) override {
+    if (!func) {
+      return;
+    }
+    for (const auto &range : func->GetAddressRanges()) {
+      owner_.invalidate(range.start, range.end);
+    }
+  }
+  void OnSegmentAdded(BinaryNinja::BinaryView *,
+                      BinaryNinja::Segment *) override {
+    owner_.reset();
+  }
+  void OnSegmentRemoved(BinaryNinja::BinaryView *,
+                        BinaryNinja::Segment *) override {
+    owner_.reset();
+  }
+  void OnSegmentUpdated(BinaryNinja::BinaryView *,
+                        BinaryNinja::Segment *) override {
+    owner_.reset();
+  }
+
+private:
+  InstructionBoundaryCache &owner_;
+};
+
+InstructionBoundaryCache::InstructionBoundaryCache(BinaryViewRef view)
+    : view_(view), notification_(std::make_unique<Notification>(*this)) {
+  if (view_) {
+    view_->RegisterNotification(notification_.get());
+  }
+}
+
+InstructionBoundaryCache::~InstructionBoundaryCache() {
+  if (view_) {
+    view_->UnregisterNotification(notification_.get());
+  }
+}
+
+std::shared_ptr<InstructionBoundaryCache>
+InstructionBoundaryCache::for_view(BinaryViewRef view) {
+  if (!view) {
+    return std::make_shared<InstructionBoundaryCache>(view);
+  }
+  std::lock_guard<std::mutex> lock(g_registry_mutex);
+  auto &slot = g_registry[view->GetObject()];
+  auto cache = slot.lock();
+  if (!cache) {
+    cache = std::make_shared<InstructionBoundaryCache>(view);
+    slot = cache;
+  }
+  for (auto it = g_registry.begin(); it != g_registry.end();) {
+    it = it->second.expired() ? g_registry.erase(it) : std::next(it);
+  }
+  return cache;
+}
+
+uint64_t InstructionBoundaryCache::decode_length(InstructionBoundaryMap &map,
+                                                 const ArchitectureRef &arch,
+                                                 uint64_t addr) {
+  if (!view_ || !arch) {
+    return 0;
+  }
+  if (auto cached = map.lookup(addr)) {
+    return *cached;
+  }
+  const uint64_t length = view_->GetInstructionLength(arch, addr);
+  if (length != 0) {
+    map.record(addr, length);
+  }
+  return length;
+}
+
+uint64_t InstructionBoundaryCache::instruction_length(
+    InstructionBoundaryMap &map, const ArchitectureRef &arch, uint64_t addr,
+    uint64_t remaining) {
+  uint64_t length = decode_length(map, arch, addr);
+  if (length == 0 || length > InstructionBoundaryMap::kMaxInstructionLength) {
+    length = 1;
+  }
+  if (remaining > 0 && length > remaining) {
+    length = remaining;
+  }
+  return length;
+}
+
+void InstructionBoundaryCache::invalidate(uint64_t start, uint64_t end) {
+  std::lock_guard<std::mutex> lock(maps_mutex_);
+  for (auto &[arch, map] : maps_) {
+    (void)arch;
+    map->invalidate(start, end);
+  }
+}
+
+void InstructionBoundaryCache::reset() {
+  // Maps are handed out by reference, so they are emptied and refilled in
+  // place rather than replaced.
+  std::lock_guard<std::mutex> lock(maps_mutex_);
+  for (auto &[arch, map] : maps_) {
+    (void)arch;
+    map->reset();
+    add_executable_ranges(*map);
+  }
+}
+
+InstructionBoundaryMap &
+InstructionBoundaryCache::map_for(const ArchitectureRef &arch) {
+  std::lock_guard<std::mutex> lock(maps_mutex_);
+  auto &map = maps_[arch->GetObject()];
+  if (!map) {
+    map = std::make_unique<InstructionBoundaryMap>();
+    add_executable_ranges(*map);
+  }
+  return *map;
+}
+
+void InstructionBoundaryCache::add_executable_ranges(
+    InstructionBoundaryMap &map) const {
+  const auto segments = view_->GetSegments();
+  if (segments.empty()) {
+    // Views without segments (e.g. raw files) are treated as one range.
+    map.add_range(view_->GetStart(), view_->GetEnd());
+    return;
+  }
+  for (const auto &segment : segments) {
+    const uint32_t flags = segment->GetFlags();
+    if ((flags & (SegmentExecutable | SegmentContainsCode)) == 0 ||
+        (flags & SegmentDenyExecute) != 0) {
+      continue;
+    }
+    map.add_range(segment->GetStart(), segment->GetEnd());
+  }
+}
+
+} // namespace binja::covex::core
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "binaryninjaapi.h"
+#include "covex/core/instruction_boundaries.hpp"
+#include "uitypes.h"
+
+namespace binja::covex::core {
+
+// Per-view cache of instruction lengths over the executable segments, shared
+// by everything that walks instructions in the same view. Lengths are decoded
+// once and then served from an InstructionBoundaryMap per architecture;
+// writes to the view and function reanalysis drop the affected pages.
+class InstructionBoundaryCache {
+public:
+  explicit InstructionBoundaryCache(BinaryViewRef view);
+  ~InstructionBoundaryCache();
+
+  InstructionBoundaryCache(const InstructionBoundaryCache &) = delete;
+  InstructionBoundaryCache &
+  operator=(const InstructionBoundaryCache &) = delete;
+
+  // Returns the cache for `view`, creating it if no one holds it yet.
+  static std::shared_ptr<InstructionBoundaryCache> for_view(BinaryViewRef view);
+
+  BinaryViewRef view() const { return view_; }
+
+  // The boundary map for `arch`. The reference stays valid for the cache's
+  // lifetime (invalidation empties maps in place), so callers resolve it
+  // once and pass it to the lookups below, which then only take the map's
+  // read lock on a hit.
+  InstructionBoundaryMap &map_for(const ArchitectureRef &arch);
+
+  // Decoded length of the instruction at addr, or 0 if it does not decode.
+  // `map` must come from map_for(arch). Lengths above
+  // InstructionBoundaryMap::kMaxInstructionLength are returned as decoded
+  // but not cached.
+  uint64_t decode_length(InstructionBoundaryMap &map,
+                         const ArchitectureRef &arch, uint64_t addr);
+  // Like decode_length, but at least 1 and clamped to `remaining` when it is
+  // non-zero, for walking a range instruction by instruction.
+  uint64_t instruction_length(InstructionBoundaryMap &map,
+                              const ArchitectureRef &arch, uint64_t addr,
+                              uint64_t remaining);
+
+  void invalidate(uint64_t start, uint64_t end);
+  void reset();
+
+private:
+  class Notification;
+
+  void add_executable_ranges(InstructionBoundaryMap &map) const;
+
+  BinaryViewRef view_;
+  std::unique_ptr<Notification> notification_;
+  std::mutex maps_mutex_;
+  std::unordered_map<BNArchitecture *, std::unique_ptr<InstructionBoundaryMap>>
+      maps_;
+};
+
+} // namespace binja::covex::core
@@ -0,0 +1,142 @@
+#include "covex/core/invalid_addresses.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+namespace binja::covex::core {
+
+namespace {
+
+// Merges runs whose gaps are no larger than the smallest gap that brings
+// the run count down to `target`.
+void coarsen(std::vector<InvalidRange> &ranges, size_t target) {
+  if (ranges.size() <= target || ranges.size() < 2) {
+    return;
+  }
+  std::vector<uint64_t> gaps;
+  gaps.reserve(ranges.size() - 1);
+  for (size_t i = 1; i < ranges.size(); ++i) {
+    gaps.push_back(ranges[i].lo - ranges[i - 1].hi);
+  }
+  const size_t merges = ranges.size() - target;
+  std::nth_element(gaps.begin(), gaps.begin() + (merges - 1), gaps.end());
+  const uint64_t threshold = gaps[merges - 1];
+
+  std::vector<InvalidRange> merged;
+  merged.reserve(target);
+  for (const auto &range : ranges) {
+    if (!merged.empty() && range.lo - merged.back().hi <= threshold) {
+      merged.back().hi = range.hi;
+      merged.back().count += range.count;
+      continue;
+    }
+    merged.push_back(range);
+  }
+  ranges = std::move(merged);
+}
+
+// Merges two sorted run lists, joining runs that touch or overlap, and
+// coarsens the result to half the budget when it exceeds it so later adds
+// have headroom.
+void combine(std::vector<InvalidRange> &ranges,
+             const std::vector<InvalidRange> &runs, size_t max_ranges) {
+  std::vector<InvalidRange> combined;
+  combined.reserve(ranges.size() + runs.size());
+  std::merge(ranges.begin(), ranges.end(), runs.begin(), runs.end(),
+             std::back_inserter(combined),
+             [](const InvalidRange &a, const InvalidRange &b) {
+               return a.lo < b.lo;
+             });
+  ranges.clear();
+  for (const auto &range : combined) {
+    if (!ranges.empty() && range.lo <= ranges.back().hi) {
+      ranges.back().hi = std::max(ranges.back().hi, range.hi);
+      ranges.back().count += range.count;
+      continue;
+    }
+    ranges.push_back(range);
+  }
+  if (ranges.size() > max_ranges) {
+    coarsen(ranges, std::max<size_t>(1, max_ranges / 2));
+  }
+}
+
+} // namespace
+
+InvalidAddressSummary::InvalidAddressSummary(size_t max_ranges)
+    : max_ranges_(std::max<size_t>(1, max_ranges)) {}
+
+InvalidAddressSummary InvalidAddressSummary::from_ranges(
+    std::vector<InvalidRange> ranges,
+    std::unordered_map<uint32_t, uint64_t> module_counts, size_t max_ranges) {
+  InvalidAddressSummary summary(max_ranges);
+  std::sort(ranges.begin(), ranges.end(),
+            [](const InvalidRange &a, const InvalidRange &b) {
+              return a.lo < b.lo;
+            });
+  for (const auto &range : ranges) {
+    summary.count_ += range.count;
+  }
+  summary.module_counts_ = std::move(module_counts);
+  combine(summary.ranges_, ranges, summary.max_ranges_);
+  return summary;
+}
+
+void InvalidAddressSummary::add(uint64_t addr,
+                                std::optional<uint32_t> module_id) {
+  ++count_;
+  if (module_id) {
+    ++module_counts_[*module_id];
+  }
+  pending_.push_back(addr);
+  if (pending_.size() >= kPendingLimit) {
+    flush();
+  }
+}
+
+void InvalidAddressSummary::merge(const InvalidAddressSummary &other) {
+  count_ += other.count_;
+  for (const auto &[module, count] : other.module_counts_) {
+    module_counts_[module] += count;
+  }
+  combine(ranges_, other.ranges(), max_ranges_);
+}
+
+std::vector<InvalidRange> InvalidAddressSummary::ranges() const {
+  auto ranges = ranges_;
+  auto pending = pending_;
+  fold(ranges, pending, max_ranges_);
+  return ranges;
+}
+
+void InvalidAddressSummary::flush() {
+  fold(ranges_, pending_, max_ranges_);
+  pending_.clear();
+}
+
+void InvalidAddressSummary::fold(std::vector<InvalidRange> &ranges,
+                                 std::vector<uint64_t> &pending,
+                                 size_t max_ranges) {
+  if (pending.empty()) {
+    return;
+  }
+  std::sort(pending.begin(), pending.end());
+  std::vector<InvalidRange> runs;
+  for (const uint64_t addr : pending) {
+    // hi is exclusive, so the all-ones address closes its run at itself.
+    const uint64_t hi =
+        addr == std::numeric_limits<uint64_t>::max() ? addr : addr + 1;
+    if (!runs.empty() && addr <= runs.back().hi) {
+      runs.back().hi = std::max(runs.back().hi, hi);
+      ++runs.back().count;
+      continue;
+    }
+    runs.push_back({addr, hi, 1});
+  }
+
+  combine(ranges, runs, max_ranges);
+}
+
+} // namespace binja::covex::core
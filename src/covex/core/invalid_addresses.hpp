@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace binja::covex::core {
+
+// A run of invalid addresses: `count` occurrences in [lo, hi).
+struct InvalidRange {
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+  uint64_t count = 0;
+};
+
+// Bounded-memory record of the addresses a mapping could not place. Addresses
+// are buffered, then folded into sorted [lo, hi) runs; once there are more
+// than `max_ranges` runs the closest neighbours are merged, so the runs get
+// coarser instead of the summary growing. Counts are of occurrences, not of
+// distinct addresses.
+class InvalidAddressSummary {
+public:
+  static constexpr size_t kDefaultMaxRanges = 4096;
+
+  explicit InvalidAddressSummary(size_t max_ranges = kDefaultMaxRanges);
+
+  // Rebuilds a summary from runs previously returned by ranges().
+  static InvalidAddressSummary
+  from_ranges(std::vector<InvalidRange> ranges,
+              std::unordered_map<uint32_t, uint64_t> module_counts,
+              size_t max_ranges = kDefaultMaxRanges);
+
+  void add(uint64_t addr, std::optional<uint32_t> module_id = std::nullopt);
+  void merge(const InvalidAddressSummary &other);
+
+  uint64_t count() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  // Sorted, non-overlapping runs covering every recorded address.
+  std::vector<InvalidRange> ranges() const;
+  // Occurrences per drcov module id, for addresses that carried one.
+  const std::unordered_map<uint32_t, uint64_t> &module_counts() const {
+    return module_counts_;
+  }
+
+private:
+  static constexpr size_t kPendingLimit = 64 * 1024;
+
+  void flush();
+  static void fold(std::vector<InvalidRange> &ranges,
+                   std::vector<uint64_t> &pending, size_t max_ranges);
+
+  size_t max_ranges_;
+  uint64_t count_ = 0;
+  std::vector<InvalidRange> ranges_;
+  std::vector<uint64_t> pending_;
+  std::unordered_map<uint32_t, uint64_t> module_counts_;
+};
+
+} // namespace binja::covex::core
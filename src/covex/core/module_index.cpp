@@ -0,0 +1,51 @@
+#include "covex/core/module_index.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace binja::covex::core {
+
+ModuleIndex::ModuleIndex(std::vector<ModuleRange> ranges)
+    : modules_(std::move(ranges)) {
+  std::vector<size_t> order;
+  order.reserve(modules_.size());
+  for (size_t i = 0; i < modules_.size(); ++i) {
+    if (modules_[i].module_id) {
+      by_module_.emplace(*modules_[i].module_id, i);
+    }
+    if (modules_[i].end > modules_[i].base) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return modules_[a].base < modules_[b].base;
+  });
+  by_address_.reserve(order.size());
+  for (const size_t i : order) {
+    if (!by_address_.empty() &&
+        modules_[i].base < modules_[by_address_.back()].end) {
+      continue;
+    }
+    by_address_.push_back(i);
+  }
+}
+
+const ModuleRange *ModuleIndex::find(uint64_t addr) const {
+  auto it = std::upper_bound(by_address_.begin(), by_address_.end(), addr,
+                             [&](uint64_t value, size_t i) {
+                               return value < modules_[i].base;
+                             });
+  if (it == by_address_.begin()) {
+    return nullptr;
+  }
+  const ModuleRange &range = modules_[*std::prev(it)];
+  return addr < range.end ? &range : nullptr;
+}
+
+const ModuleRange *ModuleIndex::find_module(uint32_t module_id) const {
+  auto it = by_module_.find(module_id);
+  return it != by_module_.end() ? &modules_[it->second] : nullptr;
+}
+
+} // namespace binja::covex::core
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace binja::covex::core {
+
+// Address range of one module in a trace, together with the mapping target
+// (an index chosen by the caller) and the slide into that target's view.
+struct ModuleRange {
+  uint64_t base = 0;
+  uint64_t end = 0;
+  int64_t slide = 0;
+  size_t target = 0;
+  // Set for drcov modules; address traces are resolved by address alone.
+  std::optional<uint32_t> module_id;
+};
+
+// Module ranges sorted by base for O(log n) lookup by address, plus O(1)
+// lookup by drcov module id. Where ranges overlap, address lookup keeps the
+// lower one; a repeated module id keeps the range added first.
+class ModuleIndex {
+public:
+  ModuleIndex() = default;
+  explicit ModuleIndex(std::vector<ModuleRange> ranges);
+
+  const ModuleRange *find(uint64_t addr) const;
+  const ModuleRange *find_module(uint32_t module_id) const;
+
+  bool empty() const { return modules_.empty(); }
+  const std::vector<ModuleRange> &ranges() const { return modules_; }
+
+private:
+  std::vector<ModuleRange> modules_;
+  // Indices into modules_ of the non-empty, non-overlapping ranges by base.
+  std::vector<size_t> by_address_;
+  std::unordered_map<uint32_t, size_t> by_module_;
+};
+
+} // namespace binja::covex::core
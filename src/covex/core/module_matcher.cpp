@@ -33,21 +33,18 @@ int64_t compute_slide(uint64_t view_image_base, uint64_t module_base) {
 } // namespace
 
 std::optional<ModuleMatch>
-ModuleMatcher::match(const coverage::CoverageTrace &trace, BinaryViewRef view) {
-  if (!view || trace.modules.empty()) {
+ModuleMatcher::match(const coverage::CoverageTrace &trace,
+                     const ViewOracle &view) {
+  if (trace.modules.empty()) {
     return std::nullopt;
   }
-  auto file = view->GetFile();
-  if (!file) {
-    return std::nullopt;
-  }
-  const std::string view_path = file->GetOriginalFilename();
+  const std::string view_path = view.original_filename();
   if (view_path.empty()) {
     return std::nullopt;
   }
   const std::string view_path_lower = lower_copy(view_path);
   const std::string view_base_lower = lower_copy(base_name(view_path));
-  const uint64_t view_image_base = view->GetImageBase();
+  const uint64_t view_image_base = view.image_base();
 
   auto make_match = [&](const coverage::ModuleInfo &module,
                         const std::string &reason, bool fallback) {
@@ -3,9 +3,8 @@
 #include <optional>
 #include <string>
 
-#include "binaryninjaapi.h"
+#include "covex/core/view_oracle.hpp"
 #include "covex/coverage/coverage_types.hpp"
-#include "uitypes.h"
 
 namespace binja::covex::core {
 
@@ -23,7 +22,7 @@ struct ModuleMatch {
 class ModuleMatcher {
 public:
   static std::optional<ModuleMatch> match(const coverage::CoverageTrace &trace,
-                                          BinaryViewRef view);
+                                          const ViewOracle &view);
   static std::optional<uint64_t> apply_slide(uint64_t addr, int64_t slide);
 };
 
@@ -0,0 +1,132 @@
+#include "covex/core/synthetic_view_oracle.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace binja::covex::core {
+
+SyntheticViewOracle::SyntheticViewOracle(uint64_t start, uint64_t end,
+                                         uint64_t image_base)
+    : start_(start), end_(end), image_base_(image_base) {}
+
+void SyntheticViewOracle::set_original_filename(std::string path) {
+  filename_ = std::move(path);
+}
+
+void SyntheticViewOracle::set_default_instruction_length(uint64_t length) {
+  default_length_ = length;
+}
+
+void SyntheticViewOracle::set_instruction_length(uint64_t addr,
+                                                 uint64_t length) {
+  lengths_[addr] = length;
+}
+
+void SyntheticViewOracle::add_segment(const OracleSegment &segment) {
+  segments_.push_back(segment);
+}
+
+void SyntheticViewOracle::add_section(const OracleSection &section) {
+  sections_.push_back(section);
+}
+
+void SyntheticViewOracle::add_data_variable(uint64_t addr) {
+  data_variables_.insert(addr);
+}
+
+void SyntheticViewOracle::add_function(uint64_t entry, std::string name) {
+  function_names_[entry] = std::move(name);
+}
+
+void SyntheticViewOracle::add_block(uint64_t start, uint64_t end,
+                                    uint64_t function) {
+  if (end <= start) {
+    return;
+  }
+  blocks_.emplace(start, OracleBlock{start, end, function});
+  max_block_size_ = std::max(max_block_size_, end - start);
+}
+
+bool SyntheticViewOracle::is_valid_offset(uint64_t addr) const {
+  return addr >= start_ && addr < end_;
+}
+
+uint64_t SyntheticViewOracle::instruction_length(uint64_t addr) const {
+  if (!is_valid_offset(addr)) {
+    return 0;
+  }
+  auto it = lengths_.find(addr);
+  return it != lengths_.end() ? it->second : default_length_;
+}
+
+std::vector<OracleSegment> SyntheticViewOracle::segments() const {
+  return segments_;
+}
+
+std::optional<OracleSegment>
+SyntheticViewOracle::segment_at(uint64_t addr) const {
+  for (const auto &segment : segments_) {
+    if (addr >= segment.start && addr < segment.end) {
+      return segment;
+    }
+  }
+  return std::nullopt;
+}
+
+std::vector<OracleSection>
+SyntheticViewOracle::sections_at(uint64_t addr) const {
+  std::vector<OracleSection> result;
+  for (const auto &section : sections_) {
+    if (addr >= section.start && addr < section.end) {
+      result.push_back(section);
+    }
+  }
+  return result;
+}
+
+bool SyntheticViewOracle::has_data_variable(uint64_t addr) const {
+  return data_variables_.count(addr) != 0;
+}
+
+std::vector<OracleBlock> SyntheticViewOracle::basic_blocks() const {
+  std::vector<OracleBlock> result;
+  result.reserve(blocks_.size());
+  for (const auto &[start, block] : blocks_) {
+    (void)start;
+    result.push_back(block);
+  }
+  return result;
+}
+
+std::vector<OracleBlock>
+SyntheticViewOracle::basic_blocks_at(uint64_t addr) const {
+  // Only blocks starting within the largest block size of addr can hold it.
+  std::vector<OracleBlock> result;
+  const uint64_t lowest = addr >= max_block_size_ ? addr - max_block_size_ : 0;
+  for (auto it = blocks_.lower_bound(lowest);
+       it != blocks_.end() && it->first <= addr; ++it) {
+    if (addr < it->second.end) {
+      result.push_back(it->second);
+    }
+  }
+  return result;
+}
+
+std::vector<uint64_t>
+SyntheticViewOracle::functions_containing(uint64_t addr) const {
+  std::vector<uint64_t> result;
+  for (const auto &block : basic_blocks_at(addr)) {
+    if (std::find(result.begin(), result.end(), block.function) ==
+        result.end()) {
+      result.push_back(block.function);
+    }
+  }
+  return result;
+}
+
+std::string SyntheticViewOracle::function_name(uint64_t function) const {
+  auto it = function_names_.find(function);
+  return it != function_names_.end() ? it->second : std::string{};
+}
+
+} // namespace binja::covex::core
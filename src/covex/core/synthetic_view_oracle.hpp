@@ -0,0 +1,68 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "covex/core/view_oracle.hpp"
+
+namespace binja::covex::core {
+
+// In-memory ViewOracle for tests and benchmarks. Describe the binary with the
+// add_* setters first; queries are then safe from several threads as long as
+// nothing is added concurrently. Every address decodes to the default
+// instruction length unless overridden, and addresses inside [start, end) are
+// valid.
+class SyntheticViewOracle final : public ViewOracle {
+public:
+  SyntheticViewOracle(uint64_t start, uint64_t end, uint64_t image_base);
+
+  void set_original_filename(std::string path);
+  void set_default_instruction_length(uint64_t length);
+  // A length of 0 marks addr as undecodable.
+  void set_instruction_length(uint64_t addr, uint64_t length);
+  void add_segment(const OracleSegment &segment);
+  void add_section(const OracleSection &section);
+  void add_data_variable(uint64_t addr);
+  void add_function(uint64_t entry, std::string name);
+  // Adds a block to the function at `function`, which need not be named.
+  void add_block(uint64_t start, uint64_t end, uint64_t function);
+
+  uint64_t start() const override { return start_; }
+  uint64_t end() const override { return end_; }
+  uint64_t image_base() const override { return image_base_; }
+  std::string original_filename() const override { return filename_; }
+  bool is_valid_offset(uint64_t addr) const override;
+
+  uint64_t instruction_length(uint64_t addr) const override;
+  uint64_t max_instruction_length() const override { return 16; }
+  uint64_t instruction_alignment() const override { return 1; }
+
+  std::vector<OracleSegment> segments() const override;
+  std::optional<OracleSegment> segment_at(uint64_t addr) const override;
+  std::vector<OracleSection> sections_at(uint64_t addr) const override;
+  bool has_data_variable(uint64_t addr) const override;
+
+  std::vector<OracleBlock> basic_blocks() const override;
+  std::vector<OracleBlock> basic_blocks_at(uint64_t addr) const override;
+  std::vector<uint64_t> functions_containing(uint64_t addr) const override;
+  std::string function_name(uint64_t function) const override;
+
+private:
+  uint64_t start_ = 0;
+  uint64_t end_ = 0;
+  uint64_t image_base_ = 0;
+  std::string filename_;
+  uint64_t default_length_ = 4;
+  std::unordered_map<uint64_t, uint64_t> lengths_;
+  std::vector<OracleSegment> segments_;
+  std::vector<OracleSection> sections_;
+  std::unordered_set<uint64_t> data_variables_;
+  std::unordered_map<uint64_t, std::string> function_names_;
+  // Keyed by block start.
+  std::multimap<uint64_t, OracleBlock> blocks_;
+  uint64_t max_block_size_ = 0;
+};
+
+} // namespace binja::covex::core
@@ -0,0 +1,90 @@
+#include "covex/core/task_scheduler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace binja::covex::core {
+
+namespace {
+
+constexpr size_t kMinSharedWorkers = 2;
+constexpr size_t kMaxSharedWorkers = 4;
+
+} // namespace
+
+TaskScheduler::TaskScheduler(size_t workers) {
+  workers = std::max<size_t>(1, workers);
+  bulk_limit_ = std::max<size_t>(1, workers - 1);
+  workers_.reserve(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    workers_.emplace_back([this]() { run_worker(); });
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+TaskScheduler &TaskScheduler::shared() {
+  // Never destroyed: tasks may still be running when the plugin unloads.
+  static TaskScheduler *scheduler = new TaskScheduler(
+      std::clamp<size_t>(std::thread::hardware_concurrency() / 2,
+                         kMinSharedWorkers, kMaxSharedWorkers));
+  return *scheduler;
+}
+
+void TaskScheduler::submit(TaskLane lane, std::function<void()> task) {
+  if (!task) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &queue = lane == TaskLane::Interactive ? interactive_ : bulk_;
+    queue.push_back(std::move(task));
+  }
+  ready_.notify_one();
+}
+
+bool TaskScheduler::has_runnable() const {
+  return !interactive_.empty() ||
+         (!bulk_.empty() && bulk_running_ < bulk_limit_);
+}
+
+void TaskScheduler::run_worker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_.wait(lock, [this]() { return stopping_ || has_runnable(); });
+    if (stopping_) {
+      return;
+    }
+    const bool bulk = interactive_.empty();
+    auto &queue = bulk ? bulk_ : interactive_;
+    auto task = std::move(queue.front());
+    queue.pop_front();
+    if (bulk) {
+      ++bulk_running_;
+    }
+
+    lock.unlock();
+    try {
+      task();
+    } catch (...) {
+    }
+    // Release the task's captures before taking the lock again.
+    task = nullptr;
+    lock.lock();
+
+    if (bulk) {
+      --bulk_running_;
+    }
+  }
+}
+
+} // namespace binja::covex::core
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace binja::covex::core {
+
+enum class TaskLane {
+  // Work the user is waiting on: composition, block filters, paint plans.
+  Interactive,
+  // Long-running work: loading traces, function discovery.
+  Bulk,
+};
+
+// Fixed pool of worker threads. Queued interactive tasks run before queued
+// bulk ones, and bulk tasks never take the last worker, so edits are picked
+// up promptly while traces load. Tasks are expected to handle their own
+// errors; anything they throw is discarded.
+class TaskScheduler {
+public:
+  explicit TaskScheduler(size_t workers);
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler &) = delete;
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+  // Pool shared by every workspace, sized from the hardware thread count.
+  static TaskScheduler &shared();
+
+  void submit(TaskLane lane, std::function<void()> task);
+  size_t worker_count() const { return workers_.size(); }
+
+private:
+  void run_worker();
+  bool has_runnable() const;
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::function<void()>> interactive_;
+  std::deque<std::function<void()>> bulk_;
+  size_t bulk_limit_ = 1;
+  size_t bulk_running_ = 0;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+} // namespace binja::covex::core
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace binja::covex::core {
+
+struct OracleSegment {
+  uint64_t start = 0;
+  uint64_t end = 0;
+  bool executable = false;
+  bool contains_code = false;
+  bool deny_execute = false;
+};
+
+struct OracleSection {
+  uint64_t start = 0;
+  uint64_t end = 0;
+  bool read_only_code = false;
+};
+
+struct OracleBlock {
+  uint64_t start = 0;
+  uint64_t end = 0;
+  // Entry address of the owning function.
+  uint64_t function = 0;
+};
+
+// The view queries used by mapping, module matching and discovery planning.
+// Keeping them behind this interface lets those paths run against a
+// SyntheticViewOracle without Binary Ninja, e.g. for benchmarks. All queries
+// use the view's default architecture and must be safe to call from several
+// threads at once.
+class ViewOracle {
+public:
+  virtual ~ViewOracle() = default;
+
+  virtual uint64_t start() const = 0;
+  virtual uint64_t end() const = 0;
+  virtual uint64_t image_base() const = 0;
+  virtual std::string original_filename() const = 0;
+  virtual bool is_valid_offset(uint64_t addr) const = 0;
+
+  // Decoded length of the instruction at addr, or 0 if it does not decode.
+  virtual uint64_t instruction_length(uint64_t addr) const = 0;
+  virtual uint64_t max_instruction_length() const = 0;
+  virtual uint64_t instruction_alignment() const = 0;
+
+  virtual std::vector<OracleSegment> segments() const = 0;
+  virtual std::optional<OracleSegment> segment_at(uint64_t addr) const = 0;
+  virtual std::vector<OracleSection> sections_at(uint64_t addr) const = 0;
+  virtual bool has_data_variable(uint64_t addr) const = 0;
+
+  // Every basic block of every function, in no particular order.
+  virtual std::vector<OracleBlock> basic_blocks() const = 0;
+  virtual std::vector<OracleBlock> basic_blocks_at(uint64_t addr) const = 0;
+  // Entry addresses of the functions containing addr.
+  virtual std::vector<uint64_t> functions_containing(uint64_t addr) const = 0;
+  virtual std::string function_name(uint64_t function) const = 0;
+};
+
+} // namespace binja::covex::core
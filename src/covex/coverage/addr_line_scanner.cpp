@@ -0,0 +1,282 @@
+#include "covex/coverage/addr_line_scanner.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+// COVEX_SCAN_NO_SIMD forces the scalar classifier, so tests can cover it on
+// SIMD-capable hosts.
+#if defined(COVEX_SCAN_NO_SIMD)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define COVEX_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) ||                                 \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COVEX_SCAN_SSE2 1
+#endif
+
+namespace binja::covex::coverage {
+
+namespace {
+
+constexpr size_t kBlockSize = 64;
+
+struct RawMasks {
+  uint64_t newline = 0;
+  uint64_t hash_semi = 0;
+  uint64_t slash = 0;
+  uint64_t separator = 0;
+  uint64_t punctuation = 0;
+};
+
+uint64_t low_bits(size_t count) {
+  return count >= kBlockSize ? ~uint64_t{0} : (uint64_t{1} << count) - 1;
+}
+
+#if defined(COVEX_SCAN_AVX2)
+
+RawMasks classify_block(const char *data) {
+  RawMasks masks;
+  for (size_t lane = 0; lane < kBlockSize; lane += 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + lane));
+    const auto eq = [&v](char ch) {
+      return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(ch));
+    };
+    // Bytes 0x09..0x0d (\t \n \v \f \r) via an unsigned range check.
+    const __m256i ctrl = _mm256_sub_epi8(v, _mm256_set1_epi8(9));
+    const __m256i is_ctrl = _mm256_cmpeq_epi8(
+        _mm256_min_epu8(ctrl, _mm256_set1_epi8(4)), ctrl);
+    const __m256i punct = _mm256_or_si256(eq(','), eq(':'));
+    const __m256i sep =
+        _mm256_or_si256(_mm256_or_si256(is_ctrl, eq(' ')), punct);
+    const auto bits = [](__m256i m) {
+      return static_cast<uint64_t>(
+          static_cast<uint32_t>(_mm256_movemask_epi8(m)));
+    };
+    masks.newline |= bits(eq('\n')) << lane;
+    masks.hash_semi |= bits(_mm256_or_si256(eq('#'), eq(';'))) << lane;
+    masks.slash |= bits(eq('/')) << lane;
+    masks.separator |= bits(sep) << lane;
+    masks.punctuation |= bits(punct) << lane;
+  }
+  return masks;
+}
+
+#elif defined(COVEX_SCAN_SSE2)
+
+RawMasks classify_block(const char *data) {
+  RawMasks masks;
+  for (size_t lane = 0; lane < kBlockSize; lane += 16) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + lane));
+    const auto eq = [&v](char ch) {
+      return _mm_cmpeq_epi8(v, _mm_set1_epi8(ch));
+    };
+    // Bytes 0x09..0x0d (\t \n \v \f \r) via an unsigned range check.
+    const __m128i ctrl = _mm_sub_epi8(v, _mm_set1_epi8(9));
+    const __m128i is_ctrl =
+        _mm_cmpeq_epi8(_mm_min_epu8(ctrl, _mm_set1_epi8(4)), ctrl);
+    const __m128i punct = _mm_or_si128(eq(','), eq(':'));
+    const __m128i sep = _mm_or_si128(_mm_or_si128(is_ctrl, eq(' ')), punct);
+    const auto bits = [](__m128i m) {
+      return static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(m)));
+    };
+    masks.newline |= bits(eq('\n')) << lane;
+    masks.hash_semi |= bits(_mm_or_si128(eq('#'), eq(';'))) << lane;
+    masks.slash |= bits(eq('/')) << lane;
+    masks.separator |= bits(sep) << lane;
+    masks.punctuation |= bits(punct) << lane;
+  }
+  return masks;
+}
+
+#else
+
+RawMasks classify_block(const char *data) {
+  RawMasks masks;
+  for (size_t i = 0; i < kBlockSize; ++i) {
+    const auto ch = static_cast<unsigned char>(data[i]);
+    const uint64_t bit = uint64_t{1} << i;
+    if (ch == '\n') {
+      masks.newline |= bit;
+    }
+    if (ch == '#' || ch == ';') {
+      masks.hash_semi |= bit;
+    }
+    if (ch == '/') {
+      masks.slash |= bit;
+    }
+    if (ch == ',' || ch == ':') {
+      masks.punctuation |= bit;
+    }
+    if ((ch >= '\t' && ch <= '\r') || ch == ' ' || ch == ',' || ch == ':') {
+      masks.separator |= bit;
+    }
+  }
+  return masks;
+}
+
+#endif
+
+constexpr std::array<uint8_t, 256> make_hex_table() {
+  std::array<uint8_t, 256> table{};
+  for (auto &entry : table) {
+    entry = 0xff;
+  }
+  for (int i = 0; i < 10; ++i) {
+    table['0' + i] = static_cast<uint8_t>(i);
+  }
+  for (int i = 0; i < 6; ++i) {
+    table['a' + i] = static_cast<uint8_t>(10 + i);
+    table['A' + i] = static_cast<uint8_t>(10 + i);
+  }
+  return table;
+}
+
+constexpr auto kHexTable = make_hex_table();
+
+} // namespace
+
+const AddrLineScanner::BlockMasks &AddrLineScanner::masks_at(size_t block) {
+  if (block == cached_block_) {
+    return cached_;
+  }
+  const size_t available = std::min(kBlockSize, data_.size() - block);
+  RawMasks raw;
+  if (available == kBlockSize) {
+    raw = classify_block(data_.data() + block);
+  } else {
+    char padded[kBlockSize] = {};
+    std::memcpy(padded, data_.data() + block, available);
+    raw = classify_block(padded);
+  }
+
+  // A '/' only starts a comment when the next byte is also '/', which may
+  // live in the following block.
+  const bool next_is_slash = block + kBlockSize < data_.size() &&
+                             data_[block + kBlockSize] == '/';
+  const uint64_t slash_pairs =
+      raw.slash &
+      ((raw.slash >> 1) | (next_is_slash ? uint64_t{1} << 63 : uint64_t{0}));
+
+  const uint64_t valid = low_bits(available);
+  cached_.newline = raw.newline & valid;
+  cached_.comment = (raw.hash_semi | slash_pairs) & valid;
+  cached_.separator = raw.separator & valid;
+  cached_.punctuation = raw.punctuation & valid;
+  cached_block_ = block;
+  return cached_;
+}
+
+bool AddrLineScanner::next(ScannedLine &line) {
+  if (pos_ >= data_.size()) {
+    return false;
+  }
+
+  const size_t start = pos_;
+  size_t line_end = data_.size();
+  size_t token_start = start;
+  bool in_token = false;
+  bool in_comment = false;
+  line.token_count = 0;
+  line.blank = true;
+
+  const auto emit = [&](size_t begin, size_t end) {
+    if (line.token_count < ScannedLine::kMaxTokens) {
+      line.tokens[line.token_count] = data_.substr(begin, end - begin);
+    }
+    if (line.token_count <= ScannedLine::kMaxTokens) {
+      ++line.token_count;
+    }
+  };
+
+  for (size_t block = start & ~(kBlockSize - 1); block < data_.size();
+       block += kBlockSize) {
+    const auto &masks = masks_at(block);
+    const size_t available = std::min(kBlockSize, data_.size() - block);
+    uint64_t live = low_bits(available);
+    if (start > block) {
+      live &= ~low_bits(start - block);
+    }
+
+    uint64_t line_bits = live;
+    const uint64_t newline = masks.newline & live;
+    size_t stop = kBlockSize;
+    if (newline != 0) {
+      stop = static_cast<size_t>(std::countr_zero(newline));
+      line_bits &= low_bits(stop);
+    }
+
+    uint64_t content = 0;
+    if (!in_comment) {
+      uint64_t before_comment = line_bits;
+      const uint64_t comment = masks.comment & line_bits;
+      if (comment != 0) {
+        before_comment &=
+            low_bits(static_cast<size_t>(std::countr_zero(comment)));
+        in_comment = true;
+      }
+      content = before_comment & ~masks.separator;
+      if ((before_comment & (content | masks.punctuation)) != 0) {
+        line.blank = false;
+      }
+    }
+
+    // Token edges: a start is content preceded by non-content, an end is
+    // non-content preceded by content (carrying across blocks).
+    const uint64_t previous = (content << 1) | (in_token ? 1 : 0);
+    const uint64_t starts = content & ~previous;
+    uint64_t edges = starts | (~content & previous);
+    while (edges != 0) {
+      const auto bit = static_cast<size_t>(std::countr_zero(edges));
+      edges &= edges - 1;
+      if ((starts >> bit) & 1) {
+        token_start = block + bit;
+      } else {
+        emit(token_start, block + bit);
+      }
+    }
+    in_token = (content >> 63) != 0;
+
+    if (newline != 0) {
+      line_end = block + stop;
+      break;
+    }
+  }
+  if (in_token) {
+    emit(token_start, line_end);
+  }
+
+  line.raw = data_.substr(start, line_end - start);
+  pos_ = line_end < data_.size() ? line_end + 1 : data_.size();
+  return true;
+}
+
+bool parse_hex_u64(std::string_view text, uint64_t &out) {
+  if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+    text.remove_prefix(2);
+  }
+  if (text.empty()) {
+    return false;
+  }
+  while (text.size() > 1 && text.front() == '0') {
+    text.remove_prefix(1);
+  }
+  if (text.size() > 16) {
+    return false;
+  }
+  uint64_t value = 0;
+  for (const char ch : text) {
+    const uint8_t digit = kHexTable[static_cast<unsigned char>(ch)];
+    if (digit == 0xff) {
+      return false;
+    }
+    value = (value << 4) | digit;
+  }
+  out = value;
+  return true;
+}
+
+} // namespace binja::covex::coverage
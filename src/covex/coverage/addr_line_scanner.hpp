@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace binja::covex::coverage {
+
+// One address-trace line split into its fields. Views point into the scanned
+// buffer; nothing is copied.
+struct ScannedLine {
+  static constexpr size_t kMaxTokens = 2;
+
+  std::string_view raw;
+  std::array<std::string_view, kMaxTokens> tokens{};
+  // Number of fields before any comment; kMaxTokens + 1 means "too many".
+  size_t token_count = 0;
+  // True when only whitespace precedes the comment (or end of line).
+  bool blank = true;
+};
+
+// Splits a buffer into address-trace lines. Newlines, field separators
+// (whitespace, ',' and ':') and comment markers ('#', ';', "//") are located
+// 64 bytes at a time with AVX2 or SSE2 when available, scalar otherwise.
+class AddrLineScanner {
+public:
+  explicit AddrLineScanner(std::string_view data) : data_(data) {}
+
+  bool next(ScannedLine &line);
+  size_t position() const { return pos_; }
+
+private:
+  struct BlockMasks {
+    uint64_t newline = 0;
+    uint64_t comment = 0;
+    uint64_t separator = 0;
+    uint64_t punctuation = 0;
+  };
+
+  const BlockMasks &masks_at(size_t block);
+
+  std::string_view data_;
+  size_t pos_ = 0;
+  size_t cached_block_ = SIZE_MAX;
+  BlockMasks cached_{};
+};
+
+// Parses a hex number with an optional 0x prefix. Fails on empty input,
+// non-hex characters and values that do not fit in 64 bits.
+bool parse_hex_u64(std::string_view text, uint64_t &out);
+
+} // namespace binja::covex::coverage
@@ -1,15 +1,16 @@
 #include "covex/coverage/addr_trace_reader.hpp"
 
 #include <algorithm>
-#include <cctype>
-#include <cerrno>
-#include <cstdlib>
 #include <filesystem>
-#include <fstream>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <vector>
+
+#include "covex/coverage/addr_line_scanner.hpp"
+#include "covex/coverage/hit_table.hpp"
+#include "covex/coverage/parallel_for.hpp"
 
 namespace binja::covex::coverage {
 
@@ -17,175 +18,60 @@ namespace {
 
 constexpr size_t kHeaderProbeSize = 16;
 constexpr size_t kSampleLineLimit = 32;
+constexpr size_t kMinChunkBytes = 8 * 1024 * 1024;
 
-std::string_view trim_left(std::string_view text) {
-  size_t pos = 0;
-  while (pos < text.size() &&
-         std::isspace(static_cast<unsigned char>(text[pos])) != 0) {
-    ++pos;
-  }
-  return text.substr(pos);
-}
-
-std::string_view trim_right(std::string_view text) {
-  size_t pos = text.size();
-  while (pos > 0 &&
-         std::isspace(static_cast<unsigned char>(text[pos - 1])) != 0) {
-    --pos;
-  }
-  return text.substr(0, pos);
-}
-
-std::string_view trim(std::string_view text) {
-  return trim_right(trim_left(text));
-}
-
-bool starts_with(std::string_view text, std::string_view prefix) {
-  return text.size() >= prefix.size() &&
-         text.substr(0, prefix.size()) == prefix;
-}
-
-std::string_view strip_comment(std::string_view line) {
-  const std::string_view trimmed = trim_left(line);
-  if (starts_with(trimmed, "#") || starts_with(trimmed, ";") ||
-      starts_with(trimmed, "//")) {
-    return std::string_view{};
-  }
-
-  const auto hash = line.find('#');
-  const auto semi = line.find(';');
-  const auto slash = line.find("//");
-  size_t cut = std::string_view::npos;
-  if (hash != std::string_view::npos) {
-    cut = hash;
-  }
-  if (semi != std::string_view::npos) {
-    cut = std::min(cut, semi);
-  }
-  if (slash != std::string_view::npos) {
-    cut = std::min(cut, slash);
-  }
-  if (cut != std::string_view::npos) {
-    return trim_right(line.substr(0, cut));
-  }
-  return trim_right(line);
-}
-
-bool parse_number(std::string_view text, uint64_t &out) {
-  std::string value(text);
-  if (value.empty()) {
-    return false;
-  }
-  if (value.size() > 2 && value[0] == '0' &&
-      (value[1] == 'x' || value[1] == 'X')) {
-    value.erase(0, 2);
-  }
-  if (value.empty()) {
-    return false;
-  }
-  for (const auto ch : value) {
-    if ((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') ||
-        (ch >= 'A' && ch <= 'F')) {
-      continue;
-    }
-    return false;
-  }
-  char *end = nullptr;
-  errno = 0;
-  out = std::strtoull(value.c_str(), &end, 16);
-  if (errno != 0) {
-    return false;
-  }
-  return end != nullptr && *end == '\0';
-}
+struct ChunkResult {
+  HitTable hits;
+  bool has_explicit_hitcounts = false;
+  std::optional<std::string> invalid_line;
+};
 
-bool parse_addr_hit_tokens(const std::vector<std::string_view> &tokens,
-                           uint64_t &addr, uint64_t &hits, bool &explicit_hit) {
-  if (tokens.empty() || tokens.size() > 2) {
+bool parse_addr_hit_line(const ScannedLine &line, uint64_t &addr,
+                         uint64_t &hits, bool &explicit_hit) {
+  if (line.token_count == 0 || line.token_count > ScannedLine::kMaxTokens) {
     return false;
   }
-  if (!parse_number(tokens[0], addr)) {
+  if (!parse_hex_u64(line.tokens[0], addr)) {
     return false;
   }
-  if (tokens.size() == 1) {
+  if (line.token_count == 1) {
     hits = 1;
     explicit_hit = false;
     return true;
   }
-  if (!parse_number(tokens[1], hits)) {
+  if (!parse_hex_u64(line.tokens[1], hits)) {
     return false;
   }
   explicit_hit = true;
   return true;
 }
 
-bool parse_addr_hit_line(std::string_view line, uint64_t &addr, uint64_t &hits,
-                         bool &explicit_hit) {
-  auto cleaned = strip_comment(line);
-  cleaned = trim(cleaned);
-  if (cleaned.empty()) {
-    return false;
-  }
-
-  std::vector<std::string_view> tokens;
-  std::string buffer(cleaned);
-  for (auto &ch : buffer) {
-    if (ch == ',' || ch == ':') {
-      ch = ' ';
-    }
-  }
-  size_t start = 0;
-  while (start < buffer.size()) {
-    while (start < buffer.size() &&
-           std::isspace(static_cast<unsigned char>(buffer[start])) != 0) {
-      ++start;
-    }
-    if (start >= buffer.size()) {
-      break;
-    }
-    size_t end = start;
-    while (end < buffer.size() &&
-           std::isspace(static_cast<unsigned char>(buffer[end])) == 0) {
-      ++end;
-    }
-    tokens.emplace_back(buffer.data() + start, end - start);
-    start = end;
-  }
-
-  return parse_addr_hit_tokens(tokens, addr, hits, explicit_hit);
-}
-
-bool has_drcov_header(const std::string &path) {
-  std::ifstream file(path, std::ios::binary);
-  if (!file) {
-    return false;
-  }
-  char header[kHeaderProbeSize] = {};
-  file.read(header, sizeof(header));
-  if (!file) {
-    return false;
-  }
-  return std::string_view(header, 5) == "DRCOV";
+bool has_drcov_header(std::string_view probe) {
+  return probe.size() >= kHeaderProbeSize && probe.substr(0, 5) == "DRCOV";
 }
 
-bool sample_is_addr_trace(const std::string &path) {
-  std::ifstream file(path);
-  if (!file) {
-    return false;
-  }
-  std::string line;
+bool sample_is_addr_trace(const CoverageSource &source) {
+  std::string_view probe = source.probe();
+  if (!source.probe_is_complete()) {
+    // Only sample complete lines from a truncated probe window.
+    const auto last_newline = probe.rfind('\n');
+    probe = last_newline == std::string_view::npos
+                ? std::string_view{}
+                : probe.substr(0, last_newline + 1);
+  }
+  AddrLineScanner scanner(probe);
+  ScannedLine line;
   size_t lines_checked = 0;
   size_t valid = 0;
-  while (std::getline(file, line) && lines_checked < kSampleLineLimit) {
+  while (lines_checked < kSampleLineLimit && scanner.next(line)) {
     ++lines_checked;
     uint64_t addr = 0;
     uint64_t hits = 0;
     bool explicit_hit = false;
-    auto cleaned = trim(strip_comment(line));
-    if (cleaned.empty()) {
+    if (line.blank) {
       continue;
     }
-    if (!parse_addr_hit_line(cleaned, addr, hits, explicit_hit)) {
+    if (!parse_addr_hit_line(line, addr, hits, explicit_hit)) {
       return false;
     }
     ++valid;
@@ -193,8 +79,49 @@ bool sample_is_addr_trace(const std::string &path) {
   return valid > 0;
 }
 
+// Splits data into up to `count` pieces, each ending just after a newline
+// (or at the end of the data), so no line straddles two chunks.
+std::vector<std::string_view> split_at_lines(std::string_view data,
+                                             size_t count) {
+  std::vector<std::string_view> chunks;
+  const size_t target = data.size() / std::max<size_t>(1, count);
+  size_t start = 0;
+  while (start < data.size()) {
+    size_t end = data.size();
+    if (chunks.size() + 1 < count && start + target < data.size()) {
+      const auto newline = data.find('\n', start + target);
+      end = newline == std::string_view::npos ? data.size() : newline + 1;
+    }
+    chunks.push_back(data.substr(start, end - start));
+    start = end;
+  }
+  return chunks;
+}
+
+void parse_chunk(std::string_view chunk, const CancellationToken &cancel,
+                 ChunkResult &result) {
+  AddrLineScanner scanner(chunk);
+  ScannedLine line;
+  for (size_t lines = 0; scanner.next(line); ++lines) {
+    cancel.poll(lines);
+    uint64_t addr = 0;
+    uint64_t count = 0;
+    bool explicit_hit = false;
+    if (line.blank) {
+      continue;
+    }
+    if (!parse_addr_hit_line(line, addr, count, explicit_hit)) {
+      result.invalid_line = std::string(line.raw);
+      return;
+    }
+    result.has_explicit_hitcounts =
+        result.has_explicit_hitcounts || explicit_hit;
+    result.hits[addr] += count;
+  }
+}
+
 CoverageTrace build_trace(const std::string &path,
-                          const std::unordered_map<uint64_t, uint64_t> &hits,
+                          const HitTable &hits,
                           bool has_explicit_hitcounts) {
   CoverageTrace trace;
   trace.format = has_explicit_hitcounts ? TraceFormat::AddrHitTrace
@@ -218,41 +145,60 @@ CoverageTrace build_trace(const std::string &path,
 } // namespace
 
 CoverageTrace AddrTraceReader::read(const std::string &path) {
-  std::ifstream file(path);
-  if (!file) {
-    throw std::runtime_error("Failed to open address trace file");
-  }
+  return read(CoverageSource::open(path));
+}
 
-  std::unordered_map<uint64_t, uint64_t> hits;
-  bool has_explicit_hitcounts = false;
-  std::string line;
-  while (std::getline(file, line)) {
-    uint64_t addr = 0;
-    uint64_t count = 0;
-    bool explicit_hit = false;
-    auto cleaned = trim(strip_comment(line));
-    if (cleaned.empty()) {
-      continue;
+CoverageTrace AddrTraceReader::read(const CoverageSource &source) {
+  return read(source, 0);
+}
+
+CoverageTrace AddrTraceReader::read(const CoverageSource &source,
+                                    size_t threads,
+                                    const CancellationToken &cancel) {
+  const auto data = source.data();
+  if (threads == 0) {
+    threads = data.size() < kParallelThreshold
+                  ? 1
+                  : parallel_worker_count(data.size() / kMinChunkBytes);
+  }
+
+  const auto chunks = split_at_lines(data, threads);
+  std::vector<ChunkResult> results(chunks.size());
+  parallel_for(chunks.size(), [&](size_t index) {
+    parse_chunk(chunks[index], cancel, results[index]);
+  });
+
+  // Chunks are in file order, so the first failing chunk holds the same
+  // line the sequential reader would have reported.
+  ChunkResult merged;
+  for (auto &result : results) {
+    if (result.invalid_line) {
+      throw std::runtime_error("Invalid address trace line: " +
+                               *result.invalid_line);
     }
-    if (!parse_addr_hit_line(cleaned, addr, count, explicit_hit)) {
-      throw std::runtime_error("Invalid address trace line: " + line);
+    merged.has_explicit_hitcounts =
+        merged.has_explicit_hitcounts || result.has_explicit_hitcounts;
+    if (result.hits.size() > merged.hits.size()) {
+      std::swap(result.hits, merged.hits);
     }
-    has_explicit_hitcounts = has_explicit_hitcounts || explicit_hit;
-    hits[addr] += count;
+    merged.hits.merge(result.hits);
+    result.hits.clear();
   }
 
-  return build_trace(path, hits, has_explicit_hitcounts);
+  return build_trace(source.path(), merged.hits,
+                     merged.has_explicit_hitcounts);
 }
 
-bool AddrTraceParser::can_parse(const std::string &path) const {
-  if (has_drcov_header(path)) {
+bool AddrTraceParser::can_parse(const CoverageSource &source) const {
+  if (has_drcov_header(source.probe())) {
     return false;
   }
-  return sample_is_addr_trace(path);
+  return sample_is_addr_trace(source);
 }
 
-CoverageTrace AddrTraceParser::parse(const std::string &path) const {
-  return AddrTraceReader::read(path);
+CoverageTrace AddrTraceParser::parse(const CoverageSource &source,
+                                     const CancellationToken &cancel) const {
+  return AddrTraceReader::read(source, 0, cancel);
 }
 
 } // namespace binja::covex::coverage
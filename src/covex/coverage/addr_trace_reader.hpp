@@ -8,13 +8,21 @@ namespace binja::covex::coverage {
 
 class AddrTraceReader {
 public:
+  // Inputs at least this large are split across worker threads by default.
+  static constexpr size_t kParallelThreshold = 32 * 1024 * 1024;
+
   static CoverageTrace read(const std::string &path);
+  static CoverageTrace read(const CoverageSource &source);
+  // threads == 0 picks a worker count from the input size; 1 is sequential.
+  static CoverageTrace read(const CoverageSource &source, size_t threads,
+                            const CancellationToken &cancel = {});
 };
 
 class AddrTraceParser final : public CoverageParser {
 public:
-  bool can_parse(const std::string &path) const override;
-  CoverageTrace parse(const std::string &path) const override;
+  bool can_parse(const CoverageSource &source) const override;
+  CoverageTrace parse(const CoverageSource &source,
+                      const CancellationToken &cancel) const override;
 };
 
 } // namespace binja::covex::coverage
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+namespace binja::covex::coverage {
+
+// Long-running loops poll their token once per this many items.
+inline constexpr size_t kCancelPollInterval = 4096;
+
+// Thrown by work that found its token cancelled. Partial results are
+// discarded.
+class OperationCancelled : public std::runtime_error {
+public:
+  OperationCancelled() : std::runtime_error("Operation cancelled") {}
+};
+
+// Cooperative cancellation flag shared by every copy of a token. A
+// default-constructed token is never cancelled.
+class CancellationToken {
+public:
+  CancellationToken() = default;
+
+  static CancellationToken create() {
+    CancellationToken token;
+    token.flag_ = std::make_shared<std::atomic<bool>>(false);
+    return token;
+  }
+
+  void cancel() const {
+    if (flag_) {
+      flag_->store(true, std::memory_order_relaxed);
+    }
+  }
+  bool cancelled() const {
+    return flag_ && flag_->load(std::memory_order_relaxed);
+  }
+  void throw_if_cancelled() const {
+    if (cancelled()) {
+      throw OperationCancelled();
+    }
+  }
+  // For loops: checks the flag on every kCancelPollInterval-th item.
+  void poll(size_t item) const {
+    if (item % kCancelPollInterval == 0) {
+      throw_if_cancelled();
+    }
+  }
+
+private:
+  std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+} // namespace binja::covex::coverage
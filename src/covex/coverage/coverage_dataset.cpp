@@ -1,31 +1,105 @@
 #include "covex/coverage/coverage_dataset.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
 namespace binja::covex::coverage {
 
-CoverageDataset::CoverageDataset(HitMap hits, std::vector<CoverageSpan> spans)
-    : hits_(std::move(hits)), spans_(std::move(spans)) {
+CoverageDataset::CoverageDataset(std::shared_ptr<const Columns> columns,
+                                 size_t begin, size_t end)
+    : columns_(std::move(columns)), begin_(begin), end_(end) {
   recompute_stats();
 }
 
-CoverageDataset CoverageDataset::from_hits(HitMap hits) {
-  std::vector<CoverageSpan> spans;
-  spans.reserve(hits.size());
-  for (const auto &[addr, count] : hits) {
-    CoverageSpan span;
-    span.address = addr;
-    span.size = 1;
-    span.hits = count;
-    spans.push_back(span);
+CoverageDataset CoverageDataset::from_hits(const HitMap &hits) {
+  std::vector<HitMap::value_type> entries(hits.begin(), hits.end());
+  std::sort(entries.begin(), entries.end(),
+            [](const HitMap::value_type &a, const HitMap::value_type &b) {
+              return a.first < b.first;
+            });
+
+  auto columns = std::make_shared<Columns>();
+  columns->addresses.reserve(entries.size());
+  columns->hits.reserve(entries.size());
+  for (const auto &[addr, count] : entries) {
+    columns->addresses.push_back(addr);
+    columns->hits.push_back(count);
+  }
+  const size_t count = entries.size();
+  return CoverageDataset(std::move(columns), 0, count);
+}
+
+CoverageDataset CoverageDataset::from_sorted(std::vector<uint64_t> addresses,
+                                             std::vector<uint64_t> hits) {
+  if (addresses.size() != hits.size()) {
+    throw std::invalid_argument("Coverage columns differ in length");
+  }
+  if (std::adjacent_find(addresses.begin(), addresses.end(),
+                         std::greater_equal<uint64_t>()) != addresses.end()) {
+    throw std::invalid_argument("Coverage addresses are not strictly sorted");
+  }
+
+  auto columns = std::make_shared<Columns>();
+  columns->addresses = std::move(addresses);
+  columns->hits = std::move(hits);
+  const size_t count = columns->addresses.size();
+  return CoverageDataset(std::move(columns), 0, count);
+}
+
+std::span<const uint64_t> CoverageDataset::addresses() const {
+  if (!columns_) {
+    return {};
+  }
+  return std::span<const uint64_t>(columns_->addresses)
+      .subspan(begin_, size());
+}
+
+std::span<const uint64_t> CoverageDataset::hit_counts() const {
+  if (!columns_) {
+    return {};
+  }
+  return std::span<const uint64_t>(columns_->hits).subspan(begin_, size());
+}
+
+CoverageDataset::const_iterator CoverageDataset::begin() const {
+  return const_iterator(addresses().data(), hit_counts().data());
+}
+
+CoverageDataset::const_iterator CoverageDataset::end() const {
+  return begin() + static_cast<std::ptrdiff_t>(size());
+}
+
+size_t CoverageDataset::lower_bound(uint64_t address) const {
+  const auto column = addresses();
+  return static_cast<size_t>(
+      std::lower_bound(column.begin(), column.end(), address) -
+      column.begin());
+}
+
+std::optional<uint64_t> CoverageDataset::find(uint64_t address) const {
+  const size_t index = lower_bound(address);
+  if (index == size() || addresses()[index] != address) {
+    return std::nullopt;
+  }
+  return hit_counts()[index];
+}
+
+CoverageDataset CoverageDataset::slice(uint64_t begin, uint64_t end) const {
+  if (begin >= end || empty()) {
+    return {};
   }
-  return CoverageDataset(std::move(hits), std::move(spans));
+  const size_t first = lower_bound(begin);
+  const size_t last = lower_bound(end);
+  return CoverageDataset(columns_, begin_ + first, begin_ + last);
 }
 
 void CoverageDataset::recompute_stats() {
-  stats_.total_spans = spans_.size();
-  stats_.unique_addresses = hits_.size();
+  stats_.total_spans = size();
+  stats_.unique_addresses = size();
   stats_.total_hits = 0;
-  for (const auto &[addr, count] : hits_) {
-    (void)addr;
+  for (const uint64_t count : hit_counts()) {
     stats_.total_hits += count;
   }
 }
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <compare>
 #include <cstddef>
 #include <cstdint>
-#include <unordered_map>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 
 #include "covex/coverage/coverage_types.hpp"
+#include "covex/coverage/hit_table.hpp"
 
 namespace binja::covex::coverage {
 
@@ -15,24 +20,131 @@ struct CoverageStats {
   size_t unique_addresses = 0;
 };
 
+// Immutable per-address hit counts stored as two parallel columns sorted by
+// strictly increasing address. Copies and slices share the column storage.
 class CoverageDataset {
 public:
-  using HitMap = std::unordered_map<uint64_t, uint64_t>;
+  using HitMap = HitTable;
+
+  struct Entry {
+    uint64_t address = 0;
+    uint64_t hits = 0;
+  };
+
+  class const_iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = Entry;
+    using difference_type = std::ptrdiff_t;
+    using reference = Entry;
+    using pointer = void;
+
+    const_iterator() = default;
+    const_iterator(const uint64_t *address, const uint64_t *hits)
+        : address_(address), hits_(hits) {}
+
+    Entry operator*() const { return {*address_, *hits_}; }
+    Entry operator[](difference_type offset) const {
+      return {address_[offset], hits_[offset]};
+    }
+    const_iterator &operator++() {
+      ++address_;
+      ++hits_;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+    const_iterator &operator--() {
+      --address_;
+      --hits_;
+      return *this;
+    }
+    const_iterator operator--(int) {
+      const_iterator copy = *this;
+      --*this;
+      return copy;
+    }
+    const_iterator &operator+=(difference_type offset) {
+      address_ += offset;
+      hits_ += offset;
+      return *this;
+    }
+    const_iterator &operator-=(difference_type offset) {
+      return *this += -offset;
+    }
+    friend const_iterator operator+(const_iterator it,
+                                    difference_type offset) {
+      return it += offset;
+    }
+    friend const_iterator operator+(difference_type offset,
+                                    const_iterator it) {
+      return it += offset;
+    }
+    friend const_iterator operator-(const_iterator it,
+                                    difference_type offset) {
+      return it -= offset;
+    }
+    friend difference_type operator-(const const_iterator &a,
+                                     const const_iterator &b) {
+      return a.address_ - b.address_;
+    }
+    friend bool operator==(const const_iterator &a, const const_iterator &b) {
+      return a.address_ == b.address_;
+    }
+    friend auto operator<=>(const const_iterator &a, const const_iterator &b) {
+      return a.address_ <=> b.address_;
+    }
+
+  private:
+    const uint64_t *address_ = nullptr;
+    const uint64_t *hits_ = nullptr;
+  };
 
   CoverageDataset() = default;
-  CoverageDataset(HitMap hits, std::vector<CoverageSpan> spans);
 
-  static CoverageDataset from_hits(HitMap hits);
+  // Builds a dataset from an unordered hit table.
+  static CoverageDataset from_hits(const HitMap &hits);
+  // Adopts columns that are already sorted by strictly increasing address.
+  // Throws std::invalid_argument if the columns differ in length or are not
+  // sorted.
+  static CoverageDataset from_sorted(std::vector<uint64_t> addresses,
+                                     std::vector<uint64_t> hits);
+
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+  std::span<const uint64_t> addresses() const;
+  std::span<const uint64_t> hit_counts() const;
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // Index of the first entry whose address is >= `address`.
+  size_t lower_bound(uint64_t address) const;
+  std::optional<uint64_t> find(uint64_t address) const;
+  bool contains(uint64_t address) const { return find(address).has_value(); }
+
+  // Entries with addresses in [begin, end). Shares storage with this dataset.
+  CoverageDataset slice(uint64_t begin, uint64_t end) const;
 
-  const HitMap &hits() const { return hits_; }
-  const std::vector<CoverageSpan> &spans() const { return spans_; }
   const CoverageStats &stats() const { return stats_; }
 
 private:
+  struct Columns {
+    std::vector<uint64_t> addresses;
+    std::vector<uint64_t> hits;
+  };
+
+  CoverageDataset(std::shared_ptr<const Columns> columns, size_t begin,
+                  size_t end);
+
   void recompute_stats();
 
-  HitMap hits_;
-  std::vector<CoverageSpan> spans_;
+  std::shared_ptr<const Columns> columns_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
   CoverageStats stats_{};
 };
 
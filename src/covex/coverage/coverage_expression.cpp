@@ -2,7 +2,11 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <stack>
+#include <utility>
+
+#include "covex/coverage/set_kernels.hpp"
 
 namespace binja::covex::coverage {
 
@@ -40,6 +44,293 @@ std::string upper_copy(std::string value) {
   return value;
 }
 
+// The plan compiled for a single streaming pass: operands refer to distinct
+// inputs by index and every operator carries its resolved merge policy.
+// Ops are in RPN order, so an op's subtree is the contiguous run
+// [begin, op] and its right operand is the op just before it.
+struct FusedOp {
+  enum class Kind { Operand, Union, Intersection, Subtract };
+
+  Kind kind = Kind::Operand;
+  size_t input = 0;
+  HitMergePolicy policy = HitMergePolicy::Left;
+  size_t begin = 0;
+  size_t left = 0;
+  // Upper bound on the size of the subtree's result.
+  size_t bound = 0;
+  // Set when this op or one below it joins operands of very unequal size,
+  // which the galloping compose kernels handle faster than a full merge.
+  bool gallops = false;
+};
+
+struct FusedProgram {
+  std::vector<const CoverageDataset *> inputs;
+  std::vector<FusedOp> ops;
+  size_t max_depth = 0;
+  HitMergePolicy union_policy = HitMergePolicy::Left;
+  HitMergePolicy intersect_policy = HitMergePolicy::Left;
+};
+
+// Value of a subexpression at one address: absent, or present with hits.
+struct FusedSlot {
+  bool present = false;
+  uint64_t hits = 0;
+};
+
+constexpr size_t kNoInput = static_cast<size_t>(-1);
+
+CompositionOp composition_op(FusedOp::Kind kind) {
+  switch (kind) {
+  case FusedOp::Kind::Intersection:
+    return CompositionOp::Intersection;
+  case FusedOp::Kind::Subtract:
+    return CompositionOp::Subtract;
+  case FusedOp::Kind::Union:
+  default:
+    return CompositionOp::Union;
+  }
+}
+
+// Validates the plan the same way a stack evaluation would and resolves each
+// alias to its dataset without copying it.
+std::variant<FusedProgram, ComposeError> compile_plan(
+    const ComposePlan &plan,
+    const std::unordered_map<std::string, CoverageDataset> &datasets,
+    HitMergePolicy union_policy, HitMergePolicy intersect_policy,
+    HitMergePolicy subtract_policy) {
+  FusedProgram program;
+  program.ops.reserve(plan.rpn.size());
+  program.union_policy = union_policy;
+  program.intersect_policy = intersect_policy;
+  std::unordered_map<std::string, size_t> input_index;
+  std::vector<size_t> stack;
+
+  for (const auto &token : plan.rpn) {
+    FusedOp op;
+    op.begin = program.ops.size();
+    if (token.type == ExprTokenType::Identifier) {
+      auto it = datasets.find(token.text);
+      if (it == datasets.end()) {
+        return ComposeError{"Unknown alias: " + token.text, token.position};
+      }
+      auto [slot, inserted] =
+          input_index.emplace(token.text, program.inputs.size());
+      if (inserted) {
+        program.inputs.push_back(&it->second);
+      }
+      op.input = slot->second;
+      op.bound = it->second.size();
+      stack.push_back(program.ops.size());
+      program.ops.push_back(op);
+      program.max_depth = std::max(program.max_depth, stack.size());
+      continue;
+    }
+
+    if (!is_operator(token.type)) {
+      return ComposeError{"Invalid token in expression", token.position};
+    }
+    if (stack.size() < 2) {
+      return ComposeError{"Malformed expression: missing operand",
+                          token.position};
+    }
+    const auto &right = program.ops[stack.back()];
+    stack.pop_back();
+    op.left = stack.back();
+    const auto &left = program.ops[op.left];
+    stack.back() = program.ops.size();
+    op.begin = left.begin;
+
+    if (token.type == ExprTokenType::IntersectOp) {
+      op.kind = FusedOp::Kind::Intersection;
+      op.policy = intersect_policy;
+      op.bound = std::min(left.bound, right.bound);
+    } else if (token.type == ExprTokenType::SubtractOp) {
+      op.kind = FusedOp::Kind::Subtract;
+      op.policy = subtract_policy;
+      op.bound = left.bound;
+    } else {
+      op.kind = FusedOp::Kind::Union;
+      op.policy = union_policy;
+      op.bound = left.bound + right.bound;
+    }
+    const bool unequal =
+        op.kind != FusedOp::Kind::Union &&
+        detail::should_gallop(std::min(left.bound, right.bound),
+                              std::max(left.bound, right.bound));
+    op.gallops = unequal || left.gallops || right.gallops;
+    program.ops.push_back(op);
+  }
+
+  if (stack.size() != 1) {
+    return ComposeError{"Malformed expression: extra operands", 0};
+  }
+  return program;
+}
+
+// The ops [begin, end) of one subtree as a program of their own, reading
+// only the inputs they reference. Subtree links in the copied ops are not
+// remapped; the fused pass does not use them.
+FusedProgram subprogram(const FusedProgram &program, size_t begin,
+                        size_t end) {
+  FusedProgram sub;
+  sub.union_policy = program.union_policy;
+  sub.intersect_policy = program.intersect_policy;
+  sub.ops.reserve(end - begin);
+  std::vector<size_t> remap(program.inputs.size(), kNoInput);
+  size_t depth = 0;
+  for (size_t i = begin; i < end; ++i) {
+    FusedOp op = program.ops[i];
+    if (op.kind == FusedOp::Kind::Operand) {
+      if (remap[op.input] == kNoInput) {
+        remap[op.input] = sub.inputs.size();
+        sub.inputs.push_back(program.inputs[op.input]);
+      }
+      op.input = remap[op.input];
+      sub.max_depth = std::max(sub.max_depth, ++depth);
+    } else {
+      --depth;
+    }
+    sub.ops.push_back(op);
+  }
+  return sub;
+}
+
+// Streams a k-way merge over the sorted inputs and evaluates the whole
+// expression once per address, so only the final result is materialized.
+// The merge policies are resolved into function objects before the loop.
+template <typename UnionMerge, typename IntersectMerge>
+CoverageDataset run_fused(const FusedProgram &program, UnionMerge union_merge,
+                          IntersectMerge intersect_merge,
+                          const CancellationToken &cancel) {
+  struct Cursor {
+    uint64_t address = 0;
+    size_t input = 0;
+  };
+  // Min-heap on address.
+  const auto later = [](const Cursor &a, const Cursor &b) {
+    return a.address > b.address;
+  };
+
+  std::vector<size_t> positions(program.inputs.size(), 0);
+  std::vector<Cursor> heap;
+  heap.reserve(program.inputs.size());
+  size_t largest_input = 0;
+  for (size_t input = 0; input < program.inputs.size(); ++input) {
+    const auto *dataset = program.inputs[input];
+    largest_input = std::max(largest_input, dataset->size());
+    if (!dataset->empty()) {
+      heap.push_back({dataset->addresses().front(), input});
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), later);
+
+  std::vector<FusedSlot> current(program.inputs.size());
+  std::vector<size_t> touched;
+  touched.reserve(program.inputs.size());
+  std::vector<FusedSlot> stack(program.max_depth);
+  std::vector<uint64_t> addresses;
+  std::vector<uint64_t> hits;
+  addresses.reserve(largest_input);
+  hits.reserve(largest_input);
+
+  for (size_t step = 0; !heap.empty(); ++step) {
+    cancel.poll(step);
+    const uint64_t address = heap.front().address;
+    while (!heap.empty() && heap.front().address == address) {
+      std::pop_heap(heap.begin(), heap.end(), later);
+      const size_t input = heap.back().input;
+      heap.pop_back();
+
+      const auto *dataset = program.inputs[input];
+      size_t &position = positions[input];
+      current[input] = {true, dataset->hit_counts()[position]};
+      touched.push_back(input);
+      if (++position < dataset->size()) {
+        heap.push_back({dataset->addresses()[position], input});
+        std::push_heap(heap.begin(), heap.end(), later);
+      }
+    }
+
+    size_t depth = 0;
+    for (const auto &op : program.ops) {
+      if (op.kind == FusedOp::Kind::Operand) {
+        stack[depth++] = current[op.input];
+        continue;
+      }
+      const FusedSlot right = stack[--depth];
+      FusedSlot &left = stack[depth - 1];
+      switch (op.kind) {
+      case FusedOp::Kind::Union:
+        if (left.present && right.present) {
+          left.hits = union_merge(left.hits, right.hits);
+        } else if (right.present) {
+          left = right;
+        }
+        break;
+      case FusedOp::Kind::Intersection:
+        if (left.present && right.present) {
+          left.hits = intersect_merge(left.hits, right.hits);
+        } else {
+          left.present = false;
+        }
+        break;
+      case FusedOp::Kind::Subtract:
+        if (right.present) {
+          left.present = false;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+    if (stack[0].present) {
+      addresses.push_back(address);
+      hits.push_back(stack[0].hits);
+    }
+
+    for (const size_t input : touched) {
+      current[input].present = false;
+    }
+    touched.clear();
+  }
+
+  return CoverageDataset::from_sorted(std::move(addresses), std::move(hits));
+}
+
+CoverageDataset run_fused(const FusedProgram &program,
+                          const CancellationToken &cancel) {
+  if (program.ops.size() == 1) {
+    return *program.inputs.front();
+  }
+  return with_merge_policy(program.union_policy, [&](auto union_merge) {
+    return with_merge_policy(
+        program.intersect_policy, [&](auto intersect_merge) {
+          return run_fused(program, union_merge, intersect_merge, cancel);
+        });
+  });
+}
+
+// Evaluates the subtree ending at ops[index]. Subtrees without unequal
+// joins run as one fused pass; an unequal intersection or subtraction
+// materializes its operands and joins them with the galloping kernels.
+CoverageDataset evaluate_op(const FusedProgram &program, size_t index,
+                            const CancellationToken &cancel) {
+  const auto &op = program.ops[index];
+  if (op.kind == FusedOp::Kind::Operand) {
+    return *program.inputs[op.input];
+  }
+  if (!op.gallops) {
+    if (op.begin == 0 && index + 1 == program.ops.size()) {
+      return run_fused(program, cancel);
+    }
+    return run_fused(subprogram(program, op.begin, index + 1), cancel);
+  }
+  const auto left = evaluate_op(program, op.left, cancel);
+  const auto right = evaluate_op(program, index - 1, cancel);
+  cancel.throw_if_cancelled();
+  return compose(left, right, composition_op(op.kind), op.policy);
+}
+
 } // namespace
 
 std::variant<ComposePlan, ComposeError>
@@ -148,51 +439,22 @@ std::variant<CoverageDataset, ComposeError> evaluate_expression(
     const std::unordered_map<std::string, CoverageDataset> &datasets,
     HitMergePolicy union_policy, HitMergePolicy intersect_policy,
     HitMergePolicy subtract_policy) {
-  std::vector<CoverageDataset> stack;
-  stack.reserve(plan.rpn.size());
-
-  for (const auto &token : plan.rpn) {
-    if (token.type == ExprTokenType::Identifier) {
-      auto it = datasets.find(token.text);
-      if (it == datasets.end()) {
-        return ComposeError{"Unknown alias: " + token.text, token.position};
-      }
-      stack.push_back(it->second);
-      continue;
-    }
-
-    if (!is_operator(token.type)) {
-      return ComposeError{"Invalid token in expression", token.position};
-    }
-
-    if (stack.size() < 2) {
-      return ComposeError{"Malformed expression: missing operand",
-                          token.position};
-    }
-
-    CoverageDataset right = std::move(stack.back());
-    stack.pop_back();
-    CoverageDataset left = std::move(stack.back());
-    stack.pop_back();
-
-    CompositionOp op = CompositionOp::Union;
-    HitMergePolicy policy = union_policy;
-    if (token.type == ExprTokenType::IntersectOp) {
-      op = CompositionOp::Intersection;
-      policy = intersect_policy;
-    } else if (token.type == ExprTokenType::SubtractOp) {
-      op = CompositionOp::Subtract;
-      policy = subtract_policy;
-    }
-
-    stack.push_back(compose(left, right, op, policy));
-  }
+  return evaluate_expression(plan, datasets, CancellationToken{},
+                             union_policy, intersect_policy, subtract_policy);
+}
 
-  if (stack.size() != 1) {
-    return ComposeError{"Malformed expression: extra operands", 0};
+std::variant<CoverageDataset, ComposeError> evaluate_expression(
+    const ComposePlan &plan,
+    const std::unordered_map<std::string, CoverageDataset> &datasets,
+    const CancellationToken &cancel, HitMergePolicy union_policy,
+    HitMergePolicy intersect_policy, HitMergePolicy subtract_policy) {
+  auto compiled = compile_plan(plan, datasets, union_policy, intersect_policy,
+                               subtract_policy);
+  if (auto *error = std::get_if<ComposeError>(&compiled)) {
+    return *error;
   }
-
-  return stack.front();
+  const auto &program = std::get<FusedProgram>(compiled);
+  return evaluate_op(program, program.ops.size() - 1, cancel);
 }
 
 } // namespace binja::covex::coverage
@@ -7,6 +7,7 @@
 #include <variant>
 #include <vector>
 
+#include "covex/coverage/cancellation.hpp"
 #include "covex/coverage/coverage_dataset.hpp"
 #include "covex/coverage/coverage_operations.hpp"
 
@@ -46,5 +47,13 @@ std::variant<CoverageDataset, ComposeError> evaluate_expression(
     HitMergePolicy union_policy = HitMergePolicy::Sum,
     HitMergePolicy intersect_policy = HitMergePolicy::Min,
     HitMergePolicy subtract_policy = HitMergePolicy::Left);
+// As above, throwing OperationCancelled once `cancel` is cancelled.
+std::variant<CoverageDataset, ComposeError> evaluate_expression(
+    const ComposePlan &plan,
+    const std::unordered_map<std::string, CoverageDataset> &datasets,
+    const CancellationToken &cancel,
+    HitMergePolicy union_policy = HitMergePolicy::Sum,
+    HitMergePolicy intersect_policy = HitMergePolicy::Min,
+    HitMergePolicy subtract_policy = HitMergePolicy::Left);
 
 } // namespace binja::covex::coverage
@@ -2,6 +2,13 @@
 
 namespace binja::covex::coverage {
 
+CoverageSource CoverageSource::open(const std::string &path) {
+  CoverageSource source;
+  source.path_ = path;
+  source.file_ = MappedFile::open(path);
+  return source;
+}
+
 void CoverageParserRegistry::register_parser(
     std::unique_ptr<CoverageParser> parser) {
   if (!parser) {
@@ -11,15 +18,17 @@ void CoverageParserRegistry::register_parser(
 }
 
 std::optional<CoverageTrace>
-CoverageParserRegistry::parse_first_match(const std::string &path) const {
+CoverageParserRegistry::parse_first_match(
+    const std::string &path, const CancellationToken &cancel) const {
+  const auto source = CoverageSource::open(path);
   for (const auto &parser : parsers_) {
     if (!parser) {
       continue;
     }
-    if (!parser->can_parse(path)) {
+    if (!parser->can_parse(source)) {
       continue;
     }
-    return parser->parse(path);
+    return parser->parse(source, cancel);
   }
   return std::nullopt;
 }
@@ -3,23 +3,49 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "covex/coverage/cancellation.hpp"
 #include "covex/coverage/coverage_types.hpp"
+#include "covex/coverage/mapped_file.hpp"
 
 namespace binja::covex::coverage {
 
+// A coverage file opened once and shared by format detection and parsing.
+class CoverageSource {
+public:
+  static constexpr size_t kProbeSize = 64 * 1024;
+
+  static CoverageSource open(const std::string &path);
+
+  const std::string &path() const { return path_; }
+  const MappedFile &file() const { return file_; }
+  std::string_view data() const { return file_.view(); }
+  // Leading window of the file used for format sniffing.
+  std::string_view probe() const { return data().substr(0, kProbeSize); }
+  bool probe_is_complete() const { return file_.size() <= kProbeSize; }
+
+private:
+  std::string path_;
+  MappedFile file_;
+};
+
 class CoverageParser {
 public:
   virtual ~CoverageParser() = default;
-  virtual bool can_parse(const std::string &path) const = 0;
-  virtual CoverageTrace parse(const std::string &path) const = 0;
+  virtual bool can_parse(const CoverageSource &source) const = 0;
+  // Throws OperationCancelled once `cancel` is cancelled.
+  virtual CoverageTrace parse(const CoverageSource &source,
+                              const CancellationToken &cancel) const = 0;
 };
 
 class CoverageParserRegistry {
 public:
   void register_parser(std::unique_ptr<CoverageParser> parser);
-  std::optional<CoverageTrace> parse_first_match(const std::string &path) const;
+  std::optional<CoverageTrace>
+  parse_first_match(const std::string &path,
+                    const CancellationToken &cancel = {}) const;
 
 private:
   std::vector<std::unique_ptr<CoverageParser>> parsers_;
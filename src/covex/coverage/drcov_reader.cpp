@@ -1,9 +1,11 @@
 #include "covex/coverage/drcov_reader.hpp"
 
+#include <charconv>
 #include <filesystem>
-#include <fstream>
+#include <optional>
 #include <stdexcept>
 #include <string_view>
+#include <vector>
 
 #include "drcov.hpp"
 
@@ -12,50 +14,341 @@ namespace binja::covex::coverage {
 namespace {
 
 constexpr size_t kHeaderProbeSize = 16;
+constexpr size_t kHitcountEntrySize = sizeof(uint32_t);
 
-bool has_drcov_header(const std::string &path) {
-  std::ifstream file(path, std::ios::binary);
-  if (!file) {
-    return false;
+bool has_drcov_header(std::string_view probe) {
+  return probe.size() >= kHeaderProbeSize && probe.substr(0, 5) == "DRCOV";
+}
+
+std::string_view trim(std::string_view text) {
+  constexpr std::string_view kSpace = " \t\r\n";
+  const auto start = text.find_first_not_of(kSpace);
+  if (start == std::string_view::npos) {
+    return {};
+  }
+  const auto end = text.find_last_not_of(kSpace);
+  return text.substr(start, end - start + 1);
+}
+
+bool starts_with(std::string_view text, std::string_view prefix) {
+  return text.size() >= prefix.size() &&
+         text.substr(0, prefix.size()) == prefix;
+}
+
+[[noreturn]] void fail(drcov::error_code code, const std::string &message) {
+  throw drcov::parse_error(code, message);
+}
+
+template <typename T>
+T parse_field(std::string_view text, int base, drcov::error_code code,
+              const char *what) {
+  text = trim(text);
+  if (base == 16 && text.size() > 2 && text[0] == '0' &&
+      (text[1] == 'x' || text[1] == 'X')) {
+    text.remove_prefix(2);
+  }
+  T value{};
+  const auto *first = text.data();
+  const auto *last = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(first, last, value, base);
+  if (text.empty() || ec != std::errc{} || ptr != last) {
+    fail(code, std::string("Malformed ") + what + ": " + std::string(text));
+  }
+  return value;
+}
+
+// Walks the text portion of a mapped drcov file line by line, leaving the
+// cursor positioned at the first byte of the following binary table.
+class LineCursor {
+public:
+  explicit LineCursor(std::string_view data) : data_(data) {}
+
+  bool next(std::string_view &line) {
+    if (pos_ >= data_.size()) {
+      return false;
+    }
+    const auto newline = data_.find('\n', pos_);
+    const size_t end =
+        newline == std::string_view::npos ? data_.size() : newline;
+    line = data_.substr(pos_, end - pos_);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    pos_ = newline == std::string_view::npos ? data_.size() : newline + 1;
+    return true;
+  }
+
+  size_t position() const { return pos_; }
+  void advance(size_t bytes) { pos_ += bytes; }
+  size_t remaining() const { return data_.size() - pos_; }
+
+private:
+  std::string_view data_;
+  size_t pos_ = 0;
+};
+
+struct ModuleColumns {
+  size_t count = 0;
+  std::optional<size_t> id;
+  std::optional<size_t> base;
+  std::optional<size_t> end;
+  std::optional<size_t> path;
+};
+
+ModuleColumns resolve_columns(std::string_view columns_text) {
+  ModuleColumns columns;
+  size_t start = 0;
+  while (true) {
+    const auto comma = columns_text.find(',', start);
+    const auto name = trim(columns_text.substr(
+        start, comma == std::string_view::npos ? std::string_view::npos
+                                               : comma - start));
+    if (name == "id") {
+      columns.id = columns.count;
+    } else if (name == "base" || name == "start") {
+      columns.base = columns.count;
+    } else if (name == "end") {
+      columns.end = columns.count;
+    } else if (name == "path") {
+      columns.path = columns.count;
+    }
+    ++columns.count;
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    start = comma + 1;
+  }
+  return columns;
+}
+
+ModuleInfo parse_module_line(std::string_view line,
+                             const ModuleColumns &columns) {
+  ModuleInfo info;
+  size_t start = 0;
+  for (size_t column = 0; column < columns.count; ++column) {
+    std::string_view value;
+    if (column + 1 == columns.count) {
+      // The last column (path) may itself contain commas.
+      value = trim(line.substr(start));
+    } else {
+      const auto comma = line.find(',', start);
+      if (comma == std::string_view::npos) {
+        fail(drcov::error_code::invalid_module_table,
+             "Module entry has too few columns");
+      }
+      value = trim(line.substr(start, comma - start));
+      start = comma + 1;
+    }
+
+    if (columns.id && column == *columns.id) {
+      info.id = parse_field<uint32_t>(value, 10,
+                                      drcov::error_code::invalid_module_table,
+                                      "module id");
+    } else if (columns.base && column == *columns.base) {
+      info.base = parse_field<uint64_t>(
+          value, 16, drcov::error_code::invalid_module_table, "module base");
+    } else if (columns.end && column == *columns.end) {
+      info.end = parse_field<uint64_t>(
+          value, 16, drcov::error_code::invalid_module_table, "module end");
+    } else if (columns.path && column == *columns.path) {
+      info.path = std::string(value);
+    }
+  }
+  return info;
+}
+
+void parse_module_table(LineCursor &cursor, CoverageTrace &trace,
+                        std::vector<uint64_t> &module_bases) {
+  std::string_view line;
+  if (!cursor.next(line)) {
+    fail(drcov::error_code::invalid_format, "Missing module table header");
+  }
+  if (!starts_with(line, drcov::constants::module_table_prefix)) {
+    fail(drcov::error_code::invalid_format, "Invalid module table header");
+  }
+
+  const auto content =
+      line.substr(drcov::constants::module_table_prefix.size());
+  size_t count = 0;
+  ModuleColumns columns;
+  if (content.find("version") == std::string_view::npos) {
+    count = parse_field<size_t>(content, 10, drcov::error_code::invalid_format,
+                                "module count");
+    columns = resolve_columns("id, base, end, entry, path");
+  } else {
+    const auto count_pos = content.find("count");
+    if (count_pos == std::string_view::npos) {
+      fail(drcov::error_code::invalid_format,
+           "Invalid module table header format");
+    }
+    count = parse_field<size_t>(content.substr(count_pos + 5), 10,
+                                drcov::error_code::invalid_format,
+                                "module count");
+    if (!cursor.next(line)) {
+      fail(drcov::error_code::invalid_format, "Missing columns header");
+    }
+    if (!starts_with(line, drcov::constants::columns_prefix)) {
+      fail(drcov::error_code::invalid_format, "Invalid columns header");
+    }
+    columns =
+        resolve_columns(line.substr(drcov::constants::columns_prefix.size()));
+  }
+
+  module_bases.reserve(count);
+  while (module_bases.size() < count && cursor.next(line)) {
+    const auto trimmed = trim(line);
+    if (trimmed.empty()) {
+      continue;
+    }
+    auto info = parse_module_line(trimmed, columns);
+    if (info.id != module_bases.size()) {
+      fail(drcov::error_code::invalid_module_table,
+           "Non-sequential module ID. Expected " +
+               std::to_string(module_bases.size()) + ", got " +
+               std::to_string(info.id));
+    }
+    module_bases.push_back(info.base);
+    trace.modules.emplace(info.id, std::move(info));
   }
-  char header[kHeaderProbeSize] = {};
-  file.read(header, sizeof(header));
-  if (!file) {
-    return false;
+  if (module_bases.size() != count) {
+    fail(drcov::error_code::invalid_module_table,
+         "Module table entry count mismatch. Expected " +
+             std::to_string(count) + ", but found " +
+             std::to_string(module_bases.size()));
   }
-  return std::string_view(header, 5) == "DRCOV";
 }
 
-CoverageTrace build_trace(const std::string &path,
-                          const drcov::coverage_data &data) {
+// Returns the location of the hitcount entries, or nullptr when the file has
+// no (or an empty) hit count table.
+const uint8_t *locate_hitcounts(const MappedFile &file, LineCursor cursor,
+                                size_t bb_count) {
+  std::string_view line;
+  if (!cursor.next(line) ||
+      !starts_with(line, drcov::constants::hitcount_table_prefix)) {
+    return nullptr;
+  }
+
+  const auto content =
+      line.substr(drcov::constants::hitcount_table_prefix.size());
+  const auto comma = content.find(',');
+  if (comma == std::string_view::npos) {
+    fail(drcov::error_code::invalid_hitcount_table,
+         "Invalid hitcount table header format");
+  }
+  const auto version_part = trim(content.substr(0, comma));
+  const auto count_part = trim(content.substr(comma + 1));
+  if (!starts_with(version_part, "version")) {
+    fail(drcov::error_code::invalid_hitcount_table,
+         "Missing version in hitcount table header");
+  }
+  if (!starts_with(count_part, "count")) {
+    fail(drcov::error_code::invalid_hitcount_table,
+         "Missing count in hitcount table header");
+  }
+  const auto version = parse_field<size_t>(
+      version_part.substr(7), 10, drcov::error_code::invalid_hitcount_table,
+      "hitcount table version");
+  const auto count = parse_field<size_t>(
+      count_part.substr(5), 10, drcov::error_code::invalid_hitcount_table,
+      "hitcount table count");
+  if (version != 1) {
+    fail(drcov::error_code::invalid_hitcount_table,
+         "Unsupported hitcount table version: " + std::to_string(version));
+  }
+  if (count != bb_count) {
+    fail(drcov::error_code::invalid_hitcount_table,
+         "Hitcount table count (" + std::to_string(count) +
+             ") does not match basic blocks count (" +
+             std::to_string(bb_count) + ")");
+  }
+  if (count == 0) {
+    return nullptr;
+  }
+  if (cursor.remaining() / kHitcountEntrySize < count) {
+    fail(drcov::error_code::invalid_binary_data,
+         "Failed to read complete hitcount table binary data");
+  }
+  return file.data() + cursor.position();
+}
+
+CoverageTrace read_mapped(const CoverageSource &source,
+                          const CancellationToken &cancel) {
+  const auto &file = source.file();
   CoverageTrace trace;
   trace.format = TraceFormat::DrcovBlocks;
-  trace.source_path = path;
-  trace.name = std::filesystem::path(path).filename().string();
-  trace.has_hitcounts = data.has_hitcounts();
-
-  for (const auto &module : data.modules) {
-    ModuleInfo info;
-    info.id = module.id;
-    info.base = module.base;
-    info.end = module.end;
-    info.path = module.path;
-    trace.modules.emplace(info.id, std::move(info));
+  trace.source_path = source.path();
+  trace.name = std::filesystem::path(source.path()).filename().string();
+
+  LineCursor cursor(file.view());
+  std::string_view line;
+  if (!cursor.next(line)) {
+    fail(drcov::error_code::invalid_format, "Missing version header");
+  }
+  if (!starts_with(line, drcov::constants::version_prefix)) {
+    fail(drcov::error_code::invalid_format, "Invalid version header format");
   }
+  parse_field<uint32_t>(line.substr(drcov::constants::version_prefix.size()),
+                        10, drcov::error_code::invalid_format,
+                        "version number");
 
-  trace.spans.reserve(data.basic_blocks.size());
-  for (size_t i = 0; i < data.basic_blocks.size(); ++i) {
-    const auto &bb = data.basic_blocks[i];
-    auto module_it = trace.modules.find(bb.module_id);
-    if (module_it == trace.modules.end()) {
-      continue;
+  if (!cursor.next(line)) {
+    fail(drcov::error_code::invalid_format, "Missing flavor header");
+  }
+  if (!starts_with(line, drcov::constants::flavor_prefix)) {
+    fail(drcov::error_code::invalid_format, "Invalid flavor header format");
+  }
+  const auto flavor = trim(line.substr(drcov::constants::flavor_prefix.size()));
+
+  std::vector<uint64_t> module_bases;
+  parse_module_table(cursor, trace, module_bases);
+
+  if (!cursor.next(line)) {
+    return trace;
+  }
+  if (!starts_with(line, drcov::constants::bb_table_prefix)) {
+    fail(drcov::error_code::invalid_format, "Invalid BB table header");
+  }
+  auto count_text = line.substr(drcov::constants::bb_table_prefix.size());
+  count_text = count_text.substr(0, count_text.find(' '));
+  const auto bb_count = parse_field<size_t>(
+      count_text, 10, drcov::error_code::invalid_bb_table, "BB table count");
+  if (bb_count == 0) {
+    return trace;
+  }
+  if (cursor.remaining() / drcov::constants::bb_entry_size < bb_count) {
+    fail(drcov::error_code::invalid_binary_data,
+         "Failed to read complete BB table binary data");
+  }
+  const uint8_t *bb_data = file.data() + cursor.position();
+  cursor.advance(bb_count * drcov::constants::bb_entry_size);
+
+  const uint8_t *hit_data = nullptr;
+  if (flavor == drcov::constants::drcov_hits_flavor) {
+    hit_data = locate_hitcounts(file, cursor, bb_count);
+  }
+  trace.has_hitcounts = hit_data != nullptr;
+
+  // Single pass: decode each entry straight out of the mapping into the
+  // final span storage.
+  trace.spans.resize(bb_count);
+  for (size_t i = 0; i < bb_count; ++i) {
+    cancel.poll(i);
+    const uint8_t *entry = bb_data + i * drcov::constants::bb_entry_size;
+    const auto start = drcov::detail::read_le<uint32_t>(entry);
+    const auto size = drcov::detail::read_le<uint16_t>(entry + 4);
+    const auto module_id = drcov::detail::read_le<uint16_t>(entry + 6);
+    if (module_id >= module_bases.size()) {
+      fail(drcov::error_code::validation_error,
+           "Basic block references invalid module ID: " +
+               std::to_string(module_id));
     }
-    CoverageSpan span;
-    span.address = module_it->second.base + bb.start;
-    span.size = bb.size;
-    span.hits = trace.has_hitcounts ? data.hitcounts[i] : 1;
-    span.module_id = bb.module_id;
-    trace.spans.push_back(span);
+    auto &span = trace.spans[i];
+    span.address = module_bases[module_id] + start;
+    span.size = size;
+    span.hits = hit_data ? drcov::detail::read_le<uint32_t>(
+                               hit_data + i * kHitcountEntrySize)
+                         : 1;
+    span.module_id = module_id;
   }
 
   return trace;
@@ -64,20 +357,29 @@ CoverageTrace build_trace(const std::string &path,
 } // namespace
 
 CoverageTrace DrcovReader::read(const std::string &path) {
+  return read(CoverageSource::open(path));
+}
+
+CoverageTrace DrcovReader::read(const CoverageSource &source) {
+  return read(source, CancellationToken{});
+}
+
+CoverageTrace DrcovReader::read(const CoverageSource &source,
+                                const CancellationToken &cancel) {
   try {
-    const auto data = drcov::read(path);
-    return build_trace(path, data);
+    return read_mapped(source, cancel);
   } catch (const drcov::parse_error &err) {
     throw std::runtime_error(err.what());
   }
 }
 
-bool DrcovParser::can_parse(const std::string &path) const {
-  return has_drcov_header(path);
+bool DrcovParser::can_parse(const CoverageSource &source) const {
+  return has_drcov_header(source.probe());
 }
 
-CoverageTrace DrcovParser::parse(const std::string &path) const {
-  return DrcovReader::read(path);
+CoverageTrace DrcovParser::parse(const CoverageSource &source,
+                                 const CancellationToken &cancel) const {
+  return DrcovReader::read(source, cancel);
 }
 
 } // namespace binja::covex::coverage
@@ -9,12 +9,16 @@ namespace binja::covex::coverage {
 class DrcovReader {
 public:
   static CoverageTrace read(const std::string &path);
+  static CoverageTrace read(const CoverageSource &source);
+  static CoverageTrace read(const CoverageSource &source,
+                            const CancellationToken &cancel);
 };
 
 class DrcovParser final : public CoverageParser {
 public:
-  bool can_parse(const std::string &path) const override;
-  CoverageTrace parse(const std::string &path) const override;
+  bool can_parse(const CoverageSource &source) const override;
+  CoverageTrace parse(const CoverageSource &source,
+                      const CancellationToken &cancel) const override;
 };
 
 } // namespace binja::covex::coverage
@@ -0,0 +1,264 @@
+#include "covex/coverage/expression_cache.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+#include "covex/coverage/coverage_operations.hpp"
+
+namespace binja::covex::coverage {
+
+namespace {
+
+constexpr size_t kNoChild = static_cast<size_t>(-1);
+
+struct ExprNode {
+  ExprTokenType type = ExprTokenType::Identifier;
+  size_t left = kNoChild;
+  size_t right = kNoChild;
+  size_t rpn_begin = 0;
+  size_t rpn_end = 0;
+  std::string key;
+  std::vector<std::string> aliases;
+};
+
+char policy_tag(HitMergePolicy policy) {
+  switch (policy) {
+  case HitMergePolicy::Sum:
+    return 's';
+  case HitMergePolicy::Min:
+    return 'n';
+  case HitMergePolicy::Max:
+    return 'x';
+  case HitMergePolicy::Left:
+  default:
+    return 'l';
+  }
+}
+
+struct Policies {
+  HitMergePolicy union_policy;
+  HitMergePolicy intersect_policy;
+  HitMergePolicy subtract_policy;
+
+  HitMergePolicy for_op(ExprTokenType type) const {
+    if (type == ExprTokenType::IntersectOp) {
+      return intersect_policy;
+    }
+    if (type == ExprTokenType::SubtractOp) {
+      return subtract_policy;
+    }
+    return union_policy;
+  }
+};
+
+// Canonical key for an operator node. Union and intersection commute unless
+// the policy keeps the left operand's hits, so their operands are ordered;
+// subtraction ignores its policy, so none is recorded.
+std::string operator_key(ExprTokenType type, HitMergePolicy policy,
+                         const std::string &left, const std::string &right) {
+  if (type == ExprTokenType::SubtractOp) {
+    return "(" + left + " - " + right + ")";
+  }
+  std::string op = type == ExprTokenType::IntersectOp ? "&" : "|";
+  op.push_back(policy_tag(policy));
+  if (policy != HitMergePolicy::Left && right < left) {
+    return "(" + right + " " + op + " " + left + ")";
+  }
+  return "(" + left + " " + op + " " + right + ")";
+}
+
+// Rebuilds the expression tree from a plan whose aliases all resolve.
+// Returns nothing for plans the plain evaluator would reject.
+std::optional<std::vector<ExprNode>> build_tree(
+    const ComposePlan &plan,
+    const std::unordered_map<std::string, CoverageDataset> &datasets,
+    const Policies &policies) {
+  std::vector<ExprNode> nodes;
+  nodes.reserve(plan.rpn.size());
+  std::vector<size_t> stack;
+
+  for (size_t i = 0; i < plan.rpn.size(); ++i) {
+    const auto &token = plan.rpn[i];
+    ExprNode node;
+    node.type = token.type;
+    node.rpn_end = i + 1;
+    if (token.type == ExprTokenType::Identifier) {
+      if (datasets.find(token.text) == datasets.end()) {
+        return std::nullopt;
+      }
+      node.rpn_begin = i;
+      node.key = token.text;
+      node.aliases = {token.text};
+    } else if (token.type == ExprTokenType::UnionOp ||
+               token.type == ExprTokenType::IntersectOp ||
+               token.type == ExprTokenType::SubtractOp) {
+      if (stack.size() < 2) {
+        return std::nullopt;
+      }
+      node.right = stack.back();
+      stack.pop_back();
+      node.left = stack.back();
+      stack.pop_back();
+      const auto &left = nodes[node.left];
+      const auto &right = nodes[node.right];
+      node.rpn_begin = left.rpn_begin;
+      node.key = operator_key(token.type, policies.for_op(token.type),
+                              left.key, right.key);
+      std::set_union(left.aliases.begin(), left.aliases.end(),
+                     right.aliases.begin(), right.aliases.end(),
+                     std::back_inserter(node.aliases));
+    } else {
+      return std::nullopt;
+    }
+    stack.push_back(nodes.size());
+    nodes.push_back(std::move(node));
+  }
+
+  if (stack.size() != 1) {
+    return std::nullopt;
+  }
+  return nodes;
+}
+
+} // namespace
+
+std::variant<CoverageDataset, ComposeError> ExpressionCache::evaluate(
+    const ComposePlan &plan,
+    const std::unordered_map<std::string, CoverageDataset> &datasets,
+    HitMergePolicy union_policy, HitMergePolicy intersect_policy,
+    HitMergePolicy subtract_policy) {
+  return evaluate(plan, datasets, CancellationToken{}, union_policy,
+                  intersect_policy, subtract_policy);
+}
+
+std::variant<CoverageDataset, ComposeError> ExpressionCache::evaluate(
+    const ComposePlan &plan,
+    const std::unordered_map<std::string, CoverageDataset> &datasets,
+    const CancellationToken &cancel, HitMergePolicy union_policy,
+    HitMergePolicy intersect_policy, HitMergePolicy subtract_policy) {
+  const Policies policies{union_policy, intersect_policy, subtract_policy};
+  auto tree = build_tree(plan, datasets, policies);
+  if (!tree) {
+    // Let the plain evaluator produce the exact error.
+    return evaluate_expression(plan, datasets, cancel, union_policy,
+                               intersect_policy, subtract_policy);
+  }
+  const auto &nodes = *tree;
+
+  const auto evaluate_node = [&](const auto &self, size_t index,
+                                 size_t level) -> CoverageDataset {
+    const auto &node = nodes[index];
+    if (node.type == ExprTokenType::Identifier) {
+      return datasets.at(node.key);
+    }
+
+    CoverageDataset result;
+    if (lookup(node.key, result)) {
+      return result;
+    }
+    cancel.throw_if_cancelled();
+    if (level < kComposedLevels) {
+      const auto left = self(self, node.left, level + 1);
+      const auto right = self(self, node.right, level + 1);
+      CompositionOp op = CompositionOp::Union;
+      if (node.type == ExprTokenType::IntersectOp) {
+        op = CompositionOp::Intersection;
+      } else if (node.type == ExprTokenType::SubtractOp) {
+        op = CompositionOp::Subtract;
+      }
+      result = compose(left, right, op, policies.for_op(node.type));
+    } else {
+      ComposePlan subplan;
+      subplan.rpn.assign(plan.rpn.begin() + node.rpn_begin,
+                         plan.rpn.begin() + node.rpn_end);
+      subplan.aliases = node.aliases;
+      auto evaluated =
+          evaluate_expression(subplan, datasets, cancel, union_policy,
+                              intersect_policy, subtract_policy);
+      result = std::get<CoverageDataset>(std::move(evaluated));
+    }
+    store(node.key, result, node.aliases);
+    return result;
+  };
+
+  return evaluate_node(evaluate_node, nodes.size() - 1, 0);
+}
+
+void ExpressionCache::invalidate_alias(const std::string &alias) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    if (std::binary_search(it->aliases.begin(), it->aliases.end(), alias)) {
+      used_bytes_ -= it->bytes;
+      entries_.erase(it->key);
+      it = lru_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ExpressionCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  entries_.clear();
+  used_bytes_ = 0;
+}
+
+void ExpressionCache::set_budget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_bytes_ = budget_bytes;
+  evict_to_budget();
+}
+
+size_t ExpressionCache::budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_bytes_;
+}
+
+size_t ExpressionCache::memory_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_bytes_;
+}
+
+size_t ExpressionCache::entry_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lru_.size();
+}
+
+bool ExpressionCache::lookup(const std::string &key, CoverageDataset &out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  out = it->second->dataset;
+  return true;
+}
+
+void ExpressionCache::store(const std::string &key,
+                            const CoverageDataset &dataset,
+                            std::vector<std::string> aliases) {
+  const size_t bytes = dataset.size() * 2 * sizeof(uint64_t) + key.size();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > budget_bytes_ || entries_.find(key) != entries_.end()) {
+    return;
+  }
+  lru_.push_front(Entry{key, dataset, std::move(aliases), bytes});
+  entries_.emplace(key, lru_.begin());
+  used_bytes_ += bytes;
+  evict_to_budget();
+}
+
+void ExpressionCache::evict_to_budget() {
+  while (used_bytes_ > budget_bytes_ && !lru_.empty()) {
+    auto &victim = lru_.back();
+    used_bytes_ -= victim.bytes;
+    entries_.erase(victim.key);
+    lru_.pop_back();
+  }
+}
+
+} // namespace binja::covex::coverage
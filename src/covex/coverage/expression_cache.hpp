@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "covex/coverage/coverage_dataset.hpp"
+#include "covex/coverage/coverage_expression.hpp"
+
+namespace binja::covex::coverage {
+
+// Memoizes evaluated composition sub-expressions so that editing one part
+// of an expression reuses the results of the unchanged parts. Entries are
+// keyed by a canonical form of the subtree plus its merge policies, evicted
+// least-recently-used once the memory budget is exceeded, and dropped when a
+// trace they reference changes. Safe to use from several threads.
+class ExpressionCache {
+public:
+  static constexpr size_t kDefaultBudgetBytes = 256ull * 1024 * 1024;
+  // Operator nodes this close to the root are built by composing their
+  // children, so each child lands in the cache; deeper subtrees are
+  // evaluated by evaluate_expression().
+  static constexpr size_t kComposedLevels = 2;
+
+  explicit ExpressionCache(size_t budget_bytes = kDefaultBudgetBytes)
+      : budget_bytes_(budget_bytes) {}
+
+  // Same contract as evaluate_expression().
+  std::variant<CoverageDataset, ComposeError> evaluate(
+      const ComposePlan &plan,
+      const std::unordered_map<std::string, CoverageDataset> &datasets,
+      HitMergePolicy union_policy = HitMergePolicy::Sum,
+      HitMergePolicy intersect_policy = HitMergePolicy::Min,
+      HitMergePolicy subtract_policy = HitMergePolicy::Left);
+  // Same contract as evaluate_expression() with a cancellation token.
+  // Nothing is cached for an evaluation that was cancelled part-way.
+  std::variant<CoverageDataset, ComposeError> evaluate(
+      const ComposePlan &plan,
+      const std::unordered_map<std::string, CoverageDataset> &datasets,
+      const CancellationToken &cancel,
+      HitMergePolicy union_policy = HitMergePolicy::Sum,
+      HitMergePolicy intersect_policy = HitMergePolicy::Min,
+      HitMergePolicy subtract_policy = HitMergePolicy::Left);
+
+  // Drops every entry whose expression references `alias`.
+  void invalidate_alias(const std::string &alias);
+  void clear();
+
+  void set_budget(size_t budget_bytes);
+  size_t budget() const;
+  size_t memory_bytes() const;
+  size_t entry_count() const;
+
+private:
+  struct Entry {
+    std::string key;
+    CoverageDataset dataset;
+    std::vector<std::string> aliases;
+    size_t bytes = 0;
+  };
+
+  bool lookup(const std::string &key, CoverageDataset &out);
+  void store(const std::string &key, const CoverageDataset &dataset,
+             std::vector<std::string> aliases);
+  void evict_to_budget();
+
+  mutable std::mutex mutex_;
+  size_t budget_bytes_ = kDefaultBudgetBytes;
+  size_t used_bytes_ = 0;
+  // Most recently used first.
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+};
+
+} // namespace binja::covex::coverage
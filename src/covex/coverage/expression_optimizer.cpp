@@ -0,0 +1,396 @@
+#include "covex/coverage/expression_optimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "covex/coverage/expression_cache.hpp"
+#include "covex/coverage/set_kernels.hpp"
+
+namespace binja::covex::coverage {
+
+namespace {
+
+enum class NodeKind { Alias, Empty, Union, Intersection, Subtract };
+
+struct PlanNode;
+using NodePtr = std::shared_ptr<const PlanNode>;
+
+struct PlanNode {
+  NodeKind kind = NodeKind::Alias;
+  std::string alias;
+  NodePtr left;
+  NodePtr right;
+  size_t position = 0;
+  // Canonical form; equal keys denote the same set and hit counts.
+  std::string key;
+  double cardinality = 0.0;
+  // Summed cardinality of the aliases below; a fused pass visits them all.
+  double input_size = 0.0;
+  // Whether evaluate_expression() joins this node, or one below it, with
+  // the galloping kernels instead of the fused pass.
+  bool gallops = false;
+  // level_cost[l]: cost of evaluating this node at depth l of an
+  // ExpressionCache evaluation. Depths from kComposedLevels on are handed to
+  // evaluate_expression().
+  std::array<double, ExpressionCache::kComposedLevels + 1> level_cost{};
+  // Cost as the root of an evaluation; the figure rewrites are ranked by.
+  double cost = 0.0;
+};
+
+struct Context {
+  const std::unordered_map<std::string, CoverageStats> &stats;
+  HitMergePolicy union_policy;
+  HitMergePolicy intersect_policy;
+
+  HitMergePolicy policy(NodeKind kind) const {
+    return kind == NodeKind::Intersection ? intersect_policy : union_policy;
+  }
+  // Operand order only matters when the left operand's hits win.
+  bool commutative(NodeKind kind) const {
+    return policy(kind) != HitMergePolicy::Left;
+  }
+  // X op X == X unless hits are summed.
+  bool idempotent(NodeKind kind) const {
+    return policy(kind) != HitMergePolicy::Sum;
+  }
+};
+
+bool is_unequal(double small, double large) {
+  return small * static_cast<double>(detail::kGallopRatio) < large;
+}
+
+// One compose() call: a linear merge, or galloping over the larger side when
+// the sizes are far apart.
+double merge_cost(double left, double right) {
+  const double small = std::min(left, right);
+  const double large = std::max(left, right);
+  if (is_unequal(small, large)) {
+    return small * std::log2(large + 2.0) + small;
+  }
+  return left + right;
+}
+
+char op_symbol(NodeKind kind) {
+  switch (kind) {
+  case NodeKind::Union:
+    return '|';
+  case NodeKind::Intersection:
+    return '&';
+  case NodeKind::Subtract:
+  default:
+    return '-';
+  }
+}
+
+NodePtr make_alias(const Context &ctx, const std::string &alias,
+                   size_t position) {
+  auto node = std::make_shared<PlanNode>();
+  node->kind = NodeKind::Alias;
+  node->alias = alias;
+  node->position = position;
+  node->key = alias;
+  node->cardinality =
+      static_cast<double>(ctx.stats.at(alias).unique_addresses);
+  node->input_size = node->cardinality;
+  return node;
+}
+
+NodePtr make_empty() {
+  auto node = std::make_shared<PlanNode>();
+  node->kind = NodeKind::Empty;
+  node->key = "{}";
+  return node;
+}
+
+NodePtr make_op(const Context &ctx, NodeKind kind, NodePtr left,
+                NodePtr right, size_t position) {
+  auto node = std::make_shared<PlanNode>();
+  node->kind = kind;
+  node->position = position;
+  std::string left_key = left->key;
+  std::string right_key = right->key;
+  if (kind != NodeKind::Subtract && ctx.commutative(kind) &&
+      right_key < left_key) {
+    std::swap(left_key, right_key);
+  }
+  node->key = "(" + left_key + " " + op_symbol(kind) + " " + right_key + ")";
+  switch (kind) {
+  case NodeKind::Union:
+    node->cardinality = left->cardinality + right->cardinality;
+    break;
+  case NodeKind::Intersection:
+    node->cardinality = std::min(left->cardinality, right->cardinality);
+    break;
+  case NodeKind::Subtract:
+  default:
+    node->cardinality = left->cardinality;
+    break;
+  }
+  // evaluate_expression() streams a subtree over all its inputs at once,
+  // whatever the operand order, unless an intersection or subtraction joins
+  // operands of very unequal size; those are composed from their operands.
+  const double merge = merge_cost(left->cardinality, right->cardinality);
+  node->input_size = left->input_size + right->input_size;
+  node->gallops =
+      (kind != NodeKind::Union &&
+       is_unequal(std::min(left->cardinality, right->cardinality),
+                  std::max(left->cardinality, right->cardinality))) ||
+      left->gallops || right->gallops;
+  auto &levels = node->level_cost;
+  const size_t fused = levels.size() - 1;
+  levels[fused] = node->gallops ? left->level_cost[fused] +
+                                      right->level_cost[fused] + merge
+                                : node->input_size;
+  for (size_t level = 0; level < fused; ++level) {
+    levels[level] =
+        left->level_cost[level + 1] + right->level_cost[level + 1] + merge;
+  }
+  node->cost = levels[0];
+  node->left = std::move(left);
+  node->right = std::move(right);
+  return node;
+}
+
+// Collects the operands of a chain of `kind` operators, e.g. A & B & C.
+void flatten(const NodePtr &node, NodeKind kind,
+             std::vector<NodePtr> &operands) {
+  if (node->kind == kind) {
+    flatten(node->left, kind, operands);
+    flatten(node->right, kind, operands);
+    return;
+  }
+  operands.push_back(node);
+}
+
+NodePtr simplify(const Context &ctx, const NodePtr &node);
+
+NodePtr combine(const Context &ctx, NodeKind kind, NodePtr left, NodePtr right,
+                size_t position) {
+  const bool left_empty = left->kind == NodeKind::Empty;
+  const bool right_empty = right->kind == NodeKind::Empty;
+  switch (kind) {
+  case NodeKind::Union:
+    if (left_empty) {
+      return right;
+    }
+    if (right_empty) {
+      return left;
+    }
+    break;
+  case NodeKind::Intersection:
+    if (left_empty || right_empty) {
+      return make_empty();
+    }
+    break;
+  case NodeKind::Subtract:
+    if (left_empty || left->key == right->key) {
+      return make_empty();
+    }
+    if (right_empty) {
+      return left;
+    }
+    break;
+  default:
+    break;
+  }
+
+  if (kind != NodeKind::Subtract) {
+    if (ctx.idempotent(kind) && left->key == right->key) {
+      return left;
+    }
+    if (ctx.commutative(kind)) {
+      // Both policies that commute here (Sum/Min/Max) are associative, so
+      // the chain can be rebuilt smallest operand first. Idempotent chains
+      // also drop repeated operands.
+      std::vector<NodePtr> operands;
+      flatten(left, kind, operands);
+      flatten(right, kind, operands);
+      std::stable_sort(operands.begin(), operands.end(),
+                       [](const NodePtr &a, const NodePtr &b) {
+                         return a->cardinality < b->cardinality;
+                       });
+      if (ctx.idempotent(kind)) {
+        std::vector<NodePtr> unique;
+        for (const auto &operand : operands) {
+          const bool seen = std::any_of(
+              unique.begin(), unique.end(),
+              [&](const NodePtr &u) { return u->key == operand->key; });
+          if (!seen) {
+            unique.push_back(operand);
+          }
+        }
+        operands = std::move(unique);
+      }
+      NodePtr chain = operands.front();
+      for (size_t i = 1; i < operands.size(); ++i) {
+        chain = make_op(ctx, kind, chain, operands[i], position);
+      }
+      return chain;
+    }
+    return make_op(ctx, kind, std::move(left), std::move(right), position);
+  }
+
+  // (X | Z) - Z == X - Z.
+  if (left->kind == NodeKind::Union &&
+      (left->left->key == right->key || left->right->key == right->key)) {
+    const auto &kept =
+        left->left->key == right->key ? left->right : left->left;
+    return combine(ctx, NodeKind::Subtract, kept, right, position);
+  }
+
+  // The remaining rewrites keep every hit count but are not always cheaper,
+  // so the estimated cheapest form wins.
+  NodePtr best = make_op(ctx, kind, left, right, position);
+  const auto consider = [&best](NodePtr candidate) {
+    if (candidate->cost < best->cost) {
+      best = std::move(candidate);
+    }
+  };
+  // Subtraction ignores the right operand's hits, so (X - Y) - Z removes
+  // Y | Z from X in a single pass over X.
+  if (left->kind == NodeKind::Subtract) {
+    auto removed = combine(ctx, NodeKind::Union, left->right, right, position);
+    consider(combine(ctx, NodeKind::Subtract, left->left, removed, position));
+  }
+  // (X | Y) - Z == (X - Z) | (Y - Z) and (X & Y) - Z == (X - Z) & Y.
+  if (left->kind == NodeKind::Union || left->kind == NodeKind::Intersection) {
+    auto pushed_left =
+        combine(ctx, NodeKind::Subtract, left->left, right, position);
+    auto pushed_right =
+        left->kind == NodeKind::Union
+            ? combine(ctx, NodeKind::Subtract, left->right, right, position)
+            : left->right;
+    consider(combine(ctx, left->kind, pushed_left, pushed_right,
+                     left->position));
+  }
+  return best;
+}
+
+NodePtr simplify(const Context &ctx, const NodePtr &node) {
+  if (node->kind == NodeKind::Alias || node->kind == NodeKind::Empty) {
+    return node;
+  }
+  return combine(ctx, node->kind, simplify(ctx, node->left),
+                 simplify(ctx, node->right), node->position);
+}
+
+std::optional<NodePtr> build_tree(const Context &ctx,
+                                  const ComposePlan &plan) {
+  std::vector<NodePtr> stack;
+  for (const auto &token : plan.rpn) {
+    NodeKind kind = NodeKind::Alias;
+    switch (token.type) {
+    case ExprTokenType::Identifier:
+      if (ctx.stats.find(token.text) == ctx.stats.end()) {
+        return std::nullopt;
+      }
+      stack.push_back(make_alias(ctx, token.text, token.position));
+      continue;
+    case ExprTokenType::UnionOp:
+      kind = NodeKind::Union;
+      break;
+    case ExprTokenType::IntersectOp:
+      kind = NodeKind::Intersection;
+      break;
+    case ExprTokenType::SubtractOp:
+      kind = NodeKind::Subtract;
+      break;
+    default:
+      return std::nullopt;
+    }
+    if (stack.size() < 2) {
+      return std::nullopt;
+    }
+    auto right = std::move(stack.back());
+    stack.pop_back();
+    auto left = std::move(stack.back());
+    stack.pop_back();
+    stack.push_back(make_op(ctx, kind, std::move(left), std::move(right),
+                            token.position));
+  }
+  if (stack.size() != 1) {
+    return std::nullopt;
+  }
+  return stack.front();
+}
+
+void emit_rpn(const NodePtr &node, std::vector<ExprToken> &rpn) {
+  ExprToken token;
+  token.position = node->position;
+  switch (node->kind) {
+  case NodeKind::Alias:
+    token.type = ExprTokenType::Identifier;
+    token.text = node->alias;
+    rpn.push_back(std::move(token));
+    return;
+  case NodeKind::Union:
+    token.type = ExprTokenType::UnionOp;
+    break;
+  case NodeKind::Intersection:
+    token.type = ExprTokenType::IntersectOp;
+    break;
+  case NodeKind::Subtract:
+  default:
+    token.type = ExprTokenType::SubtractOp;
+    break;
+  }
+  token.text = std::string(1, op_symbol(node->kind));
+  emit_rpn(node->left, rpn);
+  emit_rpn(node->right, rpn);
+  rpn.push_back(std::move(token));
+}
+
+std::string describe(const NodePtr &node, bool nested) {
+  switch (node->kind) {
+  case NodeKind::Alias:
+    return node->alias;
+  case NodeKind::Empty:
+    return "{}";
+  default:
+    break;
+  }
+  std::string text = describe(node->left, true) + " " +
+                     op_symbol(node->kind) + " " +
+                     describe(node->right, true);
+  return nested ? "(" + text + ")" : text;
+}
+
+} // namespace
+
+OptimizedPlan
+optimize_plan(const ComposePlan &plan,
+              const std::unordered_map<std::string, CoverageStats> &stats,
+              HitMergePolicy union_policy, HitMergePolicy intersect_policy) {
+  OptimizedPlan result;
+  result.plan = plan;
+
+  const Context ctx{stats, union_policy, intersect_policy};
+  auto tree = build_tree(ctx, plan);
+  if (!tree) {
+    return result;
+  }
+  result.original_cost = (*tree)->cost;
+
+  auto optimized = simplify(ctx, *tree);
+  if (optimized->cost > (*tree)->cost) {
+    optimized = *tree;
+  }
+  result.estimated_cost = optimized->cost;
+  result.description = describe(optimized, false);
+  if (optimized->kind == NodeKind::Empty) {
+    result.always_empty = true;
+    result.plan.rpn.clear();
+    return result;
+  }
+
+  result.plan.rpn.clear();
+  emit_rpn(optimized, result.plan.rpn);
+  return result;
+}
+
+} // namespace binja::covex::coverage
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "covex/coverage/coverage_dataset.hpp"
+#include "covex/coverage/coverage_expression.hpp"
+#include "covex/coverage/coverage_operations.hpp"
+
+namespace binja::covex::coverage {
+
+struct OptimizedPlan {
+  ComposePlan plan;
+  // Set when the expression simplifies to the empty set (e.g. A - A); the
+  // plan is then empty and need not be evaluated.
+  bool always_empty = false;
+  // Infix form of the optimized expression, for reports.
+  std::string description;
+  // Estimated element visits to evaluate the plan through ExpressionCache
+  // with an empty cache, as written and as optimized.
+  double original_cost = 0.0;
+  double estimated_cost = 0.0;
+};
+
+// Rewrites a parsed plan with set-algebra identities and reorders operands by
+// the cardinalities in `stats` (keyed by alias) so the cheapest equivalent
+// plan is evaluated. Rewrites that would change hit counts under the given
+// merge policies are skipped; subtraction always keeps the left operand's
+// hits, so it has no policy here. Plans that reference unknown aliases or are
+// malformed are returned unchanged so evaluation reports the error.
+OptimizedPlan
+optimize_plan(const ComposePlan &plan,
+              const std::unordered_map<std::string, CoverageStats> &stats,
+              HitMergePolicy union_policy = HitMergePolicy::Sum,
+              HitMergePolicy intersect_policy = HitMergePolicy::Min);
+
+} // namespace binja::covex::coverage
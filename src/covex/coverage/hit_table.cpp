@@ -0,0 +1,49 @@
+#include "covex/coverage/hit_table.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace binja::covex::coverage {
+
+namespace {
+
+constexpr size_t kMinSlots = 16;
+
+} // namespace
+
+void HitTable::reserve(size_t count) {
+  // Keep the load factor at or below 3/4 so probe runs stay short.
+  if (count * 4 <= slots_.size() * 3) {
+    return;
+  }
+  rehash(std::bit_ceil(std::max((count * 4 + 2) / 3, kMinSlots)));
+}
+
+void HitTable::clear() {
+  slots_.clear();
+  slots_.shrink_to_fit();
+  has_empty_key_ = false;
+  empty_key_slot_ = {kEmptyKey, 0};
+  size_ = 0;
+  shift_ = 64;
+}
+
+void HitTable::rehash(size_t slot_count) {
+  std::vector<value_type> old_slots(slot_count, value_type{kEmptyKey, 0});
+  old_slots.swap(slots_);
+  shift_ = 64 - static_cast<unsigned>(std::countr_zero(slot_count));
+
+  const size_t mask = slot_count - 1;
+  for (const auto &entry : old_slots) {
+    if (entry.first == kEmptyKey) {
+      continue;
+    }
+    size_t index = home_index(entry.first);
+    while (slots_[index].first != kEmptyKey) {
+      index = (index + 1) & mask;
+    }
+    slots_[index] = entry;
+  }
+}
+
+} // namespace binja::covex::coverage
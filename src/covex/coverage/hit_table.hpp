@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace binja::covex::coverage {
+
+// Address -> hit count table using open addressing with linear probing over
+// a flat, power-of-two sized slot array. Empty slots hold kEmptyKey; an entry
+// whose address really is kEmptyKey lives in a dedicated side slot, which
+// iteration visits last. Entries cannot be erased. Iteration order is
+// unspecified and any insertion may invalidate iterators.
+class HitTable {
+public:
+  using key_type = uint64_t;
+  using mapped_type = uint64_t;
+  using value_type = std::pair<uint64_t, uint64_t>;
+
+  static constexpr uint64_t kEmptyKey = ~uint64_t{0};
+
+  template <bool Const> class Iterator {
+  public:
+    using Table = std::conditional_t<Const, const HitTable, HitTable>;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = HitTable::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::conditional_t<Const, const value_type &,
+                                         value_type &>;
+    using pointer = std::conditional_t<Const, const value_type *,
+                                       value_type *>;
+
+    Iterator() = default;
+    Iterator(Table *table, size_t index) : table_(table), index_(index) {
+      skip_empty();
+    }
+    template <bool C = Const, typename = std::enable_if_t<C>>
+    Iterator(const Iterator<false> &other)
+        : table_(other.table_), index_(other.index_) {}
+
+    reference operator*() const { return table_->slot(index_); }
+    pointer operator->() const { return &table_->slot(index_); }
+    Iterator &operator++() {
+      ++index_;
+      skip_empty();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+    friend bool operator==(const Iterator &a, const Iterator &b) {
+      return a.index_ == b.index_;
+    }
+    friend bool operator!=(const Iterator &a, const Iterator &b) {
+      return a.index_ != b.index_;
+    }
+
+  private:
+    friend class HitTable;
+    template <bool> friend class Iterator;
+
+    void skip_empty() {
+      while (index_ < table_->end_index() && !table_->occupied(index_)) {
+        ++index_;
+      }
+    }
+
+    Table *table_ = nullptr;
+    size_t index_ = 0;
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  HitTable() = default;
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return slots_.size(); }
+  // Bytes held by the slot array.
+  size_t memory_bytes() const { return slots_.size() * sizeof(value_type); }
+
+  // Grows the slot array so `count` entries fit without rehashing.
+  void reserve(size_t count);
+  void clear();
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, end_index()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, end_index()); }
+
+  iterator find(uint64_t key) { return iterator(this, find_index(key)); }
+  const_iterator find(uint64_t key) const {
+    return const_iterator(this, find_index(key));
+  }
+  bool contains(uint64_t key) const { return find_index(key) != end_index(); }
+
+  std::pair<iterator, bool> emplace(uint64_t key, uint64_t value) {
+    auto [index, inserted] = insert_index(key);
+    if (inserted) {
+      slot(index).second = value;
+    }
+    return {iterator(this, index), inserted};
+  }
+  uint64_t &operator[](uint64_t key) {
+    return slot(insert_index(key).first).second;
+  }
+
+  // Adds every count in `other` to this table.
+  void merge(const HitTable &other) {
+    merge(other, [](uint64_t left, uint64_t right) { return left + right; });
+  }
+  // Inserts entries missing from this table and combines the counts of
+  // shared addresses with combine(this_count, other_count).
+  template <typename Combine>
+  void merge(const HitTable &other, Combine combine) {
+    reserve(size_ + other.size_);
+    for (const auto &[key, value] : other) {
+      auto [index, inserted] = insert_index(key);
+      auto &count = slot(index).second;
+      count = inserted ? value : combine(count, value);
+    }
+  }
+
+private:
+  size_t end_index() const { return slots_.size() + 1; }
+  bool occupied(size_t index) const {
+    return index < slots_.size() ? slots_[index].first != kEmptyKey
+                                 : has_empty_key_;
+  }
+  value_type &slot(size_t index) {
+    return index < slots_.size() ? slots_[index] : empty_key_slot_;
+  }
+  const value_type &slot(size_t index) const {
+    return index < slots_.size() ? slots_[index] : empty_key_slot_;
+  }
+
+  // Fibonacci hashing spreads the low-entropy low bits of nearby addresses
+  // across the table.
+  size_t home_index(uint64_t key) const {
+    return static_cast<size_t>((key * 0x9e3779b97f4a7c15ULL) >> shift_);
+  }
+
+  size_t find_index(uint64_t key) const {
+    if (key == kEmptyKey) {
+      return has_empty_key_ ? slots_.size() : end_index();
+    }
+    if (slots_.empty()) {
+      return end_index();
+    }
+    const size_t mask = slots_.size() - 1;
+    for (size_t index = home_index(key);; index = (index + 1) & mask) {
+      if (slots_[index].first == key) {
+        return index;
+      }
+      if (slots_[index].first == kEmptyKey) {
+        return end_index();
+      }
+    }
+  }
+
+  std::pair<size_t, bool> insert_index(uint64_t key) {
+    if (key == kEmptyKey) {
+      const bool inserted = !has_empty_key_;
+      if (inserted) {
+        has_empty_key_ = true;
+        empty_key_slot_ = {kEmptyKey, 0};
+        ++size_;
+      }
+      return {slots_.size(), inserted};
+    }
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+      reserve(size_ + 1);
+    }
+    const size_t mask = slots_.size() - 1;
+    for (size_t index = home_index(key);; index = (index + 1) & mask) {
+      if (slots_[index].first == key) {
+        return {index, false};
+      }
+      if (slots_[index].first == kEmptyKey) {
+        slots_[index] = {key, 0};
+        ++size_;
+        return {index, true};
+      }
+    }
+  }
+
+  void rehash(size_t slot_count);
+
+  std::vector<value_type> slots_;
+  value_type empty_key_slot_{kEmptyKey, 0};
+  bool has_empty_key_ = false;
+  size_t size_ = 0;
+  unsigned shift_ = 64;
+};
+
+} // namespace binja::covex::coverage
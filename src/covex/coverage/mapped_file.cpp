@@ -0,0 +1,127 @@
+#include "covex/coverage/mapped_file.hpp"
+
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace binja::covex::coverage {
+
+MappedFile::~MappedFile() { reset(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    reset();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+void MappedFile::reset() {
+  if (data_ && size_ != 0) {
+#if defined(_WIN32)
+    UnmapViewOfFile(data_);
+#else
+    munmap(const_cast<uint8_t *>(data_), size_);
+#endif
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#if defined(_WIN32)
+
+MappedFile MappedFile::open(const std::string &path) {
+  const std::wstring wide_path = std::filesystem::path(path).wstring();
+  HANDLE file = CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+
+  LARGE_INTEGER file_size{};
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    throw std::runtime_error("Failed to stat file: " + path);
+  }
+
+  MappedFile mapped;
+  if (file_size.QuadPart == 0) {
+    CloseHandle(file);
+    return mapped;
+  }
+
+  // The view keeps the mapping object alive, so both handles can be closed.
+  HANDLE mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping) {
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!view) {
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+
+  mapped.data_ = static_cast<const uint8_t *>(view);
+  mapped.size_ = static_cast<size_t>(file_size.QuadPart);
+  return mapped;
+}
+
+#else
+
+MappedFile MappedFile::open(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Failed to stat file: " + path);
+  }
+
+  MappedFile mapped;
+  if (info.st_size <= 0) {
+    ::close(fd);
+    return mapped;
+  }
+
+  const size_t size = static_cast<size_t>(info.st_size);
+  void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (view == MAP_FAILED) {
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+  madvise(view, size, MADV_SEQUENTIAL);
+
+  mapped.data_ = static_cast<const uint8_t *>(view);
+  mapped.size_ = size;
+  return mapped;
+}
+
+#endif
+
+} // namespace binja::covex::coverage
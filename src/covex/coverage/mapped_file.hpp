@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace binja::covex::coverage {
+
+// Read-only memory mapping of a whole file. Empty files map to an empty view.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  static MappedFile open(const std::string &path);
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  std::string_view view() const {
+    return {reinterpret_cast<const char *>(data_), size_};
+  }
+
+private:
+  void reset();
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+} // namespace binja::covex::coverage
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace binja::covex::coverage {
+
+// Worker count for `work_items` independent pieces of work, bounded by the
+// hardware thread count.
+inline size_t parallel_worker_count(size_t work_items) {
+  const size_t hardware =
+      std::max<size_t>(1, std::thread::hardware_concurrency());
+  return std::max<size_t>(1, std::min(hardware, work_items));
+}
+
+namespace detail {
+
+// Helper threads all parallel_for calls may have running at once. Calls made
+// from several pool tasks share it instead of each starting a full set.
+inline std::atomic<size_t> &parallel_helpers_available() {
+  static std::atomic<size_t> available(
+      std::max<size_t>(1, std::thread::hardware_concurrency()) - 1);
+  return available;
+}
+
+// Takes up to `wanted` helpers without waiting; may return 0.
+inline size_t acquire_parallel_helpers(size_t wanted) {
+  auto &available = parallel_helpers_available();
+  size_t current = available.load(std::memory_order_relaxed);
+  size_t taken = 0;
+  do {
+    taken = std::min(current, wanted);
+    if (taken == 0) {
+      return 0;
+    }
+  } while (!available.compare_exchange_weak(current, current - taken,
+                                            std::memory_order_relaxed));
+  return taken;
+}
+
+inline void release_parallel_helpers(size_t count) {
+  if (count != 0) {
+    parallel_helpers_available().fetch_add(count, std::memory_order_relaxed);
+  }
+}
+
+} // namespace detail
+
+// Calls fn(index) for every index in [0, count). The calling thread takes
+// indexes alongside as many helper threads as the process-wide limit
+// allows, so the call never waits for helpers and may run every index
+// itself. Once an invocation throws, indexes not yet started are skipped;
+// the first exception is rethrown after all helpers have joined.
+template <typename Fn> void parallel_for(size_t count, Fn &&fn) {
+  if (count == 0) {
+    return;
+  }
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  std::atomic<bool> failed = false;
+  std::atomic<size_t> next = 0;
+  auto drain = [&]() {
+    for (size_t index = next.fetch_add(1); index < count;
+         index = next.fetch_add(1)) {
+      if (failed.load(std::memory_order_relaxed)) {
+        return;
+      }
+      try {
+        fn(index);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  const size_t helpers = detail::acquire_parallel_helpers(count - 1);
+  std::vector<std::thread> workers;
+  workers.reserve(helpers);
+  try {
+    for (size_t i = 0; i < helpers; ++i) {
+      workers.emplace_back(drain);
+    }
+  } catch (const std::system_error &) {
+    // Out of threads: the ones started and the caller cover the rest.
+  }
+  drain();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  detail::release_parallel_helpers(helpers);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace binja::covex::coverage
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "covex/coverage/coverage_dataset.hpp"
+#include "covex/coverage/coverage_operations.hpp"
+
+namespace binja::covex::coverage {
+
+// Hit merge policies as function objects so the kernels below inline the
+// combine step instead of switching on HitMergePolicy per element.
+struct SumHits {
+  uint64_t operator()(uint64_t left, uint64_t right) const {
+    return left + right;
+  }
+};
+struct MinHits {
+  uint64_t operator()(uint64_t left, uint64_t right) const {
+    return std::min(left, right);
+  }
+};
+struct MaxHits {
+  uint64_t operator()(uint64_t left, uint64_t right) const {
+    return std::max(left, right);
+  }
+};
+struct LeftHits {
+  uint64_t operator()(uint64_t left, uint64_t) const { return left; }
+};
+
+// Calls fn with the function object for `policy`, resolving the policy once
+// outside any per-element loop.
+template <typename Fn>
+decltype(auto) with_merge_policy(HitMergePolicy policy, Fn &&fn) {
+  switch (policy) {
+  case HitMergePolicy::Sum:
+    return fn(SumHits{});
+  case HitMergePolicy::Min:
+    return fn(MinHits{});
+  case HitMergePolicy::Max:
+    return fn(MaxHits{});
+  case HitMergePolicy::Left:
+  default:
+    return fn(LeftHits{});
+  }
+}
+
+// Read-only view of sorted address/hit columns.
+struct SortedHits {
+  std::span<const uint64_t> addresses;
+  std::span<const uint64_t> hits;
+
+  explicit SortedHits(const CoverageDataset &dataset)
+      : addresses(dataset.addresses()), hits(dataset.hit_counts()) {}
+  size_t size() const { return addresses.size(); }
+};
+
+// Output columns; kernels append in strictly increasing address order.
+struct HitColumns {
+  std::vector<uint64_t> addresses;
+  std::vector<uint64_t> hits;
+
+  void reserve(size_t count) {
+    addresses.reserve(count);
+    hits.reserve(count);
+  }
+  void push(uint64_t address, uint64_t count) {
+    addresses.push_back(address);
+    hits.push_back(count);
+  }
+  void append(const SortedHits &input, size_t first, size_t last) {
+    addresses.insert(addresses.end(), input.addresses.begin() + first,
+                     input.addresses.begin() + last);
+    hits.insert(hits.end(), input.hits.begin() + first,
+                input.hits.begin() + last);
+  }
+};
+
+namespace detail {
+
+// One side must be this many times larger before the kernels switch from a
+// linear merge to galloping over the larger side.
+inline constexpr size_t kGallopRatio = 16;
+
+inline bool should_gallop(size_t small, size_t large) {
+  return small * kGallopRatio < large;
+}
+
+// First index >= `from` whose address is >= `key`, found by doubling the
+// step from `from` and then binary searching the last step.
+inline size_t gallop(std::span<const uint64_t> addresses, size_t from,
+                     uint64_t key) {
+  size_t step = 1;
+  size_t low = from;
+  size_t high = from;
+  while (high < addresses.size() && addresses[high] < key) {
+    low = high + 1;
+    high = from + step;
+    step *= 2;
+  }
+  high = std::min(high, addresses.size());
+  return static_cast<size_t>(
+      std::lower_bound(addresses.begin() + low, addresses.begin() + high,
+                       key) -
+      addresses.begin());
+}
+
+// Combines hits so the merge policy always sees (left operand, right operand)
+// even when the kernel walks the operands in swapped roles.
+template <bool SmallIsLeft, typename Merge>
+uint64_t combine(Merge merge, uint64_t small_hits, uint64_t large_hits) {
+  if constexpr (SmallIsLeft) {
+    return merge(small_hits, large_hits);
+  } else {
+    return merge(large_hits, small_hits);
+  }
+}
+
+template <bool SmallIsLeft, typename Merge>
+void union_gallop(const SortedHits &small, const SortedHits &large,
+                  Merge merge, HitColumns &out) {
+  size_t i = 0;
+  for (size_t j = 0; j < small.size(); ++j) {
+    const uint64_t key = small.addresses[j];
+    const size_t pos = gallop(large.addresses, i, key);
+    out.append(large, i, pos);
+    i = pos;
+    if (i < large.size() && large.addresses[i] == key) {
+      out.push(key,
+               combine<SmallIsLeft>(merge, small.hits[j], large.hits[i]));
+      ++i;
+    } else {
+      out.push(key, small.hits[j]);
+    }
+  }
+  out.append(large, i, large.size());
+}
+
+template <bool SmallIsLeft, typename Merge>
+void intersect_gallop(const SortedHits &small, const SortedHits &large,
+                      Merge merge, HitColumns &out) {
+  size_t i = 0;
+  for (size_t j = 0; j < small.size() && i < large.size(); ++j) {
+    const uint64_t key = small.addresses[j];
+    i = gallop(large.addresses, i, key);
+    if (i < large.size() && large.addresses[i] == key) {
+      out.push(key,
+               combine<SmallIsLeft>(merge, small.hits[j], large.hits[i]));
+      ++i;
+    }
+  }
+}
+
+} // namespace detail
+
+template <typename Merge>
+void union_kernel(const SortedHits &a, const SortedHits &b, Merge merge,
+                  HitColumns &out) {
+  out.reserve(a.size() + b.size());
+  if (detail::should_gallop(b.size(), a.size())) {
+    detail::union_gallop<false>(b, a, merge, out);
+    return;
+  }
+  if (detail::should_gallop(a.size(), b.size())) {
+    detail::union_gallop<true>(a, b, merge, out);
+    return;
+  }
+
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size() && j < b.size()) {
+    const uint64_t addr_a = a.addresses[i];
+    const uint64_t addr_b = b.addresses[j];
+    if (addr_a < addr_b) {
+      out.push(addr_a, a.hits[i++]);
+    } else if (addr_b < addr_a) {
+      out.push(addr_b, b.hits[j++]);
+    } else {
+      out.push(addr_a, merge(a.hits[i++], b.hits[j++]));
+    }
+  }
+  out.append(a, i, a.size());
+  out.append(b, j, b.size());
+}
+
+template <typename Merge>
+void intersect_kernel(const SortedHits &a, const SortedHits &b, Merge merge,
+                      HitColumns &out) {
+  out.reserve(std::min(a.size(), b.size()));
+  if (detail::should_gallop(b.size(), a.size())) {
+    detail::intersect_gallop<false>(b, a, merge, out);
+    return;
+  }
+  if (detail::should_gallop(a.size(), b.size())) {
+    detail::intersect_gallop<true>(a, b, merge, out);
+    return;
+  }
+
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size() && j < b.size()) {
+    const uint64_t addr_a = a.addresses[i];
+    const uint64_t addr_b = b.addresses[j];
+    if (addr_a < addr_b) {
+      ++i;
+    } else if (addr_b < addr_a) {
+      ++j;
+    } else {
+      out.push(addr_a, merge(a.hits[i++], b.hits[j++]));
+    }
+  }
+}
+
+// a - b keeps a's hit counts, so no merge policy applies.
+inline void subtract_kernel(const SortedHits &a, const SortedHits &b,
+                            HitColumns &out) {
+  out.reserve(a.size());
+  size_t i = 0;
+  size_t j = 0;
+  if (detail::should_gallop(b.size(), a.size())) {
+    // Few removals: copy the runs of `a` between them wholesale.
+    for (; j < b.size() && i < a.size(); ++j) {
+      const size_t pos = detail::gallop(a.addresses, i, b.addresses[j]);
+      out.append(a, i, pos);
+      i = pos;
+      if (i < a.size() && a.addresses[i] == b.addresses[j]) {
+        ++i;
+      }
+    }
+    out.append(a, i, a.size());
+    return;
+  }
+  if (detail::should_gallop(a.size(), b.size())) {
+    for (; i < a.size(); ++i) {
+      j = detail::gallop(b.addresses, j, a.addresses[i]);
+      if (j == b.size() || b.addresses[j] != a.addresses[i]) {
+        out.push(a.addresses[i], a.hits[i]);
+      }
+    }
+    return;
+  }
+
+  while (i < a.size() && j < b.size()) {
+    const uint64_t addr_a = a.addresses[i];
+    const uint64_t addr_b = b.addresses[j];
+    if (addr_a < addr_b) {
+      out.push(addr_a, a.hits[i++]);
+    } else if (addr_b < addr_a) {
+      ++j;
+    } else {
+      ++i;
+      ++j;
+    }
+  }
+  out.append(a, i, a.size());
+}
+
+} // namespace binja::covex::coverage
@@ -1,12 +1,17 @@
 #include "covex/ui/controllers/workspace_controller.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
+#include <filesystem>
 #include <sstream>
-#include <thread>
+#include <utility>
 
 #include "binaryninjaapi.h"
 #include "covex/core/coverage_discovery.hpp"
+#include "covex/core/index_cache.hpp"
 #include "covex/core/logging.hpp"
+#include "covex/ui/painting/coverage_render_layer.hpp"
 
 namespace binja::covex::ui {
 
@@ -23,6 +28,17 @@ BNBinaryView *view_key(BinaryNinja::BinaryView *view) {
   return view->GetObject();
 }
 
+// Main-thread time spent painting before yielding back to the event loop.
+constexpr std::chrono::milliseconds kPaintSliceBudget{12};
+
+// Cancels the work started under `token` and gives it a fresh token for the
+// work that replaces it.
+coverage::CancellationToken supersede(coverage::CancellationToken &token) {
+  token.cancel();
+  token = coverage::CancellationToken::create();
+  return token;
+}
+
 std::string make_alias(size_t index) {
   std::string alias;
   size_t n = index;
@@ -52,6 +68,44 @@ load_discovery_settings(const BinaryViewRef &view) {
   return settings;
 }
 
+bool load_share_across_views(const BinaryViewRef &view) {
+  auto bn_settings = BinaryNinja::Settings::Instance();
+  return bn_settings->Get<bool>("covex.mapping.shareAcrossViews", view);
+}
+
+bool load_block_native_mapping(const BinaryViewRef &view) {
+  auto bn_settings = BinaryNinja::Settings::Instance();
+  return bn_settings->Get<bool>("covex.mapping.blockNative", view);
+}
+
+bool load_index_cache_enabled(const BinaryViewRef &view) {
+  auto bn_settings = BinaryNinja::Settings::Instance();
+  return bn_settings->Get<bool>("covex.mapping.indexCache", view);
+}
+
+uint64_t load_index_cache_budget(const BinaryViewRef &view) {
+  auto bn_settings = BinaryNinja::Settings::Instance();
+  return bn_settings->Get<uint64_t>("covex.mapping.indexCacheBudgetMB", view) *
+         1024 * 1024;
+}
+
+bool load_use_render_layer(const BinaryViewRef &view) {
+  auto bn_settings = BinaryNinja::Settings::Instance();
+  return bn_settings->Get<bool>("covex.rendering.useRenderLayer", view);
+}
+
+bool load_lazy_painting(const BinaryViewRef &view) {
+  auto bn_settings = BinaryNinja::Settings::Instance();
+  return bn_settings->Get<bool>("covex.rendering.lazyPainting", view);
+}
+
+size_t load_compose_cache_budget(const BinaryViewRef &view) {
+  auto bn_settings = BinaryNinja::Settings::Instance();
+  const auto megabytes =
+      bn_settings->Get<uint64_t>("covex.compose.cacheBudgetMB", view);
+  return static_cast<size_t>(megabytes) * 1024 * 1024;
+}
+
 std::string format_discovery_report(const core::DiscoveryReport &report) {
   std::ostringstream out;
   out << "Function discovery candidates=" << report.candidates
@@ -83,7 +137,18 @@ CoverageWorkspaceController::CoverageWorkspaceController(
   parser_registry_.register_parser(std::make_unique<coverage::DrcovParser>());
   parser_registry_.register_parser(
       std::make_unique<coverage::AddrTraceParser>());
+  oracle_ = std::make_shared<core::BinaryViewOracle>(view_);
+  // Fixed for the controller's lifetime so all traces share one keying.
+  block_native_ = load_block_native_mapping(view_);
+  if (load_index_cache_enabled(view_)) {
+    index_cache_ = std::make_shared<core::IndexCache>(
+        std::filesystem::path(BinaryNinja::GetUserDirectory()) / "covex" /
+        "index-cache");
+  }
+  scheduler_ = &core::TaskScheduler::shared();
   painter_ = std::make_unique<CoveragePainter>(view_);
+  painter_->set_lazy(load_lazy_painting(view_));
+  render_layer_ = load_use_render_layer(view_);
   logger_ = log::logger(view_, log::kLogger);
 }
 
@@ -92,6 +157,14 @@ CoverageWorkspaceController::~CoverageWorkspaceController() {
     state_->alive = false;
     state_->controller = nullptr;
   }
+  lifetime_cancel_.cancel();
+  compose_cancel_.cancel();
+  filter_cancel_.cancel();
+  paint_cancel_.cancel();
+  finish_paint_task();
+  if (auto *layer = CoverageRenderLayer::instance()) {
+    layer->withdraw(view_.GetPtr());
+  }
   unregister_controller(view_.GetPtr());
 }
 
@@ -157,20 +230,134 @@ bool CoverageWorkspaceController::load_trace_file(const std::string &path) {
 
   BinaryNinja::Ref<BinaryNinja::BackgroundTask> task =
       new BinaryNinja::BackgroundTask("CovEx: Loading coverage...", false);
-  auto view = view_;
   auto logger = logger_;
   auto *parser_registry = &parser_registry_;
   auto *mapper = &mapper_;
+  auto oracle = oracle_;
+  const bool block_native = block_native_;
   auto state = state_;
 
-  std::thread([state, task, view, logger, parser_registry, mapper, path]() {
+  // Other open views whose modules may also appear in the trace; they are
+  // mapped in the same pass. Block-native workspaces key their datasets
+  // differently and are left out.
+  std::vector<SharedTarget> shared;
+  if (!block_native && load_share_across_views(view_)) {
+    for (const auto &[key, controller] : registry_) {
+      (void)key;
+      if (controller && controller != this && !controller->block_native_) {
+        shared.push_back({controller->state_, controller->oracle_});
+      }
+    }
+    // The registry is unordered; a fixed order keeps the pass's index cache
+    // keys stable between loads.
+    std::sort(shared.begin(), shared.end(),
+              [](const SharedTarget &a, const SharedTarget &b) {
+                return std::pair(a.oracle->original_filename(),
+                                 a.oracle->image_base()) <
+                       std::pair(b.oracle->original_filename(),
+                                 b.oracle->image_base());
+              });
+  }
+  auto index_cache = index_cache_;
+  const uint64_t cache_budget = load_index_cache_budget(view_);
+  auto cancel = lifetime_cancel_;
+
+  auto work = [state, task, logger, parser_registry, mapper, oracle,
+               block_native, shared = std::move(shared), index_cache,
+               cache_budget, path, cancel]() {
+    if (cancel.cancelled()) {
+      task->Finish();
+      return;
+    }
     if (logger) {
       logger->LogInfoF("Loading coverage file: {}", path);
     }
+
+    // One entry per view mapped in the pass: the loaded view first, then
+    // the shared targets in order. Parsing is skipped only when all hit.
+    std::vector<core::IndexCacheKey> cache_keys;
+    if (index_cache) {
+      try {
+        task->SetProgressText("CovEx: Checking index cache...");
+        const uint64_t trace_hash = core::IndexCache::hash_file(path);
+        cache_keys.push_back({trace_hash, oracle->content_hash(),
+                              oracle->image_base(), block_native});
+        for (const auto &target : shared) {
+          cache_keys.push_back({trace_hash, target.oracle->content_hash(),
+                                target.oracle->image_base(), block_native});
+        }
+        core::IndexCache::link_peers(cache_keys);
+        std::vector<core::CachedIndex> entries;
+        for (const auto &key : cache_keys) {
+          auto cached = index_cache->load(key);
+          if (!cached) {
+            break;
+          }
+          entries.push_back(std::move(*cached));
+        }
+        if (entries.size() == cache_keys.size()) {
+          std::vector<TraceRecord> records;
+          for (size_t i = 0; i < entries.size(); ++i) {
+            TraceRecord record;
+            record.trace = std::move(entries[i].trace);
+            record.trace.source_path = path;
+            record.trace.name =
+                std::filesystem::path(path).filename().string();
+            record.index = std::move(entries[i].index);
+            // Blocks follow the view's current analysis, not the one the
+            // entry was stored under.
+            const auto &view_oracle = i == 0 ? *oracle : *shared[i - 1].oracle;
+            mapper->derive_blocks(record.index, view_oracle, cancel);
+            record.stats = record.index.dataset.stats();
+            records.push_back(std::move(record));
+          }
+          if (logger) {
+            logger->LogInfoF("Loaded mapped coverage from index cache: "
+                             "unique={} total={}",
+                             records.front().stats.unique_addresses,
+                             records.front().stats.total_hits);
+          }
+          task->Finish();
+          for (size_t i = 1; i < records.size(); ++i) {
+            if (records[i].index.diagnostics.spans_mapped == 0) {
+              continue;
+            }
+            dispatch_ui(shared[i - 1].state,
+                        [record = std::move(records[i])](
+                            CoverageWorkspaceController &controller) mutable {
+                          controller.add_trace_result(std::move(record));
+                        });
+          }
+          dispatch_ui(state,
+                      [record = std::move(records.front())](
+                          CoverageWorkspaceController &controller) mutable {
+                        controller.add_trace_result(std::move(record));
+                      });
+          return;
+        }
+      } catch (const coverage::OperationCancelled &) {
+        task->Finish();
+        return;
+      } catch (const std::exception &err) {
+        // A malformed entry is replaced below; without every key there is
+        // nothing to store under.
+        if (cache_keys.size() != shared.size() + 1) {
+          cache_keys.clear();
+        }
+        if (logger) {
+          logger->LogWarnF("Ignoring index cache for {}: {}", path,
+                           err.what());
+        }
+      }
+    }
+
     std::optional<coverage::CoverageTrace> parsed;
     try {
       task->SetProgressText("CovEx: Parsing coverage...");
-      parsed = parser_registry->parse_first_match(path);
+      parsed = parser_registry->parse_first_match(path, cancel);
+    } catch (const coverage::OperationCancelled &) {
+      task->Finish();
+      return;
     } catch (const std::exception &err) {
       if (logger) {
         logger->LogErrorForExceptionF(err, "Failed to parse coverage file: {}",
@@ -199,7 +386,53 @@ bool CoverageWorkspaceController::load_trace_file(const std::string &path) {
     }
 
     task->SetProgressText("CovEx: Mapping coverage...");
-    auto index = mapper->map_trace(trace, view);
+    std::vector<TraceRecord> shared_records;
+    core::CoverageIndex index;
+    try {
+      if (block_native) {
+        index = mapper->map_trace_blocks(trace, *oracle, cancel);
+      } else if (shared.empty()) {
+        index = mapper->map_trace(trace, *oracle, 0, cancel);
+      } else {
+        std::vector<const core::ViewOracle *> views{oracle.get()};
+        for (const auto &target : shared) {
+          views.push_back(target.oracle.get());
+        }
+        auto indexes = mapper->map_trace_targets(trace, views, 0, cancel);
+        index = std::move(indexes.front());
+        // Other views only keep the trace's metadata; the spans stay with
+        // the view it was loaded for.
+        coverage::CoverageTrace metadata = trace;
+        metadata.spans.clear();
+        metadata.spans.shrink_to_fit();
+        for (size_t i = 1; i < indexes.size(); ++i) {
+          TraceRecord shared_record;
+          if (indexes[i].diagnostics.spans_mapped != 0) {
+            shared_record.trace = metadata;
+            shared_record.index = std::move(indexes[i]);
+            shared_record.stats = shared_record.index.dataset.stats();
+          }
+          shared_records.push_back(std::move(shared_record));
+        }
+      }
+    } catch (const coverage::OperationCancelled &) {
+      task->Finish();
+      return;
+    }
+
+    if (index_cache && !cache_keys.empty()) {
+      try {
+        index_cache->store(cache_keys.front(), trace, index);
+        for (size_t i = 1; i < cache_keys.size(); ++i) {
+          index_cache->store(cache_keys[i], trace, shared_records[i - 1].index);
+        }
+        index_cache->prune(cache_budget);
+      } catch (const std::exception &err) {
+        if (logger) {
+          logger->LogWarnF("Failed to update index cache: {}", err.what());
+        }
+      }
+    }
 
     TraceRecord record;
     record.id = 0;
@@ -230,18 +463,67 @@ bool CoverageWorkspaceController::load_trace_file(const std::string &path) {
       }
       logger->LogInfoF("Mapped spans: total={} mapped={} skipped={} invalid={}",
                        diag.spans_total, diag.spans_mapped, diag.spans_skipped,
-                       record.index.invalid_addresses.size());
+                       record.index.invalid.count());
+      if (!record.index.invalid.empty()) {
+        auto ranges = record.index.invalid.ranges();
+        std::sort(ranges.begin(), ranges.end(),
+                  [](const core::InvalidRange &a, const core::InvalidRange &b) {
+                    return a.count > b.count;
+                  });
+        ranges.resize(std::min<size_t>(ranges.size(), 4));
+        for (const auto &range : ranges) {
+          logger->LogInfoF("Invalid range: [{:#x}, {:#x}) hits={}", range.lo,
+                           range.hi, range.count);
+        }
+        // Invalid addresses concentrated in one module usually mean it was
+        // matched with the wrong base or is a different build.
+        const auto &counts = record.index.invalid.module_counts();
+        std::vector<std::pair<uint32_t, uint64_t>> modules(counts.begin(),
+                                                           counts.end());
+        std::sort(modules.begin(), modules.end(),
+                  [](const auto &a, const auto &b) {
+                    return a.second != b.second ? a.second > b.second
+                                                : a.first < b.first;
+                  });
+        modules.resize(std::min<size_t>(modules.size(), 4));
+        for (const auto &[module_id, count] : modules) {
+          const auto module = record.trace.modules.find(module_id);
+          logger->LogInfoF("Invalid addresses in module id={}: hits={} path={}",
+                           module_id, count,
+                           module != record.trace.modules.end()
+                               ? module->second.path
+                               : std::string("unknown"));
+        }
+      }
       logger->LogInfoF("Mapped addresses: unique={} total={}",
                        record.stats.unique_addresses, record.stats.total_hits);
     }
 
     task->Finish();
 
+    size_t shared_views = 0;
+    for (size_t i = 0; i < shared_records.size(); ++i) {
+      if (shared_records[i].index.diagnostics.spans_mapped == 0) {
+        continue;
+      }
+      ++shared_views;
+      dispatch_ui(shared[i].state,
+                  [record = std::move(shared_records[i])](
+                      CoverageWorkspaceController &controller) mutable {
+                    controller.add_trace_result(std::move(record));
+                  });
+    }
+    if (logger && shared_views != 0) {
+      logger->LogInfoF("Shared coverage with {} other open view(s)",
+                       shared_views);
+    }
+
     dispatch_ui(state, [record = std::move(record)](
                            CoverageWorkspaceController &controller) mutable {
       controller.add_trace_result(std::move(record));
     });
-  }).detach();
+  };
+  scheduler_->submit(core::TaskLane::Bulk, std::move(work));
 
   return true;
 }
@@ -249,6 +531,7 @@ bool CoverageWorkspaceController::load_trace_file(const std::string &path) {
 void CoverageWorkspaceController::add_trace_result(TraceRecord record) {
   record.id = next_trace_id_++;
   record.alias = next_alias();
+  expression_cache_->invalidate_alias(record.alias);
   traces_.push_back(std::move(record));
   update_trace_view();
   set_expression(expression_);
@@ -264,7 +547,7 @@ void CoverageWorkspaceController::update_trace_view() {
     TraceSummary summary;
     summary.alias = trace.alias;
     summary.name = trace.trace.name;
-    summary.spans = trace.trace.spans.size();
+    summary.spans = trace.index.diagnostics.spans_total;
     summary.unique_addresses = trace.stats.unique_addresses;
     summary.total_hits = trace.stats.total_hits;
     summary.has_hitcounts = trace.trace.has_hitcounts;
@@ -285,19 +568,18 @@ void CoverageWorkspaceController::set_expression(
   }
 
   const auto generation = compose_generation_.fetch_add(1) + 1;
+  supersede(compose_cancel_);
 
   if (expression.empty()) {
     view_ui_->clear_expression_error();
     if (traces_.empty()) {
-      active_index_.reset();
-      if (painter_) {
-        painter_->clear();
-      }
+      set_active_index(std::nullopt);
+      clear_rendered_coverage();
       update_blocks_view({});
       return;
     }
     if (!traces_.empty()) {
-      active_index_ = traces_.front().index;
+      set_active_index(traces_.front().index);
       apply_active_highlights();
       update_blocks_view(active_index_->blocks);
     }
@@ -316,31 +598,67 @@ void CoverageWorkspaceController::set_expression(
 
   view_ui_->clear_expression_error();
   auto plan = std::get<coverage::ComposePlan>(std::move(parsed));
+  expression_cache_->set_budget(load_compose_cache_budget(view_));
 
   std::unordered_map<std::string, coverage::CoverageDataset> datasets;
+  std::unordered_map<std::string, coverage::CoverageStats> stats;
+  std::vector<core::BlockSpan> extents;
   datasets.reserve(traces_.size());
+  stats.reserve(traces_.size());
   for (const auto &trace : traces_) {
     datasets.emplace(trace.alias, trace.index.dataset);
+    stats.emplace(trace.alias, trace.stats);
+    if (trace.index.block_native) {
+      extents.insert(extents.end(), trace.index.block_spans.begin(),
+                     trace.index.block_spans.end());
+    }
+  }
+
+  auto optimized = coverage::optimize_plan(plan, stats);
+  if (logger_ && !optimized.description.empty()) {
+    logger_->LogInfoF("Composition plan: {} (estimated cost {:.0f}, {:.0f} "
+                      "as written)",
+                      optimized.description, optimized.estimated_cost,
+                      optimized.original_cost);
   }
 
-  compose_expression_async(generation, std::move(plan), std::move(datasets));
+  compose_expression_async(generation, std::move(optimized),
+                           std::move(datasets), std::move(extents));
 }
 
 void CoverageWorkspaceController::compose_expression_async(
-    uint64_t generation, coverage::ComposePlan plan,
-    std::unordered_map<std::string, coverage::CoverageDataset> datasets) {
+    uint64_t generation, coverage::OptimizedPlan plan,
+    std::unordered_map<std::string, coverage::CoverageDataset> datasets,
+    std::vector<core::BlockSpan> extents) {
   BinaryNinja::Ref<BinaryNinja::BackgroundTask> task =
       new BinaryNinja::BackgroundTask("CovEx: Composing coverage...", false);
   auto logger = logger_;
-  auto view = view_;
   auto *mapper = &mapper_;
+  auto oracle = oracle_;
+  auto cache = expression_cache_;
+  const bool block_native = block_native_;
   auto state = state_;
-
-  std::thread([state, generation, plan = std::move(plan),
-               datasets = std::move(datasets), task, logger, view,
-               mapper]() mutable {
+  auto cancel = compose_cancel_;
+
+  auto work = [state, generation, plan = std::move(plan),
+               datasets = std::move(datasets), extents = std::move(extents),
+               task, logger, mapper, oracle, cache, block_native,
+               cancel]() mutable {
+    // A superseded composition stops at its next cancellation check.
+    if (cancel.cancelled()) {
+      task->Finish();
+      return;
+    }
     task->SetProgressText("CovEx: Evaluating composition...");
-    auto composed = coverage::evaluate_expression(plan, datasets);
+    std::variant<coverage::CoverageDataset, coverage::ComposeError> composed;
+    try {
+      if (!plan.always_empty) {
+        composed = cache->evaluate(plan.plan, datasets, cancel);
+      }
+    } catch (const coverage::OperationCancelled &) {
+      task->Finish();
+      return;
+    }
     if (std::holds_alternative<coverage::ComposeError>(composed)) {
       const auto &err = std::get<coverage::ComposeError>(composed);
       if (logger) {
@@ -362,9 +680,19 @@ void CoverageWorkspaceController::compose_expression_async(
 
     task->SetProgressText("CovEx: Mapping composition...");
     auto dataset = std::get<coverage::CoverageDataset>(std::move(composed));
-    auto index = mapper->map_dataset(dataset, view);
     CompositionResult composed_result;
-    composed_result.index = std::move(index);
+    try {
+      composed_result.index =
+          block_native
+              ? mapper->map_block_dataset(
+                    dataset,
+                    core::CoverageMapper::merge_block_spans(std::move(extents)),
+                    *oracle, cancel)
+              : mapper->map_dataset(dataset, *oracle, cancel);
+    } catch (const coverage::OperationCancelled &) {
+      task->Finish();
+      return;
+    }
 
     task->Finish();
 
@@ -377,17 +705,19 @@ void CoverageWorkspaceController::compose_expression_async(
           if (controller.view_ui_) {
             controller.view_ui_->clear_expression_error();
           }
-          controller.active_index_ = std::move(composed_result.index);
+          controller.set_active_index(std::move(composed_result.index));
           controller.apply_active_highlights();
           controller.update_blocks_view(controller.active_index_->blocks);
         });
-  }).detach();
+  };
+  scheduler_->submit(core::TaskLane::Interactive, std::move(work));
 }
 
 void CoverageWorkspaceController::set_block_filter(
     const std::string &filter_text) {
   block_filter_ = filter_text;
   const auto generation = filter_generation_.fetch_add(1) + 1;
+  supersede(filter_cancel_);
   if (!active_index_ || active_index_->blocks.empty()) {
     update_blocks_view({});
     return;
@@ -420,6 +750,12 @@ void CoverageWorkspaceController::set_block_filter(
   filter_blocks_async(generation, std::move(filter), std::move(summaries));
 }
 
+void CoverageWorkspaceController::notify_navigation(uint64_t offset) {
+  if (painter_ && painter_->lazy()) {
+    painter_->focus(offset);
+  }
+}
+
 void CoverageWorkspaceController::set_highlight_mode(HighlightMode mode) {
   highlight_mode_ = mode;
   apply_active_highlights();
@@ -456,21 +792,36 @@ bool CoverageWorkspaceController::request_define_functions_from_coverage() {
   auto view = view_;
   auto logger = logger_;
   auto *mapper = &mapper_;
+  auto oracle = oracle_;
   auto state = state_;
+  auto cancel = lifetime_cancel_;
 
   BinaryNinja::Ref<BinaryNinja::BackgroundTask> task =
       new BinaryNinja::BackgroundTask("CovEx: Discovery 1/3 Plan", false);
 
-  std::thread([state, task, view, logger, mapper, settings,
+  auto work = [state, task, view, logger, mapper, oracle, settings, cancel,
                index = std::move(index)]() mutable {
+    if (cancel.cancelled()) {
+      task->Finish();
+      return;
+    }
     task->SetProgressText("CovEx: Discovery 1/3 Plan");
-    auto plan = core::BuildDiscoveryPlan(index, view, settings);
+    auto plan = core::BuildDiscoveryPlan(index, *oracle, settings);
 
     task->SetProgressText("CovEx: Discovery 2/3 Define");
     auto report = core::ExecuteDiscoveryPlan(plan, view, settings);
 
     task->SetProgressText("CovEx: Discovery 3/3 Remap");
-    auto remapped = mapper->map_dataset(index.dataset, view);
+    core::CoverageIndex remapped;
+    try {
+      remapped = index.block_native
+                     ? mapper->map_block_dataset(
+                           index.dataset, index.block_spans, *oracle, cancel)
+                     : mapper->map_dataset(index.dataset, *oracle, cancel);
+    } catch (const coverage::OperationCancelled &) {
+      task->Finish();
+      return;
+    }
 
     task->Finish();
     std::string message = format_discovery_report(report);
@@ -478,14 +829,15 @@ bool CoverageWorkspaceController::request_define_functions_from_coverage() {
     dispatch_ui(
         state, [remapped = std::move(remapped), message = std::move(message)](
                    CoverageWorkspaceController &controller) mutable {
-          controller.active_index_ = std::move(remapped);
+          controller.set_active_index(std::move(remapped));
           controller.apply_active_highlights();
           controller.update_blocks_view(controller.active_index_->blocks);
           if (controller.logger_) {
             controller.logger_->LogInfoF("{}", message);
           }
         });
-  }).detach();
+  };
+  scheduler_->submit(core::TaskLane::Bulk, std::move(work));
 
   return true;
 }
@@ -496,20 +848,28 @@ void CoverageWorkspaceController::filter_blocks_async(
   BinaryNinja::Ref<BinaryNinja::BackgroundTask> task =
       new BinaryNinja::BackgroundTask("CovEx: Filtering blocks...", false);
   auto state = state_;
+  auto cancel = filter_cancel_;
 
-  std::thread([state, generation, filter = std::move(filter),
-               blocks = std::move(blocks), task]() mutable {
+  auto work = [state, generation, filter = std::move(filter),
+               blocks = std::move(blocks), task, cancel]() mutable {
     std::vector<BlockSummary> filtered;
     filtered.reserve(blocks.size());
-    for (const auto &block : blocks) {
-      core::BlockFilterContext ctx;
-      ctx.address = block.address;
-      ctx.size = block.size;
-      ctx.hits = block.hits;
-      ctx.function = block.function;
-      if (filter.matches(ctx)) {
-        filtered.push_back(block);
+    try {
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        cancel.poll(i);
+        const auto &block = blocks[i];
+        core::BlockFilterContext ctx;
+        ctx.address = block.address;
+        ctx.size = block.size;
+        ctx.hits = block.hits;
+        ctx.function = block.function;
+        if (filter.matches(ctx)) {
+          filtered.push_back(block);
+        }
       }
+    } catch (const coverage::OperationCancelled &) {
+      task->Finish();
+      return;
     }
     task->Finish();
 
@@ -523,7 +883,8 @@ void CoverageWorkspaceController::filter_blocks_async(
       }
       controller.view_ui_->set_blocks(filtered);
     });
-  }).detach();
+  };
+  scheduler_->submit(core::TaskLane::Interactive, std::move(work));
 }
 
 void CoverageWorkspaceController::update_blocks_view(
@@ -544,22 +905,153 @@ void CoverageWorkspaceController::update_blocks_view(
   view_ui_->set_blocks(summaries);
 }
 
+void CoverageWorkspaceController::set_active_index(
+    std::optional<core::CoverageIndex> index) {
+  active_index_ = std::move(index);
+  expanded_active_.reset();
+}
+
 void CoverageWorkspaceController::apply_active_highlights() {
-  if (!painter_ || !active_index_) {
+  if (!active_index_) {
     return;
   }
-  if (highlight_mode_ == HighlightMode::Heatmap) {
-    painter_->apply_heatmap(active_index_->dataset, highlight_granularity_,
-                            heatmap_settings_);
+  // Blocks are painted from the covered blocks in either mapping mode.
+  // Block-native datasets are keyed by trace block start, so instruction
+  // highlights need them expanded once.
+  const coverage::CoverageDataset *dataset = &active_index_->dataset;
+  if (active_index_->block_native &&
+      highlight_granularity_ == HighlightGranularity::Instruction) {
+    if (!expanded_active_) {
+      expanded_active_ = mapper_.expand_instructions(*active_index_, *oracle_);
+    }
+    dataset = &*expanded_active_;
+  }
+  auto *layer = render_layer_ ? CoverageRenderLayer::instance() : nullptr;
+  if (layer) {
+    layer->publish(view_.GetPtr(),
+                   CoverageRenderState::build(
+                       *dataset, active_index_->blocks, highlight_granularity_,
+                       highlight_mode_ == HighlightMode::Heatmap,
+                       heatmap_settings_));
+    if (view_ui_) {
+      view_ui_->refresh_rendering();
+    }
+    return;
+  }
+  if (!painter_) {
+    return;
+  }
+  if (highlight_granularity_ == HighlightGranularity::BasicBlock) {
+    plan_paint_async({}, active_index_->blocks);
   } else {
-    painter_->apply_plain(active_index_->dataset, highlight_granularity_);
+    plan_paint_async(*dataset, {});
   }
 }
 
-void CoverageWorkspaceController::clear_highlights() {
+void CoverageWorkspaceController::plan_paint_async(
+    coverage::CoverageDataset dataset,
+    std::vector<core::CoveredBlock> blocks) {
+  // Pre-empt the previous paint; what it already painted is diffed against
+  // by the next one.
+  const auto generation = paint_generation_.fetch_add(1) + 1;
+  auto cancel = supersede(paint_cancel_);
+  painter_->cancel_apply();
+  finish_paint_task();
+
+  auto view = view_;
+  auto state = state_;
+  const auto granularity = highlight_granularity_;
+  const bool heatmap = highlight_mode_ == HighlightMode::Heatmap;
+  const auto settings = heatmap_settings_;
+
+  // Planning walks every covered address and scales the heatmap, so it runs
+  // off the main thread; only the highlight calls are left for the UI.
+  auto work = [state, generation, view, dataset = std::move(dataset),
+               blocks = std::move(blocks), granularity, heatmap, settings,
+               cancel]() {
+    PaintPlan plan;
+    try {
+      plan = heatmap ? CoveragePainter::plan_heatmap(view, dataset, blocks,
+                                                     granularity, settings,
+                                                     cancel)
+                     : CoveragePainter::plan_plain(view, dataset, blocks,
+                                                   granularity, cancel);
+    } catch (const coverage::OperationCancelled &) {
+      return;
+    }
+    dispatch_ui(state, [generation, plan = std::move(plan)](
+                           CoverageWorkspaceController &controller) mutable {
+      if (generation != controller.paint_generation_.load()) {
+        return;
+      }
+      controller.start_paint(generation, std::move(plan));
+    });
+  };
+  scheduler_->submit(core::TaskLane::Interactive, std::move(work));
+}
+
+void CoverageWorkspaceController::start_paint(uint64_t generation,
+                                              PaintPlan plan) {
+  if (!painter_) {
+    return;
+  }
+  painter_->begin_apply(std::move(plan));
+  if (!painter_->applying()) {
+    return;
+  }
+  paint_task_ =
+      new BinaryNinja::BackgroundTask("CovEx: Painting highlights...", true);
+  continue_paint(generation);
+}
+
+void CoverageWorkspaceController::continue_paint(uint64_t generation) {
+  if (generation != paint_generation_.load() || !painter_) {
+    return;
+  }
+  if (paint_task_ && paint_task_->IsCancelled()) {
+    painter_->cancel_apply();
+    finish_paint_task();
+    return;
+  }
+  if (painter_->apply_step(kPaintSliceBudget)) {
+    finish_paint_task();
+    return;
+  }
+  if (paint_task_) {
+    const auto percent = static_cast<int>(painter_->apply_progress() * 100.0);
+    paint_task_->SetProgressText("CovEx: Painting highlights... " +
+                                 std::to_string(percent) + "%");
+  }
+  // Yield to the event loop between slices.
+  dispatch_ui(state_, [generation](CoverageWorkspaceController &controller) {
+    controller.continue_paint(generation);
+  });
+}
+
+void CoverageWorkspaceController::finish_paint_task() {
+  if (paint_task_) {
+    paint_task_->Finish();
+    paint_task_ = nullptr;
+  }
+}
+
+void CoverageWorkspaceController::clear_rendered_coverage() {
+  paint_generation_.fetch_add(1);
+  paint_cancel_.cancel();
+  finish_paint_task();
   if (painter_) {
     painter_->clear();
   }
+  if (auto *layer = CoverageRenderLayer::instance()) {
+    layer->withdraw(view_.GetPtr());
+    if (render_layer_ && view_ui_) {
+      view_ui_->refresh_rendering();
+    }
+  }
+}
+
+void CoverageWorkspaceController::clear_highlights() {
+  clear_rendered_coverage();
   if (logger_) {
     logger_->LogInfo("Cleared coverage highlights");
   }
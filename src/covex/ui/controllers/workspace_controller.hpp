@@ -9,13 +9,19 @@
 #include <vector>
 
 #include "binaryninjaapi.h"
+#include "covex/core/binary_view_oracle.hpp"
 #include "covex/core/block_filter.hpp"
 #include "covex/core/coverage_index.hpp"
 #include "covex/core/coverage_mapper.hpp"
+#include "covex/core/index_cache.hpp"
+#include "covex/core/task_scheduler.hpp"
 #include "covex/coverage/addr_trace_reader.hpp"
+#include "covex/coverage/cancellation.hpp"
 #include "covex/coverage/coverage_expression.hpp"
 #include "covex/coverage/coverage_parser.hpp"
 #include "covex/coverage/drcov_reader.hpp"
+#include "covex/coverage/expression_cache.hpp"
+#include "covex/coverage/expression_optimizer.hpp"
 #include "covex/ui/painting/coverage_painter.hpp"
 #include "uitypes.h"
 
@@ -44,6 +50,8 @@ public:
   virtual void set_blocks(const std::vector<BlockSummary> &blocks) = 0;
   virtual void show_expression_error(const std::string &message) = 0;
   virtual void clear_expression_error() = 0;
+  // Redraws the current view after render-layer coverage changed.
+  virtual void refresh_rendering() = 0;
 };
 
 enum class HighlightMode { Plain, Heatmap };
@@ -64,6 +72,8 @@ public:
   void set_highlight_mode(HighlightMode mode);
   void set_granularity(HighlightGranularity granularity);
   void set_heatmap_settings(const HeatmapSettings &settings);
+  // The user moved to `offset`; lazy painting paints what is now shown.
+  void notify_navigation(uint64_t offset);
   bool request_define_functions_from_coverage();
 
   static CoverageWorkspaceController *find(BinaryNinja::BinaryView *view);
@@ -86,6 +96,12 @@ private:
     coverage::CoverageStats stats;
   };
 
+  // Another open view a loaded trace is also mapped into.
+  struct SharedTarget {
+    std::shared_ptr<ControllerState> state;
+    std::shared_ptr<core::BinaryViewOracle> oracle;
+  };
+
   struct CompositionResult {
     core::CoverageIndex index;
   };
@@ -94,12 +110,34 @@ private:
   CoverageWorkspaceView *view_ui_ = nullptr;
   std::shared_ptr<ControllerState> state_;
   coverage::CoverageParserRegistry parser_registry_;
+  std::shared_ptr<core::BinaryViewOracle> oracle_;
   core::CoverageMapper mapper_;
+  // Null when the on-disk index cache is disabled.
+  std::shared_ptr<core::IndexCache> index_cache_;
+  // Shared with composition tasks, which may outlive the controller.
+  std::shared_ptr<coverage::ExpressionCache> expression_cache_ =
+      std::make_shared<coverage::ExpressionCache>();
   std::unique_ptr<CoveragePainter> painter_;
   std::vector<TraceRecord> traces_;
   std::optional<core::CoverageIndex> active_index_;
+  // Instruction-level view of a block-native active index, built on demand.
+  std::optional<coverage::CoverageDataset> expanded_active_;
+  bool block_native_ = false;
+  // Draw coverage through the render layer instead of stored highlights.
+  bool render_layer_ = false;
   std::atomic<uint64_t> compose_generation_{0};
   std::atomic<uint64_t> filter_generation_{0};
+  std::atomic<uint64_t> paint_generation_{0};
+  core::TaskScheduler *scheduler_ = nullptr;
+  // Cancelled with the controller; covers loads and discovery.
+  coverage::CancellationToken lifetime_cancel_ =
+      coverage::CancellationToken::create();
+  // Each cancelled as soon as a newer request supersedes it.
+  coverage::CancellationToken compose_cancel_;
+  coverage::CancellationToken filter_cancel_;
+  coverage::CancellationToken paint_cancel_;
+  // Progress of the chunked highlight apply, if one is running.
+  BinaryNinja::Ref<BinaryNinja::BackgroundTask> paint_task_;
   uint64_t next_trace_id_ = 1;
   std::string expression_;
   std::string block_filter_;
@@ -116,11 +154,19 @@ private:
   void update_trace_view();
   void update_blocks_view(const std::vector<core::CoveredBlock> &blocks);
   void compose_expression_async(
-      uint64_t generation, coverage::ComposePlan plan,
-      std::unordered_map<std::string, coverage::CoverageDataset> datasets);
+      uint64_t generation, coverage::OptimizedPlan plan,
+      std::unordered_map<std::string, coverage::CoverageDataset> datasets,
+      std::vector<core::BlockSpan> extents);
   void filter_blocks_async(uint64_t generation, core::BlockFilter filter,
                            std::vector<BlockSummary> blocks);
+  void set_active_index(std::optional<core::CoverageIndex> index);
   void apply_active_highlights();
+  void plan_paint_async(coverage::CoverageDataset dataset,
+                        std::vector<core::CoveredBlock> blocks);
+  void start_paint(uint64_t generation, PaintPlan plan);
+  void continue_paint(uint64_t generation);
+  void finish_paint_task();
+  void clear_rendered_coverage();
   std::string next_alias() const;
 
   static std::unordered_map<ViewKey, CoverageWorkspaceController *> registry_;
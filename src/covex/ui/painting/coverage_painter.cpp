@@ -1,276 +1,525 @@
 #include "covex/ui/painting/coverage_painter.hpp"
 
 #include <algorithm>
-#include <cmath>
+#include <iterator>
+#include <utility>
 
 namespace binja::covex::ui {
 
 namespace {
 
-constexpr uint64_t kMaxInstructionLength = 16;
+// Reads the clock every few items, and never before the first batch, so
+// every step makes progress even with an empty budget.
+constexpr size_t kDeadlineCheckInterval = 64;
 
-std::vector<uint64_t>
-collect_hitcounts(const coverage::CoverageDataset &dataset) {
-  std::vector<uint64_t> counts;
-  counts.reserve(dataset.hits().size());
-  for (const auto &[addr, count] : dataset.hits()) {
-    (void)addr;
-    counts.push_back(count);
-  }
-  return counts;
-}
-
-struct HeatmapColor {
-  uint8_t red = 0;
-  uint8_t green = 0;
-  uint8_t blue = 0;
-};
-
-HeatmapColor heatmap_color(uint64_t value, uint64_t min_value,
-                           uint64_t max_value) {
-  if (max_value <= min_value) {
-    return {128, 0, 128};
-  }
-  const double normalized = static_cast<double>(value - min_value) /
-                            static_cast<double>(max_value - min_value);
-  const auto red = static_cast<uint8_t>(255 * normalized);
-  const auto blue = static_cast<uint8_t>(255 * (1.0 - normalized));
-  return {red, 0, blue};
-}
-
-HeatmapColor heatmap_color_log(uint64_t value, uint64_t min_value,
-                               uint64_t max_value) {
-  if (max_value <= min_value) {
-    return {128, 0, 128};
-  }
-  const double log_min = std::log(static_cast<double>(min_value) + 1.0);
-  const double log_max = std::log(static_cast<double>(max_value) + 1.0);
-  const double log_val = std::log(static_cast<double>(value) + 1.0);
-  const double normalized = (log_val - log_min) / (log_max - log_min);
-  const auto red = static_cast<uint8_t>(255 * std::clamp(normalized, 0.0, 1.0));
-  const auto blue =
-      static_cast<uint8_t>(255 * (1.0 - std::clamp(normalized, 0.0, 1.0)));
-  return {red, 0, blue};
+bool past_deadline(std::chrono::steady_clock::time_point deadline,
+                   size_t checks) {
+  return deadline != std::chrono::steady_clock::time_point::max() &&
+         checks % kDeadlineCheckInterval == 0 &&
+         std::chrono::steady_clock::now() >= deadline;
 }
 
-uint64_t percentile_cap_value(std::vector<uint64_t> &counts,
-                              uint32_t percentile) {
-  if (counts.empty()) {
-    return 0;
+// Sets or, for a null colour, clears one instruction highlight.
+void set_instruction_color(const FunctionRef &func, const ArchitectureRef &arch,
+                           uint64_t addr, const PaintColor *color) {
+  if (!color) {
+    func->SetAutoInstructionHighlight(arch, addr, NoHighlightColor);
+  } else if (color->standard) {
+    func->SetAutoInstructionHighlight(
+        arch, addr, static_cast<BNHighlightStandardColor>(color->value),
+        color->alpha);
+  } else {
+    func->SetAutoInstructionHighlight(
+        arch, addr, static_cast<uint8_t>(color->value >> 16),
+        static_cast<uint8_t>(color->value >> 8),
+        static_cast<uint8_t>(color->value), color->alpha);
   }
-  std::sort(counts.begin(), counts.end());
-  const double fraction = static_cast<double>(percentile) / 100.0;
-  size_t idx =
-      static_cast<size_t>(fraction * static_cast<double>(counts.size() - 1));
-  if (idx >= counts.size()) {
-    idx = counts.size() - 1;
-  }
-  return counts[idx];
 }
 
-uint64_t instruction_length(BinaryViewRef view, ArchitectureRef arch,
-                            uint64_t addr, uint64_t remaining) {
-  if (!view || !arch) {
-    return 1;
-  }
-  uint64_t length = view->GetInstructionLength(arch, addr);
-  if (length == 0 || length > kMaxInstructionLength) {
-    length = 1;
-  }
-  if (remaining > 0 && length > remaining) {
-    length = remaining;
+// Merge-walks two lists sorted by `key`, calling `remove` for entries only in
+// `before` and `apply` for entries only in `after` or recoloured in it.
+template <typename T, typename Key, typename Remove, typename Apply>
+void diff_sorted(const std::vector<T> &before, const std::vector<T> &after,
+                 Key key, Remove remove, Apply apply) {
+  size_t i = 0;
+  size_t j = 0;
+  while (i < before.size() || j < after.size()) {
+    if (j == after.size() ||
+        (i < before.size() && key(before[i]) < key(after[j]))) {
+      remove(before[i++]);
+    } else if (i == before.size() || key(after[j]) < key(before[i])) {
+      apply(after[j++]);
+    } else {
+      if (before[i].color != after[j].color) {
+        apply(after[j]);
+      }
+      ++i;
+      ++j;
+    }
   }
-  return length;
 }
 
 } // namespace
 
-CoveragePainter::CoveragePainter(BinaryViewRef view) : view_(view) {}
+PaintColor PaintColor::from_standard(BNHighlightStandardColor color,
+                                     uint8_t alpha) {
+  return {static_cast<uint32_t>(color), alpha, true};
+}
 
-void CoveragePainter::apply_plain(const coverage::CoverageDataset &dataset,
-                                  HighlightGranularity granularity) {
-  clear();
+PaintColor PaintColor::from_rgb(const HeatmapColor &color, uint8_t alpha) {
+  return {(uint32_t{color.red} << 16) | (uint32_t{color.green} << 8) |
+              uint32_t{color.blue},
+          alpha, false};
+}
+
+CoveragePainter::CoveragePainter(BinaryViewRef view)
+    : view_(view),
+      boundaries_(core::InstructionBoundaryCache::for_view(view)) {}
+
+PaintPlan
+CoveragePainter::plan_plain(const BinaryViewRef &view,
+                            const coverage::CoverageDataset &dataset,
+                            const std::vector<core::CoveredBlock> &blocks,
+                            HighlightGranularity granularity,
+                            const coverage::CancellationToken &cancel) {
+  PaintPlan plan;
+  plan.granularity = granularity;
+  if (!view) {
+    return plan;
+  }
+  const auto color = PaintColor::from_standard(OrangeHighlightColor);
+  auto &targets = plan.targets;
   switch (granularity) {
-  case HighlightGranularity::BasicBlock:
-    apply_plain_block(dataset);
+  case HighlightGranularity::BasicBlock: {
+    const auto block_hits = block_hit_dataset(blocks);
+    targets.reserve(block_hits.size());
+    size_t item = 0;
+    for (const uint64_t addr : block_hits.addresses()) {
+      cancel.poll(item++);
+      targets.push_back({addr, color});
+    }
     break;
+  }
   case HighlightGranularity::Instruction:
-  default:
-    apply_plain_instruction(dataset);
+  default: {
+    targets.reserve(dataset.size());
+    size_t item = 0;
+    for (const uint64_t addr : dataset.addresses()) {
+      cancel.poll(item++);
+      targets.push_back({addr, color});
+    }
     break;
   }
+  }
+  return plan;
 }
 
-void CoveragePainter::apply_heatmap(const coverage::CoverageDataset &dataset,
-                                    HighlightGranularity granularity,
-                                    const HeatmapSettings &settings) {
-  clear();
+PaintPlan
+CoveragePainter::plan_heatmap(const BinaryViewRef &view,
+                              const coverage::CoverageDataset &dataset,
+                              const std::vector<core::CoveredBlock> &blocks,
+                              HighlightGranularity granularity,
+                              const HeatmapSettings &settings,
+                              const coverage::CancellationToken &cancel) {
+  PaintPlan plan;
+  plan.granularity = granularity;
+  if (!view) {
+    return plan;
+  }
+  auto &targets = plan.targets;
   switch (granularity) {
-  case HighlightGranularity::BasicBlock:
-    apply_heatmap_block(dataset, settings);
+  case HighlightGranularity::BasicBlock: {
+    const auto block_hits = block_hit_dataset(blocks);
+    const auto scale =
+        HeatmapScale::from_counts(block_hits.hit_counts(), settings);
+    cancel.throw_if_cancelled();
+    targets.reserve(block_hits.size());
+    size_t item = 0;
+    for (const auto &[addr, count] : block_hits) {
+      cancel.poll(item++);
+      targets.push_back(
+          {addr, PaintColor::from_rgb(scale.color(count), settings.alpha)});
+    }
     break;
+  }
   case HighlightGranularity::Instruction:
-  default:
-    apply_heatmap_instruction(dataset, settings);
+  default: {
+    const auto scale =
+        HeatmapScale::from_counts(dataset.hit_counts(), settings);
+    cancel.throw_if_cancelled();
+    targets.reserve(dataset.size());
+    size_t item = 0;
+    for (const auto &[addr, count] : dataset) {
+      cancel.poll(item++);
+      targets.push_back(
+          {addr, PaintColor::from_rgb(scale.color(count), settings.alpha)});
+    }
     break;
   }
+  }
+  return plan;
 }
 
-void CoveragePainter::clear() {
-  for (const auto &entry : instruction_highlights_) {
-    if (!entry.function) {
+coverage::CoverageDataset CoveragePainter::block_hit_dataset(
+    const std::vector<core::CoveredBlock> &blocks) {
+  std::vector<uint64_t> starts;
+  std::vector<uint64_t> hits;
+  starts.reserve(blocks.size());
+  hits.reserve(blocks.size());
+  // Blocks come sorted by start; a start repeats only when the block belongs
+  // to several functions, each listing the same hits.
+  for (const auto &block : blocks) {
+    if (!starts.empty() && starts.back() == block.start) {
+      hits.back() = std::max(hits.back(), block.hits);
       continue;
     }
-    entry.function->SetAutoInstructionHighlight(
-        entry.function->GetArchitecture(), entry.address, NoHighlightColor);
+    starts.push_back(block.start);
+    hits.push_back(block.hits);
   }
-  instruction_highlights_.clear();
+  return coverage::CoverageDataset::from_sorted(std::move(starts),
+                                                std::move(hits));
+}
 
-  for (const auto &entry : block_highlights_) {
-    if (!entry.block) {
-      continue;
-    }
-    entry.block->SetAutoBasicBlockHighlight(NoHighlightColor);
+void CoveragePainter::apply_plain(const coverage::CoverageDataset &dataset,
+                                  const std::vector<core::CoveredBlock> &blocks,
+                                  HighlightGranularity granularity) {
+  if (!view_) {
+    return;
   }
-  block_highlights_.clear();
+  apply(plan_plain(view_, dataset, blocks, granularity));
 }
 
-CoveragePainter::BlockHitMap CoveragePainter::build_block_hit_map(
-    const coverage::CoverageDataset &dataset) const {
-  BlockHitMap result;
+void CoveragePainter::apply_heatmap(
+    const coverage::CoverageDataset &dataset,
+    const std::vector<core::CoveredBlock> &blocks,
+    HighlightGranularity granularity, const HeatmapSettings &settings) {
   if (!view_) {
-    return result;
+    return;
   }
-  for (const auto &[addr, count] : dataset.hits()) {
-    const auto blocks = view_->GetBasicBlocksForAddress(addr);
-    for (const auto &block : blocks) {
-      if (!block) {
-        continue;
-      }
-      result[block->GetStart()] += count;
-    }
+  apply(plan_heatmap(view_, dataset, blocks, granularity, settings));
+}
+
+void CoveragePainter::apply(PaintPlan plan) {
+  begin_apply(std::move(plan));
+  if (job_) {
+    run_job(*job_, Deadline::max());
+    job_.reset();
   }
-  return result;
 }
 
-void CoveragePainter::apply_plain_instruction(
-    const coverage::CoverageDataset &dataset) {
-  if (!view_) {
+void CoveragePainter::begin_apply(PaintPlan plan) {
+  cancel_apply();
+  if (lazy_) {
+    lazy_granularity_ = plan.granularity;
+    lazy_targets_ = std::move(plan.targets);
+    for (auto &entry : lazy_functions_) {
+      repaint_function(entry, false);
+    }
+    if (lazy_functions_.empty() && last_focus_) {
+      focus(*last_focus_);
+    }
     return;
   }
-  for (const auto &[addr, count] : dataset.hits()) {
-    (void)count;
-    const auto funcs = view_->GetAnalysisFunctionsContainingAddress(addr);
-    for (const auto &func : funcs) {
-      if (!func) {
-        continue;
-      }
-      func->SetAutoInstructionHighlight(func->GetArchitecture(), addr,
-                                        OrangeHighlightColor);
-      instruction_highlights_.push_back({func, addr});
-    }
+  ApplyJob job;
+  job.work_total = painted_instructions_.size() + painted_blocks_.size() +
+                   plan.targets.size();
+  job.plan = std::move(plan);
+  job_ = std::move(job);
+}
+
+bool CoveragePainter::apply_step(std::chrono::milliseconds budget) {
+  if (!job_) {
+    return true;
+  }
+  if (!run_job(*job_, std::chrono::steady_clock::now() + budget)) {
+    return false;
   }
+  job_.reset();
+  return true;
 }
 
-void CoveragePainter::apply_plain_block(
-    const coverage::CoverageDataset &dataset) {
-  if (!view_) {
+double CoveragePainter::apply_progress() const {
+  if (!job_ || job_->work_total == 0) {
+    return job_ ? 0.0 : 1.0;
+  }
+  return std::min(1.0, static_cast<double>(job_->work_done) /
+                           static_cast<double>(job_->work_total));
+}
+
+void CoveragePainter::cancel_apply() {
+  if (!job_) {
     return;
   }
-  auto block_hits = build_block_hit_map(dataset);
-  for (const auto &[addr, count] : block_hits) {
-    (void)count;
-    const auto blocks = view_->GetBasicBlocksStartingAtAddress(addr);
-    for (const auto &block : blocks) {
-      if (!block) {
-        continue;
-      }
-      block->SetAutoBasicBlockHighlight(OrangeHighlightColor);
-      block_highlights_.push_back({block});
-      highlight_block_instructions(block, OrangeHighlightColor);
+  settle(*job_);
+  job_.reset();
+}
+
+void CoveragePainter::clear() {
+  cancel_apply();
+  ApplyJob job;
+  run_job(job, Deadline::max());
+  clear_lazy();
+}
+
+void CoveragePainter::set_lazy(bool lazy, size_t capacity) {
+  clear();
+  lazy_ = lazy;
+  lazy_capacity_ = std::max<size_t>(1, capacity);
+}
+
+void CoveragePainter::focus(uint64_t addr) {
+  last_focus_ = addr;
+  if (!lazy_ || !view_) {
+    return;
+  }
+  std::vector<FunctionRef> neighbours;
+  for (const uint64_t start :
+       {view_->GetPreviousFunctionStartBeforeAddress(addr),
+        view_->GetNextFunctionStartAfterAddress(addr)}) {
+    for (const auto &func : view_->GetAnalysisFunctionsForAddress(start)) {
+      neighbours.push_back(func);
     }
   }
+  // Neighbours first, so the shown function ends up most recently used.
+  for (const auto &func : neighbours) {
+    show_function(func);
+  }
+  for (const auto &func : view_->GetAnalysisFunctionsContainingAddress(addr)) {
+    show_function(func);
+  }
 }
 
-void CoveragePainter::apply_heatmap_instruction(
-    const coverage::CoverageDataset &dataset, const HeatmapSettings &settings) {
-  if (!view_) {
-    return;
+bool CoveragePainter::run_job(ApplyJob &job, Deadline deadline) {
+  // Clear the other granularity first so its block-wide instruction
+  // highlights do not overwrite the new ones.
+  static const std::vector<PaintTarget> kNone;
+  const bool blocks = job.plan.granularity == HighlightGranularity::BasicBlock;
+  if (job.clearing_other) {
+    const bool done = blocks ? merge_instructions(job, kNone, deadline)
+                             : merge_blocks(job, kNone, deadline);
+    if (!done) {
+      return false;
+    }
+    job.clearing_other = false;
   }
-  auto counts = collect_hitcounts(dataset);
-  if (counts.empty()) {
+  return blocks ? merge_blocks(job, job.plan.targets, deadline)
+                : merge_instructions(job, job.plan.targets, deadline);
+}
+
+uint32_t CoveragePainter::acquire_function(const FunctionRef &function) {
+  auto [it, inserted] = function_slots_.try_emplace(function->GetObject(), 0);
+  if (inserted) {
+    if (free_function_slots_.empty()) {
+      it->second = static_cast<uint32_t>(painted_functions_.size());
+      painted_functions_.emplace_back();
+    } else {
+      it->second = free_function_slots_.back();
+      free_function_slots_.pop_back();
+    }
+    auto &entry = painted_functions_[it->second];
+    entry.function = function;
+    entry.arch = function->GetArchitecture();
+  }
+  ++painted_functions_[it->second].instructions;
+  return it->second;
+}
+
+void CoveragePainter::release_function(uint32_t slot) {
+  auto &entry = painted_functions_[slot];
+  if (--entry.instructions > 0) {
     return;
   }
-  const uint64_t min_value = *std::min_element(counts.begin(), counts.end());
-  const uint64_t cap_value =
-      percentile_cap_value(counts, settings.percentile_cap);
+  function_slots_.erase(entry.function->GetObject());
+  entry = PaintedFunction{};
+  free_function_slots_.push_back(slot);
+}
 
-  for (const auto &[addr, count] : dataset.hits()) {
-    const auto funcs = view_->GetAnalysisFunctionsContainingAddress(addr);
-    if (funcs.empty()) {
+void CoveragePainter::set_painted_color(const PaintedInstruction &entry,
+                                        const PaintColor *color) {
+  const auto &owner = painted_functions_[entry.function];
+  set_instruction_color(owner.function, owner.arch, entry.address, color);
+}
+
+bool CoveragePainter::merge_instructions(
+    ApplyJob &job, const std::vector<PaintTarget> &targets, Deadline deadline) {
+  auto &painted = painted_instructions_;
+  auto &next = job.next_instructions;
+  size_t &i = job.painted_pos;
+  size_t &j = job.target_pos;
+  size_t checks = 0;
+  const auto expired = [&]() {
+    return past_deadline(deadline, ++checks);
+  };
+  for (; j < targets.size(); ++j) {
+    const auto &target = targets[j];
+    // Painted addresses the target skips are no longer covered.
+    for (; i < painted.size() && painted[i].address < target.address; ++i) {
+      if (expired()) {
+        return false;
+      }
+      set_painted_color(painted[i], nullptr);
+      release_function(painted[i].function);
+      ++job.work_done;
+    }
+    if (expired()) {
+      return false;
+    }
+    ++job.work_done;
+    if (i < painted.size() && painted[i].address == target.address) {
+      for (; i < painted.size() && painted[i].address == target.address;
+           ++i) {
+        if (painted[i].color != target.color) {
+          set_painted_color(painted[i], &target.color);
+        }
+        next.push_back({target.address, target.color, painted[i].function});
+        ++job.work_done;
+      }
+      continue;
+    }
+    if (!view_) {
       continue;
     }
-    const uint64_t capped = std::min(count, cap_value);
-    const HeatmapColor color =
-        settings.log_scale ? heatmap_color_log(capped, min_value, cap_value)
-                           : heatmap_color(capped, min_value, cap_value);
-    for (const auto &func : funcs) {
+    for (const auto &func :
+         view_->GetAnalysisFunctionsContainingAddress(target.address)) {
       if (!func) {
         continue;
       }
-      func->SetAutoInstructionHighlight(func->GetArchitecture(), addr,
-                                        color.red, color.green, color.blue,
-                                        settings.alpha);
-      instruction_highlights_.push_back({func, addr});
+      next.push_back({target.address, target.color, acquire_function(func)});
+      set_painted_color(next.back(), &target.color);
     }
   }
+  for (; i < painted.size(); ++i) {
+    if (expired()) {
+      return false;
+    }
+    set_painted_color(painted[i], nullptr);
+    release_function(painted[i].function);
+    ++job.work_done;
+  }
+  painted = std::move(next);
+  next.clear();
+  if (painted.empty()) {
+    // Nothing refers to the function table any more; drop it wholesale.
+    painted_functions_.clear();
+    function_slots_.clear();
+    free_function_slots_.clear();
+  }
+  i = 0;
+  j = 0;
+  return true;
 }
 
-void CoveragePainter::apply_heatmap_block(
-    const coverage::CoverageDataset &dataset, const HeatmapSettings &settings) {
-  if (!view_) {
-    return;
-  }
-  auto block_hits = build_block_hit_map(dataset);
-  if (block_hits.empty()) {
-    return;
-  }
-
-  std::vector<uint64_t> counts;
-  counts.reserve(block_hits.size());
-  for (const auto &[addr, count] : block_hits) {
-    (void)addr;
-    counts.push_back(count);
-  }
-  const uint64_t min_value = *std::min_element(counts.begin(), counts.end());
-  const uint64_t cap_value =
-      percentile_cap_value(counts, settings.percentile_cap);
-
-  for (const auto &[addr, count] : block_hits) {
-    const auto blocks = view_->GetBasicBlocksStartingAtAddress(addr);
-    if (blocks.empty()) {
+bool CoveragePainter::merge_blocks(ApplyJob &job,
+                                   const std::vector<PaintTarget> &targets,
+                                   Deadline deadline) {
+  auto &painted = painted_blocks_;
+  auto &next = job.next_blocks;
+  size_t &i = job.painted_pos;
+  size_t &j = job.target_pos;
+  size_t checks = 0;
+  const auto expired = [&]() {
+    return past_deadline(deadline, ++checks);
+  };
+  for (; j < targets.size(); ++j) {
+    const auto &target = targets[j];
+    for (; i < painted.size() && painted[i].start < target.address; ++i) {
+      if (expired()) {
+        return false;
+      }
+      unpaint_block(painted[i].block);
+      ++job.work_done;
+    }
+    if (expired()) {
+      return false;
+    }
+    ++job.work_done;
+    if (i < painted.size() && painted[i].start == target.address) {
+      for (; i < painted.size() && painted[i].start == target.address; ++i) {
+        if (painted[i].color != target.color) {
+          paint_block(painted[i].block, target.color);
+        }
+        next.push_back(
+            {target.address, target.color, std::move(painted[i].block)});
+        ++job.work_done;
+      }
+      continue;
+    }
+    if (!view_) {
       continue;
     }
-    const uint64_t capped = std::min(count, cap_value);
-    const HeatmapColor color =
-        settings.log_scale ? heatmap_color_log(capped, min_value, cap_value)
-                           : heatmap_color(capped, min_value, cap_value);
-    for (const auto &block : blocks) {
+    for (const auto &block :
+         view_->GetBasicBlocksStartingAtAddress(target.address)) {
       if (!block) {
         continue;
       }
-      block->SetAutoBasicBlockHighlight(color.red, color.green, color.blue,
-                                        settings.alpha);
-      block_highlights_.push_back({block});
-      highlight_block_instructions_rgb(block, color.red, color.green,
-                                       color.blue, settings.alpha);
+      paint_block(block, target.color);
+      next.push_back({target.address, target.color, block});
     }
   }
+  for (; i < painted.size(); ++i) {
+    if (expired()) {
+      return false;
+    }
+    unpaint_block(painted[i].block);
+    ++job.work_done;
+  }
+  painted = std::move(next);
+  next.clear();
+  i = 0;
+  j = 0;
+  return true;
 }
 
-void CoveragePainter::highlight_block_instructions(
-    const BasicBlockRef &block, BNHighlightStandardColor color, uint8_t alpha) {
-  if (!view_ || !block) {
+void CoveragePainter::settle(ApplyJob &job) {
+  // Entries before painted_pos were either cleared or moved into the pass's
+  // output, and every output entry sorts before the ones not reached yet.
+  const bool blocks = job.clearing_other
+                          ? job.plan.granularity !=
+                                HighlightGranularity::BasicBlock
+                          : job.plan.granularity ==
+                                HighlightGranularity::BasicBlock;
+  const auto rest = static_cast<std::ptrdiff_t>(job.painted_pos);
+  if (blocks) {
+    job.next_blocks.insert(
+        job.next_blocks.end(),
+        std::make_move_iterator(painted_blocks_.begin() + rest),
+        std::make_move_iterator(painted_blocks_.end()));
+    painted_blocks_ = std::move(job.next_blocks);
+  } else {
+    job.next_instructions.insert(
+        job.next_instructions.end(),
+        std::make_move_iterator(painted_instructions_.begin() + rest),
+        std::make_move_iterator(painted_instructions_.end()));
+    painted_instructions_ = std::move(job.next_instructions);
+  }
+  job.next_blocks.clear();
+  job.next_instructions.clear();
+  job.painted_pos = 0;
+  job.target_pos = 0;
+}
+
+void CoveragePainter::paint_block(const BasicBlockRef &block,
+                                  const PaintColor &color) {
+  if (color.standard) {
+    block->SetAutoBasicBlockHighlight(
+        static_cast<BNHighlightStandardColor>(color.value), color.alpha);
+  } else {
+    block->SetAutoBasicBlockHighlight(static_cast<uint8_t>(color.value >> 16),
+                                      static_cast<uint8_t>(color.value >> 8),
+                                      static_cast<uint8_t>(color.value),
+                                      color.alpha);
+  }
+  paint_block_instructions(block, &color);
+}
+
+void CoveragePainter::unpaint_block(const BasicBlockRef &block) {
+  block->SetAutoBasicBlockHighlight(NoHighlightColor);
+  paint_block_instructions(block, nullptr);
+}
+
+void CoveragePainter::paint_block_instructions(const BasicBlockRef &block,
+                                               const PaintColor *color) {
+  if (!block) {
     return;
   }
   auto func = block->GetFunction();
@@ -278,51 +527,129 @@ void CoveragePainter::highlight_block_instructions(
     return;
   }
   auto arch = block->GetArchitecture();
-  if (!arch) {
+  if (!arch && view_) {
     arch = view_->GetDefaultArchitecture();
   }
   const uint64_t start = block->GetStart();
   const uint64_t length = block->GetLength();
-  if (length == 0) {
+  if (!arch || length == 0) {
     return;
   }
+  auto &boundary_map = boundaries_->map_for(arch);
   uint64_t addr = start;
   const uint64_t end = start + length;
   while (addr < end) {
-    func->SetAutoInstructionHighlight(arch, addr, color, alpha);
-    instruction_highlights_.push_back({func, addr});
+    set_instruction_color(func, arch, addr, color);
     const uint64_t remaining = end - addr;
-    addr += instruction_length(view_, arch, addr, remaining);
+    addr += boundaries_->instruction_length(boundary_map, arch, addr,
+                                            remaining);
   }
 }
 
-void CoveragePainter::highlight_block_instructions_rgb(
-    const BasicBlockRef &block, uint8_t r, uint8_t g, uint8_t b,
-    uint8_t alpha) {
-  if (!view_ || !block) {
+void CoveragePainter::show_function(const FunctionRef &function) {
+  if (!function) {
     return;
   }
-  auto func = block->GetFunction();
-  if (!func) {
+  const uint64_t key = function->GetStart();
+  auto found = lazy_index_.find(key);
+  if (found != lazy_index_.end()) {
+    lazy_functions_.splice(lazy_functions_.begin(), lazy_functions_,
+                           found->second);
     return;
   }
-  auto arch = block->GetArchitecture();
-  if (!arch) {
-    arch = view_->GetDefaultArchitecture();
+  lazy_functions_.push_front({function, {}, {}});
+  lazy_index_[key] = lazy_functions_.begin();
+  repaint_function(lazy_functions_.front(), false);
+  while (lazy_functions_.size() > lazy_capacity_) {
+    auto &evicted = lazy_functions_.back();
+    repaint_function(evicted, true);
+    lazy_index_.erase(evicted.function->GetStart());
+    lazy_functions_.pop_back();
   }
-  const uint64_t start = block->GetStart();
-  const uint64_t length = block->GetLength();
-  if (length == 0) {
-    return;
+}
+
+void CoveragePainter::repaint_function(LazyFunction &entry, bool clear) {
+  std::vector<PaintTarget> instructions;
+  std::vector<PaintedBlock> blocks;
+  if (!clear) {
+    for (const auto &block : entry.function->GetBasicBlocks()) {
+      if (!block) {
+        continue;
+      }
+      const uint64_t start = block->GetStart();
+      auto it = std::lower_bound(
+          lazy_targets_.begin(), lazy_targets_.end(), start,
+          [](const PaintTarget &target, uint64_t value) {
+            return target.address < value;
+          });
+      if (lazy_granularity_ == HighlightGranularity::BasicBlock) {
+        if (it != lazy_targets_.end() && it->address == start) {
+          blocks.push_back({start, it->color, block});
+        }
+        continue;
+      }
+      const uint64_t end = block->GetEnd();
+      for (; it != lazy_targets_.end() && it->address < end; ++it) {
+        instructions.push_back(*it);
+      }
+    }
+    const auto by_address = [](const PaintTarget &a, const PaintTarget &b) {
+      return a.address < b.address;
+    };
+    std::sort(instructions.begin(), instructions.end(), by_address);
+    instructions.erase(
+        std::unique(instructions.begin(), instructions.end(),
+                    [](const PaintTarget &a, const PaintTarget &b) {
+                      return a.address == b.address;
+                    }),
+        instructions.end());
+    std::sort(blocks.begin(), blocks.end(),
+              [](const PaintedBlock &a, const PaintedBlock &b) {
+                return a.start < b.start;
+              });
   }
-  uint64_t addr = start;
-  const uint64_t end = start + length;
-  while (addr < end) {
-    func->SetAutoInstructionHighlight(arch, addr, r, g, b, alpha);
-    instruction_highlights_.push_back({func, addr});
-    const uint64_t remaining = end - addr;
-    addr += instruction_length(view_, arch, addr, remaining);
+
+  const auto &function = entry.function;
+  const auto arch = function->GetArchitecture();
+  const auto diff_instructions = [&]() {
+    diff_sorted(
+        entry.instructions, instructions,
+        [](const PaintTarget &target) { return target.address; },
+        [&](const PaintTarget &target) {
+          set_instruction_color(function, arch, target.address, nullptr);
+        },
+        [&](const PaintTarget &target) {
+          set_instruction_color(function, arch, target.address, &target.color);
+        });
+  };
+  const auto diff_blocks = [&]() {
+    diff_sorted(
+        entry.blocks, blocks,
+        [](const PaintedBlock &painted) { return painted.start; },
+        [&](const PaintedBlock &painted) { unpaint_block(painted.block); },
+        [&](const PaintedBlock &painted) {
+          paint_block(painted.block, painted.color);
+        });
+  };
+  // As in run_job(): clear the granularity being left before painting.
+  if (lazy_granularity_ == HighlightGranularity::BasicBlock) {
+    diff_instructions();
+    diff_blocks();
+  } else {
+    diff_blocks();
+    diff_instructions();
+  }
+  entry.instructions = std::move(instructions);
+  entry.blocks = std::move(blocks);
+}
+
+void CoveragePainter::clear_lazy() {
+  for (auto &entry : lazy_functions_) {
+    repaint_function(entry, true);
   }
+  lazy_functions_.clear();
+  lazy_index_.clear();
+  lazy_targets_.clear();
 }
 
 } // namespace binja::covex::ui
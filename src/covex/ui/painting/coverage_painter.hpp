@@ -1,62 +1,202 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
+#include "covex/core/coverage_index.hpp"
+#include "covex/core/instruction_boundary_cache.hpp"
+#include "covex/coverage/cancellation.hpp"
 #include "covex/coverage/coverage_dataset.hpp"
+#include "covex/ui/painting/heatmap_scale.hpp"
 #include "uitypes.h"
 
 namespace binja::covex::ui {
 
-struct HeatmapSettings {
-  uint32_t percentile_cap = 95;
-  bool log_scale = true;
+enum class HighlightGranularity { Instruction, BasicBlock };
+
+// A highlight colour as painted: one of the standard colours or an RGB
+// value, plus alpha.
+struct PaintColor {
+  uint32_t value = 0;
   uint8_t alpha = 255;
+  bool standard = false;
+
+  static PaintColor from_standard(BNHighlightStandardColor color,
+                                  uint8_t alpha = 255);
+  static PaintColor from_rgb(const HeatmapColor &color, uint8_t alpha);
+
+  friend bool operator==(const PaintColor &, const PaintColor &) = default;
 };
 
-enum class HighlightGranularity { Instruction, BasicBlock };
+struct PaintTarget {
+  uint64_t address = 0;
+  PaintColor color;
+};
 
+// Colours an apply should leave painted: instruction addresses, or block
+// starts for block granularity, sorted by address without duplicates.
+// Building a plan only reads the view, so it can run off the main thread.
+struct PaintPlan {
+  HighlightGranularity granularity = HighlightGranularity::Instruction;
+  std::vector<PaintTarget> targets;
+};
+
+// Paints coverage as auto highlights. The painter remembers what it painted,
+// sorted by address, and each apply only issues highlight calls for
+// addresses or blocks that were added, removed or recoloured since the last
+// one.
+//
+// In lazy mode an apply only records the colours; a function is painted when
+// focus() reports it shown, and at most `capacity` recently shown functions
+// stay painted.
 class CoveragePainter {
 public:
+  static constexpr size_t kDefaultLazyCapacity = 32;
+
   explicit CoveragePainter(BinaryViewRef view);
 
+  // Switching modes clears all highlights.
+  void set_lazy(bool lazy, size_t capacity = kDefaultLazyCapacity);
+  bool lazy() const { return lazy_; }
+  // Lazy mode: paints the functions containing `addr` and the functions on
+  // either side of it, which are likely to be shown next.
+  void focus(uint64_t addr);
+
+  // Instruction granularity paints `dataset`; block granularity paints
+  // `blocks`, so every block a trace block overlaps is coloured whether or
+  // not the dataset is keyed by instruction. Planning throws
+  // coverage::OperationCancelled once `cancel` is cancelled.
+  static PaintPlan plan_plain(const BinaryViewRef &view,
+                              const coverage::CoverageDataset &dataset,
+                              const std::vector<core::CoveredBlock> &blocks,
+                              HighlightGranularity granularity,
+                              const coverage::CancellationToken &cancel = {});
+  static PaintPlan plan_heatmap(const BinaryViewRef &view,
+                                const coverage::CoverageDataset &dataset,
+                                const std::vector<core::CoveredBlock> &blocks,
+                                HighlightGranularity granularity,
+                                const HeatmapSettings &settings,
+                                const coverage::CancellationToken &cancel = {});
+  // Block start -> hits. A block listed under several functions is counted
+  // once.
+  static coverage::CoverageDataset
+  block_hit_dataset(const std::vector<core::CoveredBlock> &blocks);
+
   void apply_plain(const coverage::CoverageDataset &dataset,
+                   const std::vector<core::CoveredBlock> &blocks,
                    HighlightGranularity granularity);
   void apply_heatmap(const coverage::CoverageDataset &dataset,
+                     const std::vector<core::CoveredBlock> &blocks,
                      HighlightGranularity granularity,
                      const HeatmapSettings &settings);
+  void apply(PaintPlan plan);
+
+  // Chunked application. begin_apply() settles any unfinished apply first;
+  // apply_step() paints until `budget` runs out and returns true once the
+  // plan is fully applied. Lazy mode applies the plan in begin_apply().
+  void begin_apply(PaintPlan plan);
+  bool apply_step(std::chrono::milliseconds budget);
+  bool applying() const { return job_.has_value(); }
+  // Fraction of the current apply done so far, in [0, 1].
+  double apply_progress() const;
+  // Stops the current apply, keeping what was painted so far.
+  void cancel_apply();
+
   void clear();
 
 private:
-  struct InstructionHighlight {
+  using Deadline = std::chrono::steady_clock::time_point;
+
+  // A function with painted instructions. Entries refer to it by slot, so
+  // each function is referenced once however many instructions it has.
+  struct PaintedFunction {
     FunctionRef function;
+    ArchitectureRef arch;
+    size_t instructions = 0;
+  };
+
+  // One entry per (address, function); entries for an address are adjacent.
+  struct PaintedInstruction {
     uint64_t address = 0;
+    PaintColor color;
+    uint32_t function = 0;
   };
 
-  struct BlockHighlight {
+  // One entry per block; blocks sharing a start are adjacent.
+  struct PaintedBlock {
+    uint64_t start = 0;
+    PaintColor color;
     BasicBlockRef block;
   };
 
-  using BlockHitMap = std::unordered_map<uint64_t, uint64_t>;
-
-  BlockHitMap
-  build_block_hit_map(const coverage::CoverageDataset &dataset) const;
-  void apply_plain_instruction(const coverage::CoverageDataset &dataset);
-  void apply_plain_block(const coverage::CoverageDataset &dataset);
-  void apply_heatmap_instruction(const coverage::CoverageDataset &dataset,
-                                 const HeatmapSettings &settings);
-  void apply_heatmap_block(const coverage::CoverageDataset &dataset,
-                           const HeatmapSettings &settings);
-  void highlight_block_instructions(const BasicBlockRef &block,
-                                    BNHighlightStandardColor color,
-                                    uint8_t alpha = 255);
-  void highlight_block_instructions_rgb(const BasicBlockRef &block, uint8_t r,
-                                        uint8_t g, uint8_t b, uint8_t alpha);
+  // What lazy mode painted in one function, sorted by address.
+  struct LazyFunction {
+    FunctionRef function;
+    std::vector<PaintTarget> instructions;
+    std::vector<PaintedBlock> blocks;
+  };
+
+  // An apply in progress. Each pass merges the painted state toward a
+  // target list; the first clears the granularity not being painted.
+  struct ApplyJob {
+    PaintPlan plan;
+    bool clearing_other = true;
+    size_t painted_pos = 0;
+    size_t target_pos = 0;
+    std::vector<PaintedInstruction> next_instructions;
+    std::vector<PaintedBlock> next_blocks;
+    size_t work_total = 0;
+    size_t work_done = 0;
+  };
+
+  using LazyList = std::list<LazyFunction>;
+
+  uint32_t acquire_function(const FunctionRef &function);
+  void release_function(uint32_t slot);
+  void set_painted_color(const PaintedInstruction &entry,
+                         const PaintColor *color);
+  bool run_job(ApplyJob &job, Deadline deadline);
+  // Advance one merge pass; return true once it is complete.
+  bool merge_instructions(ApplyJob &job,
+                          const std::vector<PaintTarget> &targets,
+                          Deadline deadline);
+  bool merge_blocks(ApplyJob &job, const std::vector<PaintTarget> &targets,
+                    Deadline deadline);
+  // Folds a half-done pass back into the painted state.
+  void settle(ApplyJob &job);
+  void paint_block(const BasicBlockRef &block, const PaintColor &color);
+  void unpaint_block(const BasicBlockRef &block);
+  void paint_block_instructions(const BasicBlockRef &block,
+                                const PaintColor *color);
+  void show_function(const FunctionRef &function);
+  // Brings a lazily painted function in line with the current target; with
+  // `clear` set, removes its highlights instead.
+  void repaint_function(LazyFunction &entry, bool clear);
+  void clear_lazy();
 
   BinaryViewRef view_;
-  std::vector<InstructionHighlight> instruction_highlights_;
-  std::vector<BlockHighlight> block_highlights_;
+  std::shared_ptr<core::InstructionBoundaryCache> boundaries_;
+  std::vector<PaintedInstruction> painted_instructions_;
+  std::vector<PaintedFunction> painted_functions_;
+  std::unordered_map<BNFunction *, uint32_t> function_slots_;
+  std::vector<uint32_t> free_function_slots_;
+  std::vector<PaintedBlock> painted_blocks_;
+
+  bool lazy_ = false;
+  size_t lazy_capacity_ = kDefaultLazyCapacity;
+  HighlightGranularity lazy_granularity_ = HighlightGranularity::Instruction;
+  std::vector<PaintTarget> lazy_targets_;
+  std::optional<uint64_t> last_focus_;
+  // Most recently shown first.
+  LazyList lazy_functions_;
+  std::unordered_map<uint64_t, LazyList::iterator> lazy_index_;
+
+  std::optional<ApplyJob> job_;
 };
 
 } // namespace binja::covex::ui
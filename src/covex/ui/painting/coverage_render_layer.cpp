@@ -0,0 +1,124 @@
+#include "covex/ui/painting/coverage_render_layer.hpp"
+
+namespace binja::covex::ui {
+
+namespace {
+
+constexpr const char *kRenderLayerName = "CovEx Coverage";
+
+CoverageRenderLayer *g_render_layer = nullptr;
+
+} // namespace
+
+std::shared_ptr<const CoverageRenderState> CoverageRenderState::build(
+    const coverage::CoverageDataset &dataset,
+    const std::vector<core::CoveredBlock> &blocks,
+    HighlightGranularity granularity, bool heatmap,
+    const HeatmapSettings &settings) {
+  auto state = std::make_shared<CoverageRenderState>();
+  state->dataset = granularity == HighlightGranularity::BasicBlock
+                       ? CoveragePainter::block_hit_dataset(blocks)
+                       : dataset;
+  state->granularity = granularity;
+  state->heatmap = heatmap;
+  state->alpha = settings.alpha;
+  if (heatmap) {
+    state->scale =
+        HeatmapScale::from_counts(state->dataset.hit_counts(), settings);
+  }
+  return state;
+}
+
+BNHighlightColor CoverageRenderState::color(uint64_t hits) const {
+  BNHighlightColor result{};
+  result.alpha = alpha;
+  if (!heatmap) {
+    result.style = StandardHighlightColor;
+    result.color = OrangeHighlightColor;
+    return result;
+  }
+  const HeatmapColor rgb = scale.color(hits);
+  result.style = CustomHighlightColor;
+  result.r = rgb.red;
+  result.g = rgb.green;
+  result.b = rgb.blue;
+  return result;
+}
+
+CoverageRenderLayer::CoverageRenderLayer() : RenderLayer(kRenderLayerName) {}
+
+void CoverageRenderLayer::register_layer() {
+  if (g_render_layer) {
+    return;
+  }
+  g_render_layer = new CoverageRenderLayer();
+  BinaryNinja::RenderLayer::Register(
+      g_render_layer, EnabledByDefaultRenderLayerDefaultEnableState);
+}
+
+CoverageRenderLayer *CoverageRenderLayer::instance() { return g_render_layer; }
+
+void CoverageRenderLayer::publish(
+    BinaryNinja::BinaryView *view,
+    std::shared_ptr<const CoverageRenderState> state) {
+  if (!view) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  states_[view->GetObject()] = std::move(state);
+}
+
+void CoverageRenderLayer::withdraw(BinaryNinja::BinaryView *view) {
+  if (!view) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  states_.erase(view->GetObject());
+}
+
+std::shared_ptr<const CoverageRenderState>
+CoverageRenderLayer::state_for(BinaryNinja::BinaryView *view) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = states_.find(view->GetObject());
+  return it == states_.end() ? nullptr : it->second;
+}
+
+void CoverageRenderLayer::ApplyToDisassemblyBlock(
+    BinaryNinja::Ref<BinaryNinja::BasicBlock> block,
+    std::vector<BinaryNinja::DisassemblyTextLine> &lines) {
+  if (!block) {
+    return;
+  }
+  auto func = block->GetFunction();
+  if (!func) {
+    return;
+  }
+  auto view = func->GetView();
+  if (!view) {
+    return;
+  }
+  const auto state = state_for(view.GetPtr());
+  if (!state || state->dataset.empty()) {
+    return;
+  }
+
+  if (state->granularity == HighlightGranularity::BasicBlock) {
+    const auto hits = state->dataset.find(block->GetStart());
+    if (!hits || *hits == 0) {
+      return;
+    }
+    const BNHighlightColor color = state->color(*hits);
+    for (auto &line : lines) {
+      line.highlight = color;
+    }
+    return;
+  }
+
+  for (auto &line : lines) {
+    if (const auto hits = state->dataset.find(line.addr)) {
+      line.highlight = state->color(*hits);
+    }
+  }
+}
+
+} // namespace binja::covex::ui
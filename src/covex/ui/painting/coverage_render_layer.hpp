@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "binaryninjaapi.h"
+#include "covex/core/coverage_index.hpp"
+#include "covex/coverage/coverage_dataset.hpp"
+#include "covex/ui/painting/coverage_painter.hpp"
+#include "covex/ui/painting/heatmap_scale.hpp"
+
+namespace binja::covex::ui {
+
+// What the render layer draws for one view. Built once per change of trace
+// or highlight settings and never modified afterwards, so lines can be
+// coloured from any thread without locking.
+struct CoverageRenderState {
+  // Per-instruction hits, or for block granularity the hits of each covered
+  // block keyed by its start.
+  coverage::CoverageDataset dataset;
+  HighlightGranularity granularity = HighlightGranularity::Instruction;
+  bool heatmap = false;
+  uint8_t alpha = 255;
+  HeatmapScale scale;
+
+  // Block granularity colours `blocks`; instruction granularity `dataset`.
+  static std::shared_ptr<const CoverageRenderState>
+  build(const coverage::CoverageDataset &dataset,
+        const std::vector<core::CoveredBlock> &blocks,
+        HighlightGranularity granularity, bool heatmap,
+        const HeatmapSettings &settings);
+
+  BNHighlightColor color(uint64_t hits) const;
+};
+
+// Colours disassembly lines from the published state of their view while
+// they are drawn, instead of storing highlights on functions. One instance
+// serves every view.
+class CoverageRenderLayer final : public BinaryNinja::RenderLayer {
+public:
+  static void register_layer();
+  static CoverageRenderLayer *instance();
+
+  void publish(BinaryNinja::BinaryView *view,
+               std::shared_ptr<const CoverageRenderState> state);
+  void withdraw(BinaryNinja::BinaryView *view);
+
+  void ApplyToDisassemblyBlock(
+      BinaryNinja::Ref<BinaryNinja::BasicBlock> block,
+      std::vector<BinaryNinja::DisassemblyTextLine> &lines) override;
+
+private:
+  CoverageRenderLayer();
+
+  std::shared_ptr<const CoverageRenderState>
+  state_for(BinaryNinja::BinaryView *view) const;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<BNBinaryView *, std::shared_ptr<const CoverageRenderState>>
+      states_;
+};
+
+} // namespace binja::covex::ui
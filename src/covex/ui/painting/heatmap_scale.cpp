@@ -0,0 +1,152 @@
+#include "covex/ui/painting/heatmap_scale.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace binja::covex::ui {
+
+namespace {
+
+constexpr HeatmapColor kFlatColor{128, 0, 128};
+
+HeatmapColor color_at(double normalized) {
+  const double clamped = std::clamp(normalized, 0.0, 1.0);
+  const auto red = static_cast<uint8_t>(255 * clamped);
+  const auto blue = static_cast<uint8_t>(255 * (1.0 - clamped));
+  return {red, 0, blue};
+}
+
+size_t percentile_rank(size_t size, uint32_t percentile) {
+  const double fraction = static_cast<double>(percentile) / 100.0;
+  const auto idx =
+      static_cast<size_t>(fraction * static_cast<double>(size - 1));
+  return std::min(idx, size - 1);
+}
+
+// Log-linear histogram: values below 16 get their own bucket, larger ones
+// share a bucket with values of the same magnitude and top four bits.
+class QuantileSketch {
+public:
+  void add(uint64_t value) {
+    ++counts_[bucket_of(value)];
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  // Lower bound of the bucket holding the value of rank `rank`.
+  uint64_t value_at(uint64_t rank) const {
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts_.size(); ++b) {
+      seen += counts_[b];
+      if (seen > rank) {
+        return std::clamp(lower_bound_of(b), min_, max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  static constexpr unsigned kSubBits = 4;
+  static constexpr size_t kSub = size_t{1} << kSubBits;
+
+  static size_t bucket_of(uint64_t value) {
+    if (value < kSub) {
+      return static_cast<size_t>(value);
+    }
+    const unsigned exponent = 63 - std::countl_zero(value);
+    const auto sub =
+        static_cast<size_t>((value >> (exponent - kSubBits)) & (kSub - 1));
+    return kSub + (exponent - kSubBits) * kSub + sub;
+  }
+
+  static uint64_t lower_bound_of(size_t bucket) {
+    if (bucket < kSub) {
+      return bucket;
+    }
+    const size_t exponent = (bucket - kSub) / kSub + kSubBits;
+    const uint64_t sub = (bucket - kSub) % kSub;
+    return (kSub + sub) << (exponent - kSubBits);
+  }
+
+  std::array<uint64_t, kSub + (64 - kSubBits) * kSub> counts_{};
+  uint64_t min_ = std::numeric_limits<uint64_t>::max();
+  uint64_t max_ = 0;
+};
+
+} // namespace
+
+uint64_t percentile_cap_value(std::span<const uint64_t> counts,
+                              uint32_t percentile, size_t exact_limit) {
+  if (counts.empty()) {
+    return 0;
+  }
+  const size_t rank = percentile_rank(counts.size(), percentile);
+  if (counts.size() > exact_limit) {
+    QuantileSketch sketch;
+    for (const uint64_t count : counts) {
+      sketch.add(count);
+    }
+    return sketch.value_at(rank);
+  }
+  std::vector<uint64_t> scratch(counts.begin(), counts.end());
+  const auto nth = scratch.begin() + static_cast<std::ptrdiff_t>(rank);
+  std::nth_element(scratch.begin(), nth, scratch.end());
+  return *nth;
+}
+
+HeatmapScale HeatmapScale::from_counts(std::span<const uint64_t> counts,
+                                       const HeatmapSettings &settings) {
+  if (counts.empty()) {
+    return from_range(0, 0, settings.log_scale);
+  }
+  return from_range(*std::min_element(counts.begin(), counts.end()),
+                    percentile_cap_value(counts, settings.percentile_cap),
+                    settings.log_scale);
+}
+
+HeatmapScale HeatmapScale::from_range(uint64_t min_value, uint64_t cap_value,
+                                      bool log_scale) {
+  HeatmapScale scale;
+  scale.min_value = min_value;
+  scale.cap_value = cap_value;
+  scale.log_scale = log_scale;
+  if (cap_value <= min_value) {
+    scale.palette.fill(kFlatColor);
+    return scale;
+  }
+  // Bucket k covers the counts whose position on the scale rounds to
+  // k / (kBuckets - 1); its threshold is where that rounding starts.
+  const double low = log_scale ? std::log(static_cast<double>(min_value) + 1.0)
+                               : static_cast<double>(min_value);
+  const double high = log_scale
+                          ? std::log(static_cast<double>(cap_value) + 1.0)
+                          : static_cast<double>(cap_value);
+  const double steps = static_cast<double>(kBuckets - 1);
+  for (size_t k = 0; k < kBuckets; ++k) {
+    scale.palette[k] = color_at(static_cast<double>(k) / steps);
+    if (k == 0) {
+      continue;
+    }
+    const double edge =
+        low + (high - low) * (static_cast<double>(k) - 0.5) / steps;
+    const double value = std::ceil(log_scale ? std::exp(edge) - 1.0 : edge);
+    uint64_t threshold = cap_value;
+    if (value < static_cast<double>(cap_value)) {
+      threshold = static_cast<uint64_t>(std::max(value, 0.0));
+    }
+    scale.thresholds[k] = std::max(threshold, scale.thresholds[k - 1]);
+  }
+  return scale;
+}
+
+size_t HeatmapScale::bucket(uint64_t hits) const {
+  const uint64_t capped = std::min(hits, cap_value);
+  const auto it =
+      std::upper_bound(thresholds.begin(), thresholds.end(), capped);
+  return static_cast<size_t>(it - thresholds.begin()) - 1;
+}
+
+} // namespace binja::covex::ui
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace binja::covex::ui {
+
+struct HeatmapSettings {
+  uint32_t percentile_cap = 95;
+  bool log_scale = true;
+  uint8_t alpha = 255;
+};
+
+struct HeatmapColor {
+  uint8_t red = 0;
+  uint8_t green = 0;
+  uint8_t blue = 0;
+
+  friend bool operator==(const HeatmapColor &, const HeatmapColor &) = default;
+};
+
+constexpr size_t kExactPercentileLimit = size_t{1} << 24;
+
+// Value at `percentile` of `counts`, found by selection. Inputs above
+// `exact_limit` are estimated from a log-bucketed sketch instead, never
+// above the exact value and within 1/16 of it.
+uint64_t percentile_cap_value(std::span<const uint64_t> counts,
+                              uint32_t percentile,
+                              size_t exact_limit = kExactPercentileLimit);
+
+// Colour scale fixed from one set of hit counts: hits are capped at the
+// configured percentile and mapped linearly or logarithmically between the
+// smallest count and the cap, onto a palette of kBuckets colours. Colouring
+// a count is a search over the precomputed bucket thresholds.
+struct HeatmapScale {
+  static constexpr size_t kBuckets = 64;
+
+  uint64_t min_value = 0;
+  uint64_t cap_value = 0;
+  bool log_scale = true;
+  // thresholds[k] is the smallest capped count in bucket k.
+  std::array<uint64_t, kBuckets> thresholds{};
+  std::array<HeatmapColor, kBuckets> palette{};
+
+  static HeatmapScale from_counts(std::span<const uint64_t> counts,
+                                  const HeatmapSettings &settings);
+  static HeatmapScale from_range(uint64_t min_value, uint64_t cap_value,
+                                 bool log_scale);
+  size_t bucket(uint64_t hits) const;
+  HeatmapColor color(uint64_t hits) const { return palette[bucket(hits)]; }
+};
+
+} // namespace binja::covex::ui
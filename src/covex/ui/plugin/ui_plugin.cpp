@@ -1,5 +1,6 @@
 #include "binaryninjaapi.h"
 #include "covex/core/logging.hpp"
+#include "covex/ui/painting/coverage_render_layer.hpp"
 #include "covex/ui/settings/covex_settings.hpp"
 #include "covex/ui/widgets/sidebar_widget.hpp"
 #include "sidebar.h"
@@ -13,6 +14,7 @@ BN_DECLARE_UI_ABI_VERSION
 
 BINARYNINJAPLUGIN bool UIPluginInit() {
   binja::covex::ui::register_settings();
+  binja::covex::ui::CoverageRenderLayer::register_layer();
   PluginCommand::Register(
       "CovEx\\Load Coverage", "Load coverage file into CovEx",
       [](BinaryView *view) {
@@ -16,6 +16,14 @@ constexpr const char *kDiscoveryUpdateAnalysisKey =
     "covex.discovery.updateAnalysisPerFunction";
 constexpr const char *kDiscoveryRequireSegmentCodeFlagKey =
     "covex.discovery.requireSegmentCodeFlag";
+constexpr const char *kComposeCacheBudgetKey = "covex.compose.cacheBudgetMB";
+constexpr const char *kBlockNativeMappingKey = "covex.mapping.blockNative";
+constexpr const char *kShareAcrossViewsKey = "covex.mapping.shareAcrossViews";
+constexpr const char *kIndexCacheKey = "covex.mapping.indexCache";
+constexpr const char *kIndexCacheBudgetKey =
+    "covex.mapping.indexCacheBudgetMB";
+constexpr const char *kUseRenderLayerKey = "covex.rendering.useRenderLayer";
+constexpr const char *kLazyPaintingKey = "covex.rendering.lazyPainting";
 
 } // namespace
 
@@ -97,6 +105,59 @@ void register_settings() {
       "default" : false,
       "description" : "Require SegmentContainsCode in addition to SegmentExecutable."
     })json");
+  settings->RegisterSetting(kComposeCacheBudgetKey,
+                            R"json({
+      "title" : "Composition Cache Budget (MB)",
+      "type" : "number",
+      "default" : 256,
+      "description" : "Memory budget for cached composition sub-expression results. 0 disables the cache.",
+      "min" : 0,
+      "max" : 65536
+    })json");
+  settings->RegisterSetting(kBlockNativeMappingKey,
+                            R"json({
+      "title" : "Block-Native Mapping",
+      "type" : "boolean",
+      "default" : false,
+      "description" : "Keep coverage as (block start, size, hits) records instead of expanding every block into instructions. Saves memory for basic-block workflows; instruction highlights are expanded on demand. A block's hit count is then the hit count of the trace blocks overlapping it rather than the sum over its instructions, so heatmap colours and block totals differ between the modes. Applies to coverage views opened afterwards."
+    })json");
+  settings->RegisterSetting(kShareAcrossViewsKey,
+                            R"json({
+      "title" : "Share Coverage Across Open Views",
+      "type" : "boolean",
+      "default" : true,
+      "description" : "When loading a trace, also map it into every other open view whose module appears in it, in the same pass."
+    })json");
+  settings->RegisterSetting(kIndexCacheKey,
+                            R"json({
+      "title" : "Cache Mapped Coverage",
+      "type" : "boolean",
+      "default" : true,
+      "description" : "Store mapping results on disk, keyed by trace contents, binary contents and image base, so reloading an unchanged trace skips parsing and mapping. Entries live under the user directory in covex/index-cache. Loads that also map into other open views store one entry per view."
+    })json");
+  settings->RegisterSetting(kIndexCacheBudgetKey,
+                            R"json({
+      "title" : "Mapped Coverage Cache Budget (MB)",
+      "type" : "number",
+      "default" : 1024,
+      "description" : "Disk budget for the mapped coverage cache. After each store, the least recently used entries are removed until the cache fits.",
+      "min" : 0,
+      "max" : 1048576
+    })json");
+  settings->RegisterSetting(kUseRenderLayerKey,
+                            R"json({
+      "title" : "Draw Coverage With a Render Layer",
+      "type" : "boolean",
+      "default" : false,
+      "description" : "Colour covered lines while they are drawn instead of storing highlights on functions. Switching traces or highlight settings then only redraws the view. Applies to coverage views opened afterwards."
+    })json");
+  settings->RegisterSetting(kLazyPaintingKey,
+                            R"json({
+      "title" : "Paint Highlights Lazily",
+      "type" : "boolean",
+      "default" : false,
+      "description" : "Only paint highlights in the function being viewed and its neighbours, keeping a few recently viewed functions painted. Avoids long pauses on large binaries. Applies to coverage views opened afterwards."
+    })json");
 }
 
 } // namespace binja::covex::ui
@@ -46,6 +46,15 @@ void CovexSidebarWidget::notifyFontChanged() { apply_theme(); }
 
 void CovexSidebarWidget::notifyViewChanged(ViewFrame *frame) {
   m_frame = frame;
+  if (m_frame && m_controller) {
+    m_controller->notify_navigation(m_frame->getCurrentOffset());
+  }
+}
+
+void CovexSidebarWidget::notifyOffsetChanged(uint64_t offset) {
+  if (m_controller) {
+    m_controller->notify_navigation(offset);
+  }
 }
 
 void CovexSidebarWidget::set_traces(const std::vector<TraceSummary> &traces) {
@@ -100,6 +109,12 @@ void CovexSidebarWidget::clear_expression_error() {
   m_expression_error->setVisible(false);
 }
 
+void CovexSidebarWidget::refresh_rendering() {
+  if (UIContext *context = UIContext::contextForWidget(this)) {
+    context->refreshCurrentViewContents();
+  }
+}
+
 void CovexSidebarWidget::build_ui() {
   auto *layout = new QVBoxLayout(this);
   layout->setContentsMargins(8, 8, 8, 8);
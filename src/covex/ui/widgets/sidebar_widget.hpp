@@ -33,11 +33,13 @@ public:
   void notifyThemeChanged() override;
   void notifyFontChanged() override;
   void notifyViewChanged(ViewFrame *frame) override;
+  void notifyOffsetChanged(uint64_t offset) override;
 
   void set_traces(const std::vector<TraceSummary> &traces) override;
   void set_blocks(const std::vector<BlockSummary> &blocks) override;
   void show_expression_error(const std::string &message) override;
   void clear_expression_error() override;
+  void refresh_rendering() override;
 
 private:
   void build_ui();
@@ -0,0 +1,248 @@
+// Checks AddrLineScanner and parse_hex_u64 against straightforward
+// reference implementations. The scanner's classifier is chosen at compile
+// time, so this file is built once per path (see CMakeLists.txt).
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "covex/coverage/addr_line_scanner.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+using namespace binja::covex;
+using namespace binja::covex::test;
+
+struct ReferenceLine {
+  std::string_view raw;
+  std::vector<std::string_view> tokens;
+  bool blank = true;
+};
+
+bool is_space(char ch) { return (ch >= '\t' && ch <= '\r') || ch == ' '; }
+
+bool is_separator(char ch) { return is_space(ch) || ch == ',' || ch == ':'; }
+
+// Splits lines, cuts them at the first '#', ';' or "//" and splits the rest
+// at separators, one byte at a time.
+std::vector<ReferenceLine> reference_lines(std::string_view data) {
+  std::vector<ReferenceLine> lines;
+  size_t pos = 0;
+  while (pos < data.size()) {
+    size_t end = data.find('\n', pos);
+    if (end == std::string_view::npos) {
+      end = data.size();
+    }
+    ReferenceLine line;
+    line.raw = data.substr(pos, end - pos);
+    size_t cut = 0;
+    while (cut < line.raw.size() && line.raw[cut] != '#' &&
+           line.raw[cut] != ';' &&
+           !(line.raw[cut] == '/' && cut + 1 < line.raw.size() &&
+             line.raw[cut + 1] == '/')) {
+      ++cut;
+    }
+    const auto body = line.raw.substr(0, cut);
+    size_t i = 0;
+    while (i < body.size()) {
+      if (!is_space(body[i])) {
+        line.blank = false;
+      }
+      if (is_separator(body[i])) {
+        ++i;
+        continue;
+      }
+      const size_t begin = i;
+      while (i < body.size() && !is_separator(body[i])) {
+        ++i;
+      }
+      line.tokens.push_back(body.substr(begin, i - begin));
+    }
+    lines.push_back(line);
+    pos = end < data.size() ? end + 1 : data.size();
+  }
+  return lines;
+}
+
+void check_matches_reference(std::string_view data) {
+  const auto expected = reference_lines(data);
+  coverage::AddrLineScanner scanner(data);
+  coverage::ScannedLine line;
+  size_t index = 0;
+  while (scanner.next(line)) {
+    COVEX_CHECK(index < expected.size());
+    const auto &want = expected[index++];
+    COVEX_CHECK(line.raw.data() == want.raw.data());
+    COVEX_CHECK(line.raw == want.raw);
+    COVEX_CHECK(line.blank == want.blank);
+    const size_t capped =
+        std::min(want.tokens.size(), coverage::ScannedLine::kMaxTokens + 1);
+    COVEX_CHECK(line.token_count == capped);
+    for (size_t t = 0;
+         t < std::min(capped, coverage::ScannedLine::kMaxTokens); ++t) {
+      COVEX_CHECK(line.tokens[t].data() == want.tokens[t].data());
+      COVEX_CHECK(line.tokens[t] == want.tokens[t]);
+    }
+  }
+  COVEX_CHECK(index == expected.size());
+  COVEX_CHECK(scanner.position() == data.size());
+}
+
+void splits_simple_lines() {
+  const std::vector<std::string> cases = {
+      "",
+      "\n",
+      "0x401000\n",
+      "0x401000 12\n0x401010,3\r\n",
+      "  \t\n# comment only\n; another\n// and another\n",
+      "401000:2 # trailing\n401004 ; x\n401008//y\n",
+      "a b c d\n,\n:\n/ /\n",
+      "no newline at end",
+      "slash/inside token\n",
+  };
+  for (const auto &text : cases) {
+    check_matches_reference(text);
+  }
+}
+
+void splits_across_block_boundaries() {
+  // Shift every interesting byte pattern across the 64-byte block edge,
+  // and across the edge of a second block.
+  const std::vector<std::string> patterns = {
+      "401000 2\n", "a//b\n", "x #y\n", "12,34\n",   "\r\n",
+      "tok\n",      "/\n/",   "//\n",   "a b c\n", "abc",
+  };
+  for (const auto &pattern : patterns) {
+    for (size_t shift = 0; shift < 140; ++shift) {
+      // Short lines up to the pattern's, which starts with blanks.
+      std::string text(shift, ' ');
+      for (size_t i = 0; i + 1 < shift; i += 13) {
+        text[i] = 'q';
+        text[i + 1] = '\n';
+      }
+      text += pattern;
+      text += std::string(shift % 7, 'z');
+      check_matches_reference(text);
+    }
+  }
+  // A single line spanning several blocks, with a comment in the last.
+  std::string long_line(200, 'f');
+  long_line[100] = ' ';
+  long_line[150] = '#';
+  check_matches_reference(long_line + "\n1 2\n");
+}
+
+void matches_reference_on_random_input() {
+  // Raw bytes, and trace-like lines of a few fields, separators and
+  // comment markers (so lines rarely hit the token cap).
+  static constexpr char kAlphabet[] = "0123456789abcdefxX \t\r\n,:#;/gz";
+  static const std::vector<std::string> kPieces = {
+      "0x401000", "1f", "7",  " ",  "\t", "  ", ",", ":", "\r",
+      "\n",      "\n", "#", ";",  "//", "/",  "a/b"};
+  std::mt19937_64 random(3);
+  for (size_t round = 0; round < 4000; ++round) {
+    std::string text(random() % 400, ' ');
+    for (auto &ch : text) {
+      ch = kAlphabet[random() % (sizeof(kAlphabet) - 1)];
+    }
+    check_matches_reference(text);
+
+    text.clear();
+    const size_t pieces = random() % 120;
+    for (size_t i = 0; i < pieces; ++i) {
+      text += kPieces[random() % kPieces.size()];
+    }
+    check_matches_reference(text);
+  }
+}
+
+// Strict reference: optional 0x prefix (only in front of digits), hex
+// digits only, at most 64 significant bits.
+bool reference_parse_hex(std::string_view text, uint64_t &out) {
+  if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+    text.remove_prefix(2);
+  }
+  if (text.empty()) {
+    return false;
+  }
+  uint64_t value = 0;
+  for (const char ch : text) {
+    uint64_t digit = 0;
+    if (ch >= '0' && ch <= '9') {
+      digit = static_cast<uint64_t>(ch - '0');
+    } else if (ch >= 'a' && ch <= 'f') {
+      digit = static_cast<uint64_t>(ch - 'a' + 10);
+    } else if (ch >= 'A' && ch <= 'F') {
+      digit = static_cast<uint64_t>(ch - 'A' + 10);
+    } else {
+      return false;
+    }
+    if (value >> 60 != 0) {
+      // Only a value of zero so far may take more digits.
+      return false;
+    }
+    value = (value << 4) | digit;
+  }
+  out = value;
+  return true;
+}
+
+void parses_hex_like_reference() {
+  const std::vector<std::string> cases = {
+      "0",
+      "0x",
+      "0x0",
+      "0X1f",
+      "ffffffffffffffff",
+      "0xffffffffffffffff",
+      "10000000000000000",
+      "00000000000000000000001",
+      "0x00000000000000000ffffffffffffffff",
+      "12g",
+      "-1",
+      "",
+      "x10",
+  };
+  for (const auto &text : cases) {
+    uint64_t got = 0;
+    uint64_t want = 0;
+    const bool ok = coverage::parse_hex_u64(text, got);
+    COVEX_CHECK(ok == reference_parse_hex(text, want));
+    COVEX_CHECK(!ok || got == want);
+  }
+  static constexpr char kAlphabet[] = "00000123456789abcdefABCDEFxXg";
+  std::mt19937_64 random(5);
+  for (size_t round = 0; round < 20000; ++round) {
+    std::string text(random() % 24, '0');
+    for (auto &ch : text) {
+      ch = kAlphabet[random() % (sizeof(kAlphabet) - 1)];
+    }
+    uint64_t got = 0;
+    uint64_t want = 0;
+    const bool ok = coverage::parse_hex_u64(text, got);
+    COVEX_CHECK(ok == reference_parse_hex(text, want));
+    COVEX_CHECK(!ok || got == want);
+  }
+}
+
+} // namespace
+
+int main() {
+#if defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__))
+  if (!__builtin_cpu_supports("avx2")) {
+    std::printf("[skip] host has no AVX2\n");
+    return 0;
+  }
+#endif
+  return run_tests({
+      {"splits_simple_lines", splits_simple_lines},
+      {"splits_across_block_boundaries", splits_across_block_boundaries},
+      {"matches_reference_on_random_input", matches_reference_on_random_input},
+      {"parses_hex_like_reference", parses_hex_like_reference},
+  });
+}
@@ -0,0 +1,137 @@
+// Checks AddrTraceReader end to end: randomly formatted traces must read
+// back as the hits they were generated from, sequentially and in chunks.
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "covex/coverage/addr_trace_reader.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+using namespace binja::covex;
+using namespace binja::covex::test;
+
+struct GeneratedTrace {
+  std::string text;
+  std::map<uint64_t, uint64_t> hits;
+  bool explicit_hits = false;
+};
+
+std::string to_hex(uint64_t value, bool upper) {
+  static constexpr char kLower[] = "0123456789abcdef";
+  static constexpr char kUpper[] = "0123456789ABCDEF";
+  std::string digits;
+  do {
+    digits.insert(digits.begin(), (upper ? kUpper : kLower)[value & 0xf]);
+    value >>= 4;
+  } while (value != 0);
+  return digits;
+}
+
+// Entries in every formatting the reader accepts: optional 0x prefix and
+// leading zeros, any separator, trailing comments, blank and comment-only
+// lines, CRLF endings and a missing final newline.
+GeneratedTrace generate(std::mt19937_64 &random, size_t lines) {
+  static const char *const kSeparators[] = {" ", "\t", ",", ":", " , ", "  "};
+  static const char *const kComments[] = {"", "", "", " # note", ";x",
+                                          "//seen"};
+  GeneratedTrace trace;
+  for (size_t i = 0; i < lines; ++i) {
+    switch (random() % 10) {
+    case 0:
+      trace.text += "   \t";
+      break;
+    case 1:
+      trace.text += "# comment line";
+      break;
+    default: {
+      const uint64_t addr = 0x400000 + (random() % 512) * 4;
+      std::string field = to_hex(addr, random() % 2 == 0);
+      if (random() % 3 == 0) {
+        field.insert(0, std::string(random() % 4, '0'));
+      }
+      if (random() % 2 == 0) {
+        field.insert(0, random() % 2 == 0 ? "0x" : "0X");
+      }
+      trace.text += field;
+      uint64_t count = 1;
+      if (random() % 2 == 0) {
+        count = random() % 300 + 1;
+        trace.text += kSeparators[random() % 6];
+        trace.text += to_hex(count, false);
+        trace.explicit_hits = true;
+      }
+      trace.text += kComments[random() % 6];
+      trace.hits[addr] += count;
+      break;
+    }
+    }
+    if (i + 1 < lines || random() % 2 == 0) {
+      trace.text += random() % 4 == 0 ? "\r\n" : "\n";
+    }
+  }
+  return trace;
+}
+
+std::filesystem::path write_temp(const std::string &name,
+                                 const std::string &text) {
+  const auto path = std::filesystem::temp_directory_path() / name;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << text;
+  return path;
+}
+
+void reads_generated_traces() {
+  std::mt19937_64 random(17);
+  for (size_t round = 0; round < 200; ++round) {
+    const auto generated = generate(random, random() % 2000 + 1);
+    const auto path =
+        write_temp("covex_addr_trace_reader_tests.txt", generated.text);
+    const auto source = coverage::CoverageSource::open(path.string());
+    for (const size_t threads : {size_t{1}, size_t{4}}) {
+      const auto trace = coverage::AddrTraceReader::read(source, threads);
+      COVEX_CHECK(trace.has_hitcounts == generated.explicit_hits);
+      std::map<uint64_t, uint64_t> got;
+      for (const auto &span : trace.spans) {
+        COVEX_CHECK(span.size == 1);
+        got[span.address] += span.hits;
+      }
+      COVEX_CHECK(got == generated.hits);
+    }
+    std::filesystem::remove(path);
+  }
+}
+
+void rejects_invalid_lines() {
+  for (const std::string text :
+       {"401000\nnot-hex\n", "401000 1 2\n", "0x\n", "401000 zz\n",
+        "10000000000000000\n"}) {
+    const auto path = write_temp("covex_addr_trace_reader_bad.txt", text);
+    const auto source = coverage::CoverageSource::open(path.string());
+    for (const size_t threads : {size_t{1}, size_t{2}}) {
+      bool threw = false;
+      try {
+        coverage::AddrTraceReader::read(source, threads);
+      } catch (const std::runtime_error &) {
+        threw = true;
+      }
+      COVEX_CHECK(threw);
+    }
+    std::filesystem::remove(path);
+  }
+}
+
+} // namespace
+
+int main() {
+  return run_tests({
+      {"reads_generated_traces", reads_generated_traces},
+      {"rejects_invalid_lines", rejects_invalid_lines},
+  });
+}
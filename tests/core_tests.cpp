@@ -0,0 +1,304 @@
+// Headless checks for the mapping core, run against SyntheticViewOracle.
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "covex/core/coverage_mapper.hpp"
+#include "covex/core/index_cache.hpp"
+#include "covex/core/synthetic_view_oracle.hpp"
+#include "covex/coverage/coverage_expression.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+using namespace binja::covex;
+using namespace binja::covex::test;
+
+void shared_block_hits_do_not_depend_on_dataset_size() {
+  // f1 also owns f0's first block. Small datasets ask the view per address
+  // and large ones sweep a block index; both count the block once.
+  auto view = make_view();
+  view.add_block(0x2000, 0x2010, 0x2100);
+  core::CoverageMapper mapper;
+  for (const size_t padding : {size_t{0}, size_t{5000}}) {
+    std::vector<uint64_t> addresses = {0x2000, 0x2004};
+    for (size_t i = 0; i < padding; ++i) {
+      addresses.push_back(0x10000 + i * 4);
+    }
+    const std::vector<uint64_t> hits(addresses.size(), 3);
+    const auto index = mapper.map_dataset(
+        coverage::CoverageDataset::from_sorted(addresses, hits), view);
+    COVEX_CHECK(index.blocks.size() == 1);
+    COVEX_CHECK(index.blocks[0].start == 0x2000);
+    COVEX_CHECK(index.blocks[0].hits == 6);
+    COVEX_CHECK(index.blocks[0].function == "f0");
+  }
+}
+
+void block_native_covers_every_overlapped_block() {
+  const auto view = make_view();
+  auto trace = make_trace();
+  trace.spans.push_back(span_at(0x2000, 0x30, 2));
+
+  core::CoverageMapper mapper;
+  const auto index = mapper.map_trace_blocks(trace, view);
+  COVEX_CHECK(index.block_native);
+  COVEX_CHECK(index.dataset.size() == 3);
+  COVEX_CHECK(index.blocks.size() == 3);
+  for (const auto &block : index.blocks) {
+    COVEX_CHECK(block.hits == 2);
+  }
+  const auto expanded = mapper.expand_instructions(index, view);
+  COVEX_CHECK(expanded.size() == 12);
+}
+
+void block_native_composes_offset_blocks() {
+  // A's trace block spans two view blocks; B's covers only the second.
+  const auto view = make_view();
+  auto trace_a = make_trace();
+  trace_a.spans.push_back(span_at(0x2000, 0x20, 1));
+  auto trace_b = make_trace();
+  trace_b.spans.push_back(span_at(0x2010, 0x10, 1));
+
+  core::CoverageMapper mapper;
+  const auto blocks_a = mapper.map_trace_blocks(trace_a, view);
+  const auto blocks_b = mapper.map_trace_blocks(trace_b, view);
+  const auto instructions_a = mapper.map_trace(trace_a, view);
+  const auto instructions_b = mapper.map_trace(trace_b, view);
+  using coverage::CompositionOp;
+  using coverage::HitMergePolicy;
+  for (const auto op : {CompositionOp::Intersection, CompositionOp::Subtract,
+                        CompositionOp::Union}) {
+    const auto by_block = coverage::compose(
+        blocks_a.dataset, blocks_b.dataset, op, HitMergePolicy::Left);
+    const auto by_instruction =
+        coverage::compose(instructions_a.dataset, instructions_b.dataset, op,
+                          HitMergePolicy::Left);
+    std::vector<core::BlockSpan> extents = blocks_a.block_spans;
+    extents.insert(extents.end(), blocks_b.block_spans.begin(),
+                   blocks_b.block_spans.end());
+    const auto composed = mapper.map_block_dataset(
+        by_block, core::CoverageMapper::merge_block_spans(extents), view);
+    const auto expanded = mapper.expand_instructions(composed, view);
+    COVEX_CHECK(expanded.size() == by_instruction.size());
+    for (size_t i = 0; i < expanded.size(); ++i) {
+      COVEX_CHECK(expanded.addresses()[i] == by_instruction.addresses()[i]);
+    }
+  }
+  const auto both =
+      coverage::compose(blocks_a.dataset, blocks_b.dataset,
+                        CompositionOp::Intersection, HitMergePolicy::Min);
+  COVEX_CHECK(both.size() == 1);
+  COVEX_CHECK(both.addresses()[0] == 0x2010);
+}
+
+void block_native_rounds_to_overlapping_blocks() {
+  // The view has a block nested in a larger one; a span covering both
+  // becomes two pieces and the outer block takes its hottest piece.
+  core::SyntheticViewOracle view(kImageBase, 0x100000, kImageBase);
+  view.set_original_filename("/bin/target");
+  view.add_segment({kImageBase, 0x100000, true, true, false});
+  view.add_function(0x2000, "outer");
+  view.add_function(0x2010, "inner");
+  view.add_block(0x2000, 0x2020, 0x2000);
+  view.add_block(0x2010, 0x2020, 0x2010);
+  auto trace = make_trace();
+  trace.spans.push_back(span_at(0x2000, 0x30, 3));
+  // A trace block starting inside a view block claims the whole block.
+  trace.spans.push_back(span_at(0x2018, 0x8, 2));
+
+  core::CoverageMapper mapper;
+  const auto index = mapper.map_trace_blocks(trace, view);
+  COVEX_CHECK(index.block_spans.size() == 3);
+  COVEX_CHECK(index.dataset.find(0x2010) == 5u);
+  COVEX_CHECK(index.block_spans[0].start == 0x2000);
+  COVEX_CHECK(index.block_spans[0].size == 0x10);
+  COVEX_CHECK(index.block_spans[1].start == 0x2010);
+  // Past the last block the span keeps its own bounds.
+  COVEX_CHECK(index.block_spans[2].start == 0x2020);
+  COVEX_CHECK(index.block_spans[2].size == 0x10);
+  COVEX_CHECK(index.blocks.size() == 2);
+  COVEX_CHECK(index.blocks[0].hits == 5);
+  COVEX_CHECK(index.blocks[1].hits == 5);
+}
+
+void shared_address_trace_keeps_first_view() {
+  core::SyntheticViewOracle first(0x400000, 0x500000, 0x400000);
+  core::SyntheticViewOracle overlapping(0x3ff000, 0x401000, 0x3ff000);
+  core::SyntheticViewOracle disjoint(0x900000, 0x910000, 0x900000);
+  coverage::CoverageTrace trace;
+  for (const uint64_t addr : {0x400000ull, 0x400800ull, 0x900000ull}) {
+    coverage::CoverageSpan span;
+    span.address = addr;
+    span.size = 4;
+    span.hits = 1;
+    trace.spans.push_back(span);
+  }
+
+  core::CoverageMapper mapper;
+  const auto alone = mapper.map_trace(trace, first);
+  const auto shared =
+      mapper.map_trace_targets(trace, {&first, &overlapping, &disjoint});
+  COVEX_CHECK(shared.size() == 3);
+  COVEX_CHECK(shared[0].dataset.size() == alone.dataset.size());
+  COVEX_CHECK(shared[1].dataset.empty());
+  COVEX_CHECK(shared[0].dataset.size() == 2);
+  COVEX_CHECK(shared[2].dataset.size() == 1);
+}
+
+void index_cache_rederives_blocks() {
+  const auto view = make_view();
+  auto trace = make_trace();
+  trace.spans.push_back(span_at(0x2000, 0x20, 5));
+  trace.spans.push_back(span_at(0x7fffff0, 0x4, 1));
+
+  core::CoverageMapper mapper;
+  const auto index = mapper.map_trace(trace, view);
+  const auto directory =
+      std::filesystem::temp_directory_path() / "covex_core_tests_cache";
+  std::filesystem::remove_all(directory);
+  core::IndexCache cache(directory);
+  const core::IndexCacheKey key{1, 2, kImageBase, false};
+  cache.store(key, trace, index);
+
+  auto cached = cache.load(key);
+  COVEX_CHECK(cached.has_value());
+  COVEX_CHECK(cached->index.blocks.empty());
+  COVEX_CHECK(cached->index.dataset.size() == index.dataset.size());
+  COVEX_CHECK(cached->index.invalid.count() == index.invalid.count());
+
+  // The view was re-analysed since the entry was stored.
+  auto renamed = make_view();
+  renamed.add_function(0x2000, "renamed");
+  mapper.derive_blocks(cached->index, renamed);
+  COVEX_CHECK(cached->index.blocks.size() == index.blocks.size());
+  COVEX_CHECK(cached->index.blocks[0].function == "renamed");
+  COVEX_CHECK(cached->index.blocks[0].hits == index.blocks[0].hits);
+  std::filesystem::remove_all(directory);
+}
+
+void index_cache_keys_peers_and_prunes() {
+  const auto view = make_view();
+  auto trace = make_trace();
+  trace.spans.push_back(span_at(0x2000, 0x20, 5));
+  core::CoverageMapper mapper;
+  const auto index = mapper.map_trace(trace, view);
+  const auto directory =
+      std::filesystem::temp_directory_path() / "covex_core_tests_prune";
+  std::filesystem::remove_all(directory);
+  core::IndexCache cache(directory);
+
+  // A view mapped alone and the same view mapped with a peer are distinct
+  // entries.
+  std::vector<core::IndexCacheKey> alone{{1, 2, kImageBase, false}};
+  core::IndexCache::link_peers(alone);
+  COVEX_CHECK(alone[0].peers_hash == 0);
+  std::vector<core::IndexCacheKey> pass{{1, 2, kImageBase, false},
+                                        {1, 3, 0x8000, false}};
+  core::IndexCache::link_peers(pass);
+  COVEX_CHECK(pass[0].peers_hash != 0);
+  COVEX_CHECK(pass[0].peers_hash != pass[1].peers_hash);
+  cache.store(pass[0], trace, index);
+  const core::CoverageIndex nothing;
+  cache.store(pass[1], trace, nothing);
+  COVEX_CHECK(!cache.load(alone[0]).has_value());
+  COVEX_CHECK(cache.load(pass[0])->index.dataset.size() ==
+              index.dataset.size());
+  COVEX_CHECK(cache.load(pass[1])->index.dataset.empty());
+
+  // Oldest first: pass[1], then alone, then pass[0]; loading alone makes it
+  // the most recently used.
+  cache.store(alone[0], trace, index);
+  const auto now = std::filesystem::file_time_type::clock::now();
+  std::filesystem::last_write_time(cache.path_for(pass[1]),
+                                   now - std::chrono::hours(3));
+  std::filesystem::last_write_time(cache.path_for(alone[0]),
+                                   now - std::chrono::hours(2));
+  std::filesystem::last_write_time(cache.path_for(pass[0]),
+                                   now - std::chrono::hours(1));
+  COVEX_CHECK(cache.load(alone[0]).has_value());
+  const auto entry_size = std::filesystem::file_size(cache.path_for(pass[0]));
+  cache.prune(entry_size);
+  COVEX_CHECK(!std::filesystem::exists(cache.path_for(pass[1])));
+  COVEX_CHECK(!std::filesystem::exists(cache.path_for(pass[0])));
+  COVEX_CHECK(std::filesystem::exists(cache.path_for(alone[0])));
+  cache.prune(0);
+  COVEX_CHECK(std::filesystem::is_empty(directory));
+  std::filesystem::remove_all(directory);
+}
+
+void expression_matches_pairwise_composition() {
+  // B is far smaller than A and C, so its intersection and subtraction are
+  // joined by galloping while the union is fused.
+  std::vector<uint64_t> wide;
+  std::vector<uint64_t> wide_hits;
+  for (uint64_t addr = 0; addr < 4096; addr += 2) {
+    wide.push_back(addr);
+    wide_hits.push_back(addr % 7 + 1);
+  }
+  std::unordered_map<std::string, coverage::CoverageDataset> datasets;
+  datasets["A"] = coverage::CoverageDataset::from_sorted(wide, wide_hits);
+  datasets["B"] =
+      coverage::CoverageDataset::from_sorted({4, 5, 100}, {9, 9, 9});
+  datasets["C"] = coverage::CoverageDataset::from_sorted(
+      std::vector<uint64_t>(wide.begin() + 1, wide.end()),
+      std::vector<uint64_t>(wide_hits.begin() + 1, wide_hits.end()));
+
+  using coverage::CompositionOp;
+  using coverage::HitMergePolicy;
+  const auto &a = datasets["A"];
+  const auto &b = datasets["B"];
+  const auto &c = datasets["C"];
+  const auto a_or_c =
+      coverage::compose(a, c, CompositionOp::Union, HitMergePolicy::Sum);
+  const std::vector<std::pair<const char *, coverage::CoverageDataset>>
+      cases = {
+          {"(A | C) & B",
+           coverage::compose(a_or_c, b, CompositionOp::Intersection,
+                             HitMergePolicy::Min)},
+          {"(A | C) - B", coverage::compose(a_or_c, b, CompositionOp::Subtract,
+                                            HitMergePolicy::Left)},
+          {"A & B | C",
+           coverage::compose(coverage::compose(a, b,
+                                               CompositionOp::Intersection,
+                                               HitMergePolicy::Min),
+                             c, CompositionOp::Union, HitMergePolicy::Sum)},
+      };
+
+  for (const auto &[text, expected] : cases) {
+    const auto parsed = coverage::parse_expression(text);
+    const auto &plan = std::get<coverage::ComposePlan>(parsed);
+    const auto result = coverage::evaluate_expression(plan, datasets);
+    const auto &got = std::get<coverage::CoverageDataset>(result);
+    COVEX_CHECK(got.size() == expected.size());
+    for (size_t i = 0; i < got.size(); ++i) {
+      COVEX_CHECK(got.addresses()[i] == expected.addresses()[i]);
+      COVEX_CHECK(got.hit_counts()[i] == expected.hit_counts()[i]);
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  return run_tests({
+      {"shared_block_hits_do_not_depend_on_dataset_size",
+       shared_block_hits_do_not_depend_on_dataset_size},
+      {"block_native_covers_every_overlapped_block",
+       block_native_covers_every_overlapped_block},
+      {"block_native_composes_offset_blocks",
+       block_native_composes_offset_blocks},
+      {"block_native_rounds_to_overlapping_blocks",
+       block_native_rounds_to_overlapping_blocks},
+      {"shared_address_trace_keeps_first_view",
+       shared_address_trace_keeps_first_view},
+      {"index_cache_rederives_blocks", index_cache_rederives_blocks},
+      {"index_cache_keys_peers_and_prunes", index_cache_keys_peers_and_prunes},
+      {"expression_matches_pairwise_composition",
+       expression_matches_pairwise_composition},
+  });
+}
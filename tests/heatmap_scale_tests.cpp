@@ -0,0 +1,214 @@
+// Checks HeatmapScale buckets against direct rounding of each count's
+// position on the scale, and the sketch path of percentile_cap_value against
+// exact selection.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "covex/ui/painting/heatmap_scale.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+using namespace binja::covex;
+using namespace binja::covex::test;
+
+using ui::HeatmapColor;
+using ui::HeatmapScale;
+
+constexpr size_t kLastBucket = HeatmapScale::kBuckets - 1;
+
+double scale_position(uint64_t value, bool log_scale) {
+  const auto as_double = static_cast<double>(value);
+  return log_scale ? std::log(as_double + 1.0) : as_double;
+}
+
+// Bucket of `hits` by rounding its position between min and cap, or
+// nothing when the position sits too close to a rounding edge to tell.
+bool reference_bucket(uint64_t min_value, uint64_t cap_value, bool log_scale,
+                      uint64_t hits, size_t &bucket) {
+  const double low = scale_position(min_value, log_scale);
+  const double high = scale_position(cap_value, log_scale);
+  const double capped =
+      scale_position(std::clamp(hits, min_value, cap_value), log_scale);
+  const double steps =
+      (capped - low) / (high - low) * static_cast<double>(kLastBucket);
+  const double fraction = steps - std::floor(steps);
+  if (std::abs(fraction - 0.5) < 1e-9) {
+    return false;
+  }
+  bucket = static_cast<size_t>(std::lround(steps));
+  return true;
+}
+
+uint64_t exact_percentile(std::vector<uint64_t> counts, uint32_t percentile) {
+  std::sort(counts.begin(), counts.end());
+  const auto rank = static_cast<size_t>(
+      static_cast<double>(percentile) / 100.0 *
+      static_cast<double>(counts.size() - 1));
+  return counts[std::min(rank, counts.size() - 1)];
+}
+
+void check_scale(uint64_t min_value, uint64_t cap_value, bool log_scale,
+                 const std::vector<uint64_t> &samples) {
+  const auto scale = HeatmapScale::from_range(min_value, cap_value, log_scale);
+  size_t previous = 0;
+  for (const uint64_t hits : samples) {
+    const size_t bucket = scale.bucket(hits);
+    COVEX_CHECK(bucket <= kLastBucket);
+    COVEX_CHECK(scale.color(hits) == scale.palette[bucket]);
+    size_t expected = 0;
+    if (reference_bucket(min_value, cap_value, log_scale, hits, expected)) {
+      COVEX_CHECK(bucket == expected);
+    }
+    COVEX_CHECK(bucket >= previous);
+    previous = bucket;
+  }
+  COVEX_CHECK(scale.bucket(min_value) == 0);
+  COVEX_CHECK(scale.bucket(cap_value) == kLastBucket);
+  COVEX_CHECK(scale.bucket(cap_value + 1) == kLastBucket);
+  COVEX_CHECK(scale.bucket(UINT64_MAX) == kLastBucket);
+}
+
+void buckets_match_rounded_position() {
+  struct Case {
+    uint64_t min_value;
+    uint64_t cap_value;
+    bool log_scale;
+  };
+  const Case cases[] = {
+      {0, 1, false},        {0, 1, true},           {0, 63, false},
+      {0, 63, true},        {1, 100, false},        {1, 100, true},
+      {7, 10007, false},    {7, 10007, true},       {0, 1u << 20, true},
+      {1000, 1001, false},  {5, 1ull << 40, true},  {3, 1ull << 40, false},
+  };
+  std::mt19937_64 rng(23);
+  for (const Case &c : cases) {
+    std::vector<uint64_t> samples;
+    const uint64_t span = c.cap_value - c.min_value;
+    for (uint64_t v = 0; v <= std::min<uint64_t>(span, 4096); ++v) {
+      samples.push_back(c.min_value + v);
+    }
+    std::uniform_int_distribution<uint64_t> pick(c.min_value, c.cap_value);
+    for (int i = 0; i < 4096; ++i) {
+      samples.push_back(pick(rng));
+    }
+    std::sort(samples.begin(), samples.end());
+    check_scale(c.min_value, c.cap_value, c.log_scale, samples);
+  }
+}
+
+void palette_runs_blue_to_red() {
+  for (const bool log_scale : {false, true}) {
+    const auto scale = HeatmapScale::from_range(2, 500, log_scale);
+    COVEX_CHECK((scale.palette.front() == HeatmapColor{0, 0, 255}));
+    COVEX_CHECK((scale.palette.back() == HeatmapColor{255, 0, 0}));
+    for (size_t k = 1; k < HeatmapScale::kBuckets; ++k) {
+      COVEX_CHECK(scale.palette[k].red >= scale.palette[k - 1].red);
+      COVEX_CHECK(scale.palette[k].blue <= scale.palette[k - 1].blue);
+      COVEX_CHECK(scale.palette[k].green == 0);
+    }
+  }
+}
+
+void empty_range_is_flat() {
+  for (const auto &[min_value, cap_value] :
+       {std::pair<uint64_t, uint64_t>{0, 0}, {9, 9}, {10, 3}}) {
+    const auto scale = HeatmapScale::from_range(min_value, cap_value, true);
+    for (const uint64_t hits : {uint64_t{0}, min_value, cap_value,
+                                uint64_t{1} << 30}) {
+      COVEX_CHECK((scale.color(hits) == HeatmapColor{128, 0, 128}));
+    }
+  }
+  const auto scale = HeatmapScale::from_counts({}, ui::HeatmapSettings{});
+  COVEX_CHECK(scale.min_value == 0);
+  COVEX_CHECK(scale.cap_value == 0);
+}
+
+void from_counts_uses_min_and_percentile() {
+  std::vector<uint64_t> counts;
+  for (uint64_t v = 200; v >= 4; --v) {
+    counts.push_back(v * 3);
+  }
+  for (const uint32_t percentile : {0u, 50u, 95u, 100u}) {
+    ui::HeatmapSettings settings;
+    settings.percentile_cap = percentile;
+    settings.log_scale = percentile % 2 == 0;
+    const auto scale = HeatmapScale::from_counts(counts, settings);
+    COVEX_CHECK(scale.min_value == 12);
+    COVEX_CHECK(scale.cap_value == exact_percentile(counts, percentile));
+    COVEX_CHECK(scale.log_scale == settings.log_scale);
+  }
+}
+
+// The sketch keeps values below 16 exact and otherwise answers with the
+// lower bound of a bucket 1/16 as wide as its start, so it never overshoots
+// and undershoots by less than a sixteenth.
+void check_sketch(const std::vector<uint64_t> &counts) {
+  const auto [low, high] = std::minmax_element(counts.begin(), counts.end());
+  for (const uint32_t percentile : {0u, 1u, 25u, 50u, 90u, 95u, 99u, 100u}) {
+    const uint64_t exact = exact_percentile(counts, percentile);
+    COVEX_CHECK(ui::percentile_cap_value(counts, percentile) == exact);
+    const uint64_t sketched = ui::percentile_cap_value(counts, percentile, 0);
+    COVEX_CHECK(sketched <= exact);
+    COVEX_CHECK(exact - sketched <= exact / 16);
+    COVEX_CHECK(sketched >= *low);
+    COVEX_CHECK(sketched <= *high);
+    if (exact < 16) {
+      COVEX_CHECK(sketched == exact);
+    }
+  }
+}
+
+void sketch_stays_within_a_sixteenth() {
+  std::mt19937_64 rng(2023);
+  check_sketch({0});
+  check_sketch({UINT64_MAX});
+  check_sketch({17, 17, 17});
+  check_sketch({0, 1, 2, 3, 15, 16, 17, 31, 32, 33});
+
+  std::vector<uint64_t> small;
+  std::uniform_int_distribution<uint64_t> tiny(0, 20);
+  for (int i = 0; i < 1000; ++i) {
+    small.push_back(tiny(rng));
+  }
+  check_sketch(small);
+
+  std::vector<uint64_t> skewed;
+  std::geometric_distribution<uint64_t> geometric(0.001);
+  for (int i = 0; i < 20000; ++i) {
+    skewed.push_back(geometric(rng));
+  }
+  check_sketch(skewed);
+
+  for (int round = 0; round < 50; ++round) {
+    std::vector<uint64_t> wide;
+    const int count = 1 + static_cast<int>(rng() % 2000);
+    for (int i = 0; i < count; ++i) {
+      wide.push_back(rng() >> (rng() % 64));
+    }
+    check_sketch(wide);
+  }
+}
+
+void sketch_handles_empty_input() {
+  COVEX_CHECK(ui::percentile_cap_value({}, 95) == 0);
+  COVEX_CHECK(ui::percentile_cap_value({}, 95, 0) == 0);
+}
+
+} // namespace
+
+int main() {
+  return run_tests({
+      {"buckets_match_rounded_position", buckets_match_rounded_position},
+      {"palette_runs_blue_to_red", palette_runs_blue_to_red},
+      {"empty_range_is_flat", empty_range_is_flat},
+      {"from_counts_uses_min_and_percentile",
+       from_counts_uses_min_and_percentile},
+      {"sketch_stays_within_a_sixteenth", sketch_stays_within_a_sixteenth},
+      {"sketch_handles_empty_input", sketch_handles_empty_input},
+  });
+}
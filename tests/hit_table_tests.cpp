@@ -0,0 +1,184 @@
+// Checks HitTable against std::unordered_map through growth, the all-ones
+// key and merging.
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "covex/coverage/hit_table.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+using namespace binja::covex;
+using namespace binja::covex::test;
+
+using Reference = std::unordered_map<uint64_t, uint64_t>;
+
+constexpr uint64_t kAllOnes = coverage::HitTable::kEmptyKey;
+
+// Same entries, each visited once, and the load factor stays at or below
+// 3/4 of a power-of-two slot array.
+void check_table(const coverage::HitTable &table, const Reference &reference) {
+  COVEX_CHECK(table.size() == reference.size());
+  COVEX_CHECK(table.empty() == reference.empty());
+  Reference seen;
+  for (const auto &[key, value] : table) {
+    COVEX_CHECK(seen.emplace(key, value).second);
+  }
+  COVEX_CHECK(seen == reference);
+  for (const auto &[key, value] : reference) {
+    const auto it = table.find(key);
+    COVEX_CHECK(it != table.end());
+    COVEX_CHECK(it->second == value);
+    COVEX_CHECK(table.contains(key));
+  }
+  const size_t slotted = table.size() - (reference.count(kAllOnes) ? 1 : 0);
+  COVEX_CHECK(table.capacity() == 0 || std::has_single_bit(table.capacity()));
+  COVEX_CHECK(slotted * 4 <= table.capacity() * 3);
+}
+
+void grows_like_a_map() {
+  // Strided keys share their low bits, sequential ones their high bits.
+  std::mt19937_64 random(23);
+  coverage::HitTable table;
+  Reference reference;
+  for (size_t i = 0; i < 100000; ++i) {
+    uint64_t key = 0;
+    switch (i % 4) {
+    case 0:
+      key = random() % 4096;
+      break;
+    case 1:
+      key = (random() % 4096) << 32;
+      break;
+    case 2:
+      key = 0x400000 + (random() % 50000) * 4;
+      break;
+    default:
+      key = random();
+      break;
+    }
+    const uint64_t count = random() % 9 + 1;
+    table[key] += count;
+    reference[key] += count;
+    if (i % 9973 == 0) {
+      check_table(table, reference);
+    }
+  }
+  check_table(table, reference);
+  COVEX_CHECK(!table.contains(kAllOnes));
+  COVEX_CHECK(table.find(kAllOnes) == table.end());
+  for (size_t i = 0; i < 1000; ++i) {
+    const uint64_t key = random();
+    COVEX_CHECK(table.contains(key) == (reference.count(key) != 0));
+  }
+}
+
+void stores_the_all_ones_key() {
+  coverage::HitTable table;
+  COVEX_CHECK(!table.contains(kAllOnes));
+  table[kAllOnes] += 5;
+  COVEX_CHECK(table.size() == 1);
+  COVEX_CHECK(table.begin()->first == kAllOnes);
+  COVEX_CHECK(table.begin()->second == 5);
+
+  // It survives growth and is visited last.
+  Reference reference{{kAllOnes, 5}};
+  for (uint64_t key = 0; key < 1000; ++key) {
+    table[key] = key + 1;
+    reference[key] = key + 1;
+  }
+  table[kAllOnes] += 2;
+  reference[kAllOnes] += 2;
+  check_table(table, reference);
+  uint64_t last = 0;
+  for (const auto &[key, value] : table) {
+    (void)value;
+    last = key;
+  }
+  COVEX_CHECK(last == kAllOnes);
+  COVEX_CHECK(!table.emplace(kAllOnes, 1).second);
+  COVEX_CHECK(table.find(kAllOnes)->second == 7);
+
+  table.clear();
+  COVEX_CHECK(table.empty());
+  COVEX_CHECK(!table.contains(kAllOnes));
+  COVEX_CHECK(table.begin() == table.end());
+}
+
+void emplace_keeps_existing_values() {
+  coverage::HitTable table;
+  COVEX_CHECK(table.emplace(10, 1).second);
+  const auto [it, inserted] = table.emplace(10, 99);
+  COVEX_CHECK(!inserted);
+  COVEX_CHECK(it->first == 10);
+  COVEX_CHECK(it->second == 1);
+  COVEX_CHECK(table.emplace(0, 0).second);
+  COVEX_CHECK(table.contains(0));
+}
+
+void reserve_avoids_rehashing() {
+  coverage::HitTable table;
+  table.reserve(5000);
+  const size_t capacity = table.capacity();
+  COVEX_CHECK(capacity * 3 >= 5000 * 4);
+  for (uint64_t key = 0; key < 5000; ++key) {
+    table[key * 4096] = 1;
+  }
+  COVEX_CHECK(table.capacity() == capacity);
+  COVEX_CHECK(table.size() == 5000);
+}
+
+void merges_like_a_map() {
+  std::mt19937_64 random(29);
+  coverage::HitTable left;
+  coverage::HitTable right;
+  Reference sum;
+  Reference left_ref;
+  Reference right_ref;
+  for (size_t i = 0; i < 20000; ++i) {
+    const uint64_t key = random() % 30000;
+    const uint64_t count = random() % 100 + 1;
+    auto &table = i % 3 == 0 ? left : right;
+    auto &reference = i % 3 == 0 ? left_ref : right_ref;
+    table[key] += count;
+    reference[key] += count;
+    sum[key] += count;
+  }
+  right[kAllOnes] = 4;
+  right_ref[kAllOnes] = 4;
+  sum[kAllOnes] = 4;
+
+  coverage::HitTable summed = left;
+  summed.merge(right);
+  check_table(summed, sum);
+
+  Reference maxed = left_ref;
+  for (const auto &[key, value] : right_ref) {
+    auto &entry = maxed[key];
+    entry = std::max(entry, value);
+  }
+  coverage::HitTable combined = left;
+  combined.merge(right, [](uint64_t a, uint64_t b) { return std::max(a, b); });
+  check_table(combined, maxed);
+
+  coverage::HitTable empty;
+  empty.merge(right);
+  check_table(empty, right_ref);
+}
+
+} // namespace
+
+int main() {
+  return run_tests({
+      {"grows_like_a_map", grows_like_a_map},
+      {"stores_the_all_ones_key", stores_the_all_ones_key},
+      {"emplace_keeps_existing_values", emplace_keeps_existing_values},
+      {"reserve_avoids_rehashing", reserve_avoids_rehashing},
+      {"merges_like_a_map", merges_like_a_map},
+  });
+}
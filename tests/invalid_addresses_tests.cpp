@@ -0,0 +1,156 @@
+// Checks InvalidAddressSummary against an exact record of every address.
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "covex/core/invalid_addresses.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+using namespace binja::covex;
+using namespace binja::covex::test;
+
+// Occurrences per address, as the summary would record them with no budget.
+using Reference = std::map<uint64_t, uint64_t>;
+
+std::vector<core::InvalidRange> exact_runs(const Reference &reference) {
+  std::vector<core::InvalidRange> runs;
+  for (const auto &[addr, count] : reference) {
+    const uint64_t hi =
+        addr == std::numeric_limits<uint64_t>::max() ? addr : addr + 1;
+    if (!runs.empty() && addr <= runs.back().hi) {
+      runs.back().hi = hi;
+      runs.back().count += count;
+      continue;
+    }
+    runs.push_back({addr, hi, count});
+  }
+  return runs;
+}
+
+// Runs must be sorted and disjoint, stay within the budget, cover every
+// address and account for every occurrence.
+void check_summary(const core::InvalidAddressSummary &summary,
+                   const Reference &reference, size_t max_ranges) {
+  const auto ranges = summary.ranges();
+  uint64_t total = 0;
+  for (const auto &[addr, count] : reference) {
+    total += count;
+  }
+  COVEX_CHECK(summary.count() == total);
+  COVEX_CHECK(ranges.size() <= max_ranges);
+  uint64_t range_total = 0;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    COVEX_CHECK(ranges[i].lo <= ranges[i].hi);
+    if (i != 0) {
+      COVEX_CHECK(ranges[i - 1].hi < ranges[i].lo);
+    }
+    range_total += ranges[i].count;
+  }
+  COVEX_CHECK(range_total == total);
+  for (const auto &[addr, count] : reference) {
+    (void)count;
+    bool covered = false;
+    for (const auto &range : ranges) {
+      covered |= addr >= range.lo &&
+                 (addr < range.hi || (addr == range.hi && range.lo == addr));
+    }
+    COVEX_CHECK(covered);
+  }
+}
+
+void exact_within_budget() {
+  core::InvalidAddressSummary summary(64);
+  Reference reference;
+  for (const uint64_t addr :
+       {0x10ull, 0x11ull, 0x11ull, 0x12ull, 0x40ull, 0x8ull, 0x41ull}) {
+    summary.add(addr);
+    ++reference[addr];
+  }
+  const auto ranges = summary.ranges();
+  const auto expected = exact_runs(reference);
+  COVEX_CHECK(ranges.size() == expected.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    COVEX_CHECK(ranges[i].lo == expected[i].lo);
+    COVEX_CHECK(ranges[i].hi == expected[i].hi);
+    COVEX_CHECK(ranges[i].count == expected[i].count);
+  }
+}
+
+void coarsens_to_budget() {
+  // Random addresses in clusters, with more than kPendingLimit adds so the
+  // buffer is folded several times.
+  std::mt19937_64 random(7);
+  for (const size_t max_ranges : {size_t{1}, size_t{3}, size_t{64}}) {
+    core::InvalidAddressSummary summary(max_ranges);
+    Reference reference;
+    for (size_t i = 0; i < 200000; ++i) {
+      const uint64_t cluster = (random() % 32) << 20;
+      const uint64_t addr = cluster + random() % 0x400;
+      summary.add(addr);
+      ++reference[addr];
+    }
+    check_summary(summary, reference, max_ranges);
+  }
+}
+
+void coarsening_merges_closest_runs() {
+  // Seven runs over a budget of six are coarsened to three, joining across
+  // the four smallest gaps.
+  core::InvalidAddressSummary summary(6);
+  for (const uint64_t addr :
+       {0ull, 10ull, 12ull, 100ull, 300ull, 700ull, 1500ull}) {
+    summary.add(addr);
+  }
+  const auto ranges = summary.ranges();
+  COVEX_CHECK(ranges.size() == 3);
+  COVEX_CHECK(ranges[0].lo == 0);
+  COVEX_CHECK(ranges[0].hi == 301);
+  COVEX_CHECK(ranges[0].count == 5);
+  COVEX_CHECK(ranges[1].lo == 700);
+  COVEX_CHECK(ranges[2].lo == 1500);
+}
+
+void merge_and_rebuild_keep_counts() {
+  std::mt19937_64 random(11);
+  core::InvalidAddressSummary left(16);
+  core::InvalidAddressSummary right(16);
+  Reference reference;
+  for (size_t i = 0; i < 5000; ++i) {
+    const uint64_t addr = random() % 0x100000;
+    (i % 2 == 0 ? left : right).add(addr, static_cast<uint32_t>(i % 3));
+    ++reference[addr];
+  }
+  const uint64_t top = std::numeric_limits<uint64_t>::max();
+  right.add(top);
+  ++reference[top];
+  left.merge(right);
+  check_summary(left, reference, 16);
+  COVEX_CHECK(left.module_counts().size() == 3);
+  uint64_t module_total = 0;
+  for (const auto &[module, count] : left.module_counts()) {
+    (void)module;
+    module_total += count;
+  }
+  COVEX_CHECK(module_total == 5000);
+
+  const auto rebuilt = core::InvalidAddressSummary::from_ranges(
+      left.ranges(), left.module_counts(), 4);
+  check_summary(rebuilt, reference, 4);
+  COVEX_CHECK(rebuilt.module_counts() == left.module_counts());
+}
+
+} // namespace
+
+int main() {
+  return run_tests({
+      {"exact_within_budget", exact_within_budget},
+      {"coarsens_to_budget", coarsens_to_budget},
+      {"coarsening_merges_closest_runs", coarsening_merges_closest_runs},
+      {"merge_and_rebuild_keep_counts", merge_and_rebuild_keep_counts},
+  });
+}
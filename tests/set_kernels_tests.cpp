@@ -0,0 +1,190 @@
+// Checks the linear and galloping set kernels, and compose() on top of
+// them, against std::map based reference implementations.
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "covex/coverage/coverage_operations.hpp"
+#include "covex/coverage/set_kernels.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+using namespace binja::covex;
+using namespace binja::covex::test;
+using coverage::CompositionOp;
+using coverage::HitMergePolicy;
+
+using Reference = std::map<uint64_t, uint64_t>;
+
+uint64_t reference_merge(HitMergePolicy policy, uint64_t left,
+                         uint64_t right) {
+  switch (policy) {
+  case HitMergePolicy::Sum:
+    return left + right;
+  case HitMergePolicy::Min:
+    return std::min(left, right);
+  case HitMergePolicy::Max:
+    return std::max(left, right);
+  case HitMergePolicy::Left:
+  default:
+    return left;
+  }
+}
+
+Reference reference_compose(const Reference &a, const Reference &b,
+                            CompositionOp op, HitMergePolicy policy) {
+  Reference result;
+  for (const auto &[addr, hits] : a) {
+    const auto other = b.find(addr);
+    const bool shared = other != b.end();
+    if (op == CompositionOp::Subtract) {
+      if (!shared) {
+        result[addr] = hits;
+      }
+    } else if (shared) {
+      result[addr] = reference_merge(policy, hits, other->second);
+    } else if (op == CompositionOp::Union) {
+      result[addr] = hits;
+    }
+  }
+  if (op == CompositionOp::Union) {
+    for (const auto &[addr, hits] : b) {
+      result.emplace(addr, hits);
+    }
+  }
+  return result;
+}
+
+coverage::CoverageDataset to_dataset(const Reference &reference) {
+  std::vector<uint64_t> addresses;
+  std::vector<uint64_t> hits;
+  for (const auto &[addr, count] : reference) {
+    addresses.push_back(addr);
+    hits.push_back(count);
+  }
+  return coverage::CoverageDataset::from_sorted(std::move(addresses),
+                                                std::move(hits));
+}
+
+void check_columns(const coverage::HitColumns &got, const Reference &want) {
+  COVEX_CHECK(got.addresses.size() == want.size());
+  COVEX_CHECK(got.hits.size() == want.size());
+  size_t i = 0;
+  for (const auto &[addr, hits] : want) {
+    COVEX_CHECK(got.addresses[i] == addr);
+    COVEX_CHECK(got.hits[i] == hits);
+    ++i;
+  }
+}
+
+void check_dataset(const coverage::CoverageDataset &got,
+                   const Reference &want) {
+  COVEX_CHECK(got.size() == want.size());
+  size_t i = 0;
+  for (const auto &[addr, hits] : want) {
+    COVEX_CHECK(got.addresses()[i] == addr);
+    COVEX_CHECK(got.hit_counts()[i] == hits);
+    ++i;
+  }
+}
+
+// `count` addresses drawn from [base, base + span) with random hits.
+Reference random_set(std::mt19937_64 &random, size_t count, uint64_t base,
+                     uint64_t span) {
+  Reference result;
+  while (result.size() < std::min<uint64_t>(count, span)) {
+    result[base + random() % span] = random() % 1000 + 1;
+  }
+  return result;
+}
+
+void gallop_matches_lower_bound() {
+  const std::vector<uint64_t> addresses = {1, 3, 3, 4, 8, 9, 15, 16, 40};
+  for (size_t from = 0; from <= addresses.size(); ++from) {
+    for (uint64_t key = 0; key <= 42; ++key) {
+      const auto expected = static_cast<size_t>(
+          std::lower_bound(addresses.begin() + from, addresses.end(), key) -
+          addresses.begin());
+      COVEX_CHECK(coverage::detail::gallop(addresses, from, key) == expected);
+    }
+  }
+  COVEX_CHECK(coverage::detail::gallop({}, 0, 5) == 0);
+}
+
+void kernels_match_reference() {
+  // (left size, right size, address span): similar sizes take the linear
+  // merge; a 16x imbalance either way gallops over the larger side.
+  struct Shape {
+    size_t left;
+    size_t right;
+    uint64_t span;
+  };
+  const std::vector<Shape> shapes = {
+      {0, 0, 10},      {0, 50, 100},     {50, 0, 100},     {1, 1, 2},
+      {100, 90, 150},  {100, 100, 100},  {1000, 900, 4000}, {3, 1000, 1200},
+      {1000, 3, 1200}, {10, 5000, 5000}, {5000, 10, 5000}, {64, 1025, 2000},
+      {1025, 64, 2000}, {1, 20000, 40000}};
+  std::mt19937_64 random(31);
+  for (const auto &shape : shapes) {
+    for (size_t round = 0; round < 4; ++round) {
+      const auto a = random_set(random, shape.left, 0x1000, shape.span);
+      // Round 3 puts b entirely after a.
+      const uint64_t b_base = round == 3 ? 0x1000 + shape.span : 0x1000;
+      const auto b = random_set(random, shape.right, b_base, shape.span);
+      const auto dataset_a = to_dataset(a);
+      const auto dataset_b = to_dataset(b);
+      const coverage::SortedHits left(dataset_a);
+      const coverage::SortedHits right(dataset_b);
+
+      for (const auto policy : {HitMergePolicy::Sum, HitMergePolicy::Min,
+                                HitMergePolicy::Max, HitMergePolicy::Left}) {
+        coverage::with_merge_policy(policy, [&](auto merge) {
+          coverage::HitColumns unioned;
+          coverage::union_kernel(left, right, merge, unioned);
+          check_columns(unioned, reference_compose(a, b, CompositionOp::Union,
+                                                   policy));
+          coverage::HitColumns intersected;
+          coverage::intersect_kernel(left, right, merge, intersected);
+          check_columns(intersected,
+                        reference_compose(a, b, CompositionOp::Intersection,
+                                          policy));
+          return 0;
+        });
+        for (const auto op : {CompositionOp::Union,
+                              CompositionOp::Intersection,
+                              CompositionOp::Subtract}) {
+          check_dataset(coverage::compose(dataset_a, dataset_b, op, policy),
+                        reference_compose(a, b, op, policy));
+        }
+      }
+      coverage::HitColumns subtracted;
+      coverage::subtract_kernel(left, right, subtracted);
+      check_columns(subtracted,
+                    reference_compose(a, b, CompositionOp::Subtract,
+                                      HitMergePolicy::Left));
+    }
+  }
+}
+
+void gallop_threshold_is_sixteen_to_one() {
+  COVEX_CHECK(!coverage::detail::should_gallop(10, 160));
+  COVEX_CHECK(coverage::detail::should_gallop(10, 161));
+  COVEX_CHECK(!coverage::detail::should_gallop(0, 0));
+  COVEX_CHECK(coverage::detail::should_gallop(0, 1));
+}
+
+} // namespace
+
+int main() {
+  return run_tests({
+      {"gallop_matches_lower_bound", gallop_matches_lower_bound},
+      {"gallop_threshold_is_sixteen_to_one",
+       gallop_threshold_is_sixteen_to_one},
+      {"kernels_match_reference", kernels_match_reference},
+  });
+}
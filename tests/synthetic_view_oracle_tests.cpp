@@ -0,0 +1,98 @@
+// Checks SyntheticViewOracle against the ViewOracle contract the mapper
+// relies on, and that mapping runs headless on top of it.
+
+#include <algorithm>
+#include <vector>
+
+#include "covex/core/coverage_mapper.hpp"
+#include "covex/core/synthetic_view_oracle.hpp"
+#include "test_support.hpp"
+
+namespace {
+
+using namespace binja::covex;
+using namespace binja::covex::test;
+
+void oracle_finds_block_at_zero() {
+  core::SyntheticViewOracle view(0, 0x1000, 0);
+  view.add_function(0, "entry");
+  view.add_block(0, 0x20, 0);
+  view.add_block(0x20, 0x40, 0);
+  COVEX_CHECK(view.basic_blocks_at(0).size() == 1);
+  COVEX_CHECK(view.basic_blocks_at(0x1f).size() == 1);
+  COVEX_CHECK(view.basic_blocks_at(0x20).front().start == 0x20);
+  COVEX_CHECK(view.basic_blocks_at(0x40).empty());
+}
+
+void oracle_reports_overlapping_blocks() {
+  // A large block shared by two functions, and a short one inside it.
+  core::SyntheticViewOracle view(0x1000, 0x2000, 0x1000);
+  view.add_function(0x1000, "outer");
+  view.add_function(0x1100, "inner");
+  view.add_block(0x1000, 0x1200, 0x1000);
+  view.add_block(0x1100, 0x1110, 0x1100);
+  view.add_block(0x1000, 0x1010, 0x1100);
+  view.add_block(0x1200, 0x1200, 0x1000);
+
+  COVEX_CHECK(view.basic_blocks().size() == 3);
+  COVEX_CHECK(view.basic_blocks_at(0x1108).size() == 2);
+  COVEX_CHECK(view.basic_blocks_at(0x1180).size() == 1);
+  COVEX_CHECK(view.basic_blocks_at(0x1200).empty());
+  auto functions = view.functions_containing(0x1008);
+  std::sort(functions.begin(), functions.end());
+  COVEX_CHECK((functions == std::vector<uint64_t>{0x1000, 0x1100}));
+  COVEX_CHECK(view.functions_containing(0x1180).size() == 1);
+  COVEX_CHECK(view.function_name(0x1100) == "inner");
+  COVEX_CHECK(view.function_name(0x1200).empty());
+}
+
+void oracle_bounds_instructions_and_memory_map() {
+  core::SyntheticViewOracle view(0x1000, 0x2000, 0x1000);
+  view.set_default_instruction_length(2);
+  view.set_instruction_length(0x1004, 7);
+  view.add_segment({0x1000, 0x1800, true, true, false});
+  view.add_section({0x1000, 0x1400, true});
+  view.add_section({0x1200, 0x1600, false});
+  view.add_data_variable(0x1700);
+
+  COVEX_CHECK(view.is_valid_offset(0x1000));
+  COVEX_CHECK(!view.is_valid_offset(0x2000));
+  COVEX_CHECK(view.instruction_length(0x1000) == 2);
+  COVEX_CHECK(view.instruction_length(0x1004) == 7);
+  COVEX_CHECK(view.instruction_length(0x2000) == 0);
+  COVEX_CHECK(view.segment_at(0x17ff).has_value());
+  COVEX_CHECK(!view.segment_at(0x1800).has_value());
+  COVEX_CHECK(view.sections_at(0x1300).size() == 2);
+  COVEX_CHECK(view.sections_at(0x1500).size() == 1);
+  COVEX_CHECK(view.has_data_variable(0x1700));
+  COVEX_CHECK(!view.has_data_variable(0x1704));
+}
+
+void map_trace_counts_instructions_and_blocks() {
+  const auto view = make_view();
+  auto trace = make_trace();
+  trace.spans.push_back(span_at(0x2000, 0x10, 3));
+  trace.spans.push_back(span_at(0x2100, 0x20, 1));
+
+  core::CoverageMapper mapper;
+  const auto index = mapper.map_trace(trace, view);
+  COVEX_CHECK(index.dataset.size() == 12);
+  COVEX_CHECK(index.dataset.find(0x2004) == 3u);
+  COVEX_CHECK(index.blocks.size() == 3);
+  COVEX_CHECK(index.blocks[0].hits == 12);
+  COVEX_CHECK(index.blocks[0].function == "f0");
+  COVEX_CHECK(index.invalid.count() == 0);
+}
+
+} // namespace
+
+int main() {
+  return run_tests({
+      {"oracle_finds_block_at_zero", oracle_finds_block_at_zero},
+      {"oracle_reports_overlapping_blocks", oracle_reports_overlapping_blocks},
+      {"oracle_bounds_instructions_and_memory_map",
+       oracle_bounds_instructions_and_memory_map},
+      {"map_trace_counts_instructions_and_blocks",
+       map_trace_counts_instructions_and_blocks},
+  });
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// Minimal check macro, runner and synthetic fixtures shared by the headless
+// test executables.
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "covex/core/synthetic_view_oracle.hpp"
+#include "covex/coverage/coverage_types.hpp"
+
+namespace binja::covex::test {
+
+struct TestCase {
+  const char *name;
+  std::function<void()> run;
+};
+
+struct CheckFailed {
+  std::string message;
+};
+
+#define COVEX_CHECK(condition)                                                 \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      throw ::binja::covex::test::CheckFailed{                                 \
+          std::string(__FILE__) + ":" + std::to_string(__LINE__) +             \
+          ": " #condition};                                                    \
+    }                                                                          \
+  } while (false)
+
+// Runs every case, printing one line each; returns the process exit code.
+inline int run_tests(const std::vector<TestCase> &tests) {
+  int failures = 0;
+  for (const auto &test : tests) {
+    try {
+      test.run();
+      std::printf("[pass] %s\n", test.name);
+    } catch (const CheckFailed &failure) {
+      std::printf("[fail] %s: %s\n", test.name, failure.message.c_str());
+      ++failures;
+    } catch (const std::exception &error) {
+      std::printf("[fail] %s: %s\n", test.name, error.what());
+      ++failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+inline constexpr uint64_t kImageBase = 0x1000;
+inline constexpr uint64_t kModuleBase = 0x400000;
+
+// Ten functions of four 0x10-byte blocks each, starting at 0x2000.
+inline core::SyntheticViewOracle make_view() {
+  core::SyntheticViewOracle view(kImageBase, 0x100000, kImageBase);
+  view.set_original_filename("/bin/target");
+  view.add_segment({kImageBase, 0x100000, true, true, false});
+  for (uint64_t f = 0; f < 10; ++f) {
+    const uint64_t entry = 0x2000 + f * 0x100;
+    view.add_function(entry, "f" + std::to_string(f));
+    for (uint64_t b = 0; b < 4; ++b) {
+      view.add_block(entry + b * 0x10, entry + (b + 1) * 0x10, entry);
+    }
+  }
+  return view;
+}
+
+// A trace with the target loaded at kModuleBase as module 0.
+inline coverage::CoverageTrace make_trace() {
+  coverage::CoverageTrace trace;
+  coverage::ModuleInfo module;
+  module.id = 0;
+  module.base = kModuleBase;
+  module.end = kModuleBase + 0x100000;
+  module.path = "/bin/target";
+  trace.modules[0] = module;
+  return trace;
+}
+
+// A module-0 span covering [view_addr, view_addr + size) in the view.
+inline coverage::CoverageSpan span_at(uint64_t view_addr, uint32_t size,
+                                      uint64_t hits) {
+  coverage::CoverageSpan span;
+  span.address = view_addr - kImageBase + kModuleBase;
+  span.size = size;
+  span.hits = hits;
+  span.module_id = 0;
+  return span;
+}
+
+} // namespace binja::covex::test